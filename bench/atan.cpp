@@ -0,0 +1,69 @@
+#include "bench.hpp"
+#include "private_include/atan.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace wsay {
+namespace bench {
+namespace {
+// 10 minutes of 44.1kHz audio.
+constexpr size_t num_samples = 44'100 * 60 * 10;
+
+const char* to_string(atan_e path) {
+	switch (path) {
+	case atan_e::precise: {
+		return "std::atan";
+	} break;
+	case atan_e::poly: {
+		return "poly";
+	} break;
+	case atan_e::table: {
+		return "table";
+	} break;
+	default: {
+	} break;
+	}
+	return "";
+}
+
+// Max absolute error against double precision atan, over the range the
+// distortion sees (drive * sample, up to 100).
+double max_error(atan_e path) {
+	double ret = 0.0;
+	for (int i = -2'000'000; i <= 2'000'000; ++i) {
+		float x = float(i) * 0.00005f;
+		float v = x;
+		distort(path, 1.f, 1.f, 1.f, { &v, 1 });
+		ret = (std::max)(ret, std::abs(double(v) - std::atan(double(x))));
+	}
+	return ret;
+}
+} // namespace
+
+void atan_shaper() {
+	std::vector<float> source(num_samples);
+	for (size_t i = 0; i < source.size(); ++i) {
+		source[i] = 0.8f * std::sin(float(i) * 0.003f);
+	}
+	std::vector<float> samples(num_samples);
+
+	suite s{ "distortion atan" };
+	for (size_t i = 0; i < size_t(atan_e::count); ++i) {
+		atan_e path = atan_e(i);
+		s.run(to_string(path), num_samples, [&]() { samples = source; },
+				[&]() { distort(path, 20.f, 0.68f, 0.14f, samples); });
+	}
+	report(std::move(s));
+
+	for (size_t i = 0; i < size_t(atan_e::count); ++i) {
+		std::printf("  %-40s max error %g\n", to_string(atan_e(i)),
+				max_error(atan_e(i)));
+	}
+	std::printf("\n");
+}
+} // namespace bench
+} // namespace wsay
@@ -0,0 +1,63 @@
+#include "bench.hpp"
+
+#include <filesystem>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+#include <wsay/engine.hpp>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+constexpr size_t num_prompts = 64;
+
+const std::wstring prompts[] = {
+	L"Please hold, your call is important to us.",
+	L"For billing, press 1. For technical support, press 2.",
+	L"All of our agents are currently busy. Your estimated wait time is "
+	L"five minutes.",
+	L"Thank you for calling. Goodbye!",
+};
+
+std::vector<speak_job> make_jobs(const std::filesystem::path& dir) {
+	std::vector<speak_job> ret;
+	for (size_t i = 0; i < num_prompts; ++i) {
+		speak_job job;
+		job.vopts.radio_effect(radio_preset_e::radio1);
+		job.vopts.add_output_file(dir / std::format("prompt{}.wav", i));
+		job.text = prompts[i % std::size(prompts)];
+		ret.push_back(std::move(job));
+	}
+	return ret;
+}
+} // namespace
+
+void batch() {
+	const std::filesystem::path dir
+			= std::filesystem::temp_directory_path() / "wsay_bench_batch";
+	std::filesystem::create_directories(dir);
+	const std::vector<speak_job> jobs = make_jobs(dir);
+
+	const size_t max_workers = (std::max)(
+			size_t(std::thread::hardware_concurrency()), size_t(8));
+
+	// As fast as the effects go, then with a slow voice. Synthesis dominates,
+	// like with SAPI.
+	for (double synth_rtf : { 0.0, 0.05 }) {
+		engine e{ headless_options{ .synth_rtf = synth_rtf } };
+		const size_t samples = e.speak_batch(jobs, 1).bytes / 2;
+
+		suite s{ std::format("speak_batch, {} prompts to wav, synth rtf {}",
+				num_prompts, synth_rtf) };
+		for (size_t w = 1; w <= max_workers; w *= 2) {
+			s.run(std::format("{} workers", w), samples, []() {},
+					[&]() { e.speak_batch(jobs, w); }, synth_rtf > 0.0 ? 1 : 3);
+		}
+		report(s);
+	}
+	std::filesystem::remove_all(dir);
+}
+} // namespace bench
+} // namespace wsay
@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace wsay {
+namespace bench {
+struct result {
+	std::string name;
+	// Samples processed per run.
+	size_t samples = 0;
+	// The audio sampling rate of those samples.
+	size_t rate = 44'100;
+	// Fastest run.
+	double seconds = 0.0;
+
+	double samples_per_sec() const {
+		return seconds > 0.0 ? double(samples) / seconds : 0.0;
+	}
+
+	// Seconds of audio processed per second, higher is faster.
+	double realtime_factor() const {
+		return samples_per_sec() / double(rate);
+	}
+};
+
+// Collects timings and prints them as a table.
+struct suite {
+	explicit suite(std::string t)
+			: title(std::move(t)) {
+	}
+
+	// Runs func num_runs times and keeps the fastest run.
+	template <class Func>
+	void run(std::string name, size_t samples, Func&& func,
+			size_t num_runs = 10) {
+		run(std::move(name), samples, []() {}, std::forward<Func>(func),
+				num_runs);
+	}
+
+	// Same as above, calls init before every run, untimed.
+	template <class InitFunc, class Func>
+	void run(std::string name, size_t samples, InitFunc&& init, Func&& func,
+			size_t num_runs = 10) {
+		using clock_t = std::chrono::steady_clock;
+		double best = (std::numeric_limits<double>::max)();
+		for (size_t i = 0; i < num_runs; ++i) {
+			init();
+			auto start = clock_t::now();
+			func();
+			std::chrono::duration<double> dt = clock_t::now() - start;
+			best = (std::min)(best, dt.count());
+		}
+		results.push_back(result{
+				.name = std::move(name),
+				.samples = samples,
+				.rate = rate,
+				.seconds = best,
+		});
+	}
+
+	void print() const {
+		std::printf("%s\n", title.c_str());
+		for (const result& r : results) {
+			std::printf("  %-40s %12.3f ms %14.2f Msamples/s %10.1fx rt\n",
+					r.name.c_str(), r.seconds * 1000.0,
+					r.samples_per_sec() / 1'000'000.0, r.realtime_factor());
+		}
+		std::printf("\n");
+	}
+
+	std::string title;
+	// The sampling rate of the next runs.
+	size_t rate = 44'100;
+	std::vector<result> results;
+};
+
+// Prints the suite and keeps it for the json report.
+void report(suite s);
+
+// Writes every reported suite to a json file.
+// Returns false if the file couldn't be written.
+bool write_json(const char* path);
+
+// Benchmark groups.
+void pcm_conversion();
+void fx_presets();
+void noise();
+void biquads();
+void atan_shaper();
+void fx_scaling();
+void resampling();
+void fx_matrix();
+void pipeline();
+void batch();
+void setup();
+void fanout();
+void long_text();
+void queue();
+void stop();
+} // namespace bench
+} // namespace wsay
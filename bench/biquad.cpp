@@ -0,0 +1,62 @@
+#include "bench.hpp"
+#include "private_include/biquad.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <format>
+#include <utility>
+#include <vector>
+
+namespace wsay {
+namespace bench {
+namespace {
+// 10 minutes of 22.05kHz audio.
+constexpr size_t num_samples = 22'050 * 60 * 10;
+} // namespace
+
+void biquads() {
+	std::vector<float> source(num_samples);
+	for (size_t i = 0; i < source.size(); ++i) {
+		source[i] = 0.8f * std::sin(float(i) * 0.003f);
+	}
+	std::vector<float> samples(num_samples);
+
+	// A mix of every type, so coefficients differ per section.
+	std::array<biquad_args, biquad_max_sections> args{};
+	for (size_t i = 0; i < args.size(); ++i) {
+		args[i] = biquad_args{
+			.type = biquad_type_e(i % size_t(biquad_type_e::count)),
+			.freq = 0.02f + 0.05f * float(i),
+			.q = 0.707f,
+			.gain = 3.f,
+		};
+	}
+
+	// Samples is section samples, throughput is per section.
+	suite s{ "biquad cascade" };
+	s.rate = 22'050;
+	for (simd_e path : { simd_e::scalar, simd_e::sse2 }) {
+		if (!simd_available(path)) {
+			continue;
+		}
+
+		for (size_t n = 1; n <= biquad_max_sections; ++n) {
+			biquad_cascade cascade{ std::span{ args.data(), n } };
+			s.run(std::format("{} sections ({})", n,
+						  path == simd_e::scalar ? "scalar" : "sse2"),
+					num_samples * n, [&]() { samples = source; },
+					[&]() {
+						// In blocks, like the fx chain.
+						for (size_t i = 0; i < samples.size(); i += 256) {
+							std::span<float> block{ samples.data() + i,
+								(std::min)(size_t(256), samples.size() - i) };
+							cascade.process(path, block);
+						}
+					});
+		}
+	}
+	report(std::move(s));
+}
+} // namespace bench
+} // namespace wsay
@@ -0,0 +1,54 @@
+#include "bench.hpp"
+
+#include <filesystem>
+#include <format>
+#include <string>
+#include <wsay/engine.hpp>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+constexpr size_t max_outputs = 16;
+
+const std::wstring text
+		= L"The quick brown fox jumps over the lazy dog. Pack my box with five "
+		  L"dozen liquor jugs! How vexingly quick daft zebras jump? Sphinx of "
+		  L"black quartz, judge my vow.";
+} // namespace
+
+void fanout() {
+	engine e{ headless_options{ .num_devices = max_outputs } };
+	const std::filesystem::path path
+			= std::filesystem::temp_directory_path() / "wsay_bench_fanout.wav";
+
+	// Rendered every time, then from the cache where the outputs are most of
+	// the cost.
+	for (bool cached : { false, true }) {
+		e.cache_budget(cached ? 64 * 1024 * 1024 : 0);
+
+		suite s{ std::format("fan-out to devices, {}, headless",
+				cached ? "cached" : "rendered") };
+		for (bool file : { false, true }) {
+			for (size_t n = 1; n <= max_outputs; n *= 2) {
+				voice vopts;
+				vopts.radio_effect(radio_preset_e::radio1);
+				for (size_t i = 0; i < n; ++i) {
+					vopts.add_output_device(i);
+				}
+				if (file) {
+					vopts.add_output_file(path);
+				}
+
+				const size_t samples = e.speak(vopts, text).bytes / 2;
+				s.run(std::format("{} devices{}", n, file ? " + wav file" : ""),
+						samples, []() {}, [&]() { e.speak(vopts, text); }, 5);
+			}
+		}
+		report(s);
+	}
+	e.cache_budget(0);
+	std::filesystem::remove(path);
+}
+} // namespace bench
+} // namespace wsay
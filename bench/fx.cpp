@@ -0,0 +1,96 @@
+#include "bench.hpp"
+#include "private_include/fx_chain.hpp"
+
+#include <cmath>
+#include <format>
+#include <utility>
+#include <vector>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+// 10 minutes of 44.1kHz audio.
+constexpr size_t num_samples = 44'100 * 60 * 10;
+} // namespace
+
+void fx_presets() {
+	std::vector<float> source(num_samples);
+	for (size_t i = 0; i < source.size(); ++i) {
+		source[i] = 0.8f * std::sin(float(i) * 0.003f);
+	}
+	std::vector<float> samples(num_samples);
+
+	suite s{ "fx presets" };
+	for (size_t i = 0; i < radio_preset_count(); ++i) {
+		for (bool noise : { true, false }) {
+			voice vopts;
+			vopts.radio_effect(radio_preset_e(i));
+			vopts.radio_effect_disable_whitenoise = !noise;
+
+			s.run(std::format("radio {}{}", i + 1, noise ? "" : " (no noise)"),
+					num_samples, [&]() { samples = source; },
+					[&]() { process_fx(vopts, samples); });
+		}
+
+		voice vopts;
+		vopts.radio_effect(radio_preset_e(i));
+		vopts.radio_effect_native_rate = true;
+		s.run(std::format("radio {} (native rate)", i + 1), num_samples,
+				[&]() { samples = source; },
+				[&]() { process_fx(vopts, samples); });
+	}
+	report(std::move(s));
+
+	// The same presets, loaded at runtime.
+	suite rt{ "fx presets, builtin vs runtime" };
+	std::vector<float> out;
+	out.reserve(num_samples);
+	for (size_t i = 0; i < radio_preset_count(); ++i) {
+		voice vopts;
+		vopts.radio_effect(radio_preset_e(i));
+
+		rt.run(std::format("radio {} (builtin)", i + 1), num_samples,
+				[&]() { out.clear(); },
+				[&]() {
+					fx_engine engine{ vopts };
+					engine.process(source, out);
+					engine.flush(out);
+				});
+		rt.run(std::format("radio {} (runtime)", i + 1), num_samples,
+				[&]() { out.clear(); },
+				[&]() {
+					fx_engine engine{ vopts, radio_presets[radio_preset_e(i)] };
+					engine.process(source, out);
+					engine.flush(out);
+				});
+	}
+	report(std::move(rt));
+
+	// Presets with distortion, per atan.
+	suite dist{ "fx presets, distortion atan" };
+	for (size_t i = 0; i < radio_preset_count(); ++i) {
+		if (radio_presets[radio_preset_e(i)].dist_drive == 0.f) {
+			continue;
+		}
+
+		voice vopts;
+		vopts.radio_effect(radio_preset_e(i));
+		for (atan_e path : { atan_e::precise, atan_e::poly, atan_e::table }) {
+			const char* name = path == atan_e::precise ? "std::atan"
+					: path == atan_e::poly             ? "poly"
+													   : "table";
+			dist.run(std::format("radio {} ({})", i + 1, name), num_samples,
+					[&]() { out.clear(); },
+					[&]() {
+						fx_engine engine{ vopts };
+						engine.distortion_atan(path);
+						engine.process(source, out);
+						engine.flush(out);
+					});
+		}
+	}
+	report(std::move(dist));
+}
+} // namespace bench
+} // namespace wsay
@@ -0,0 +1,60 @@
+#include "bench.hpp"
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <wsay/engine.hpp>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+const std::wstring paragraph
+		= L"The quick brown fox jumps over the lazy dog. Pack my box with five "
+		  L"dozen liquor jugs! How vexingly quick daft zebras jump? Sphinx of "
+		  L"black quartz, judge my vow.\n";
+
+// Repeats the paragraph until it speaks for at least seconds.
+std::wstring make_text(engine& e, double seconds) {
+	const double paragraph_seconds
+			= double(e.speak(voice{}, paragraph).bytes) / (44'100.0 * 2.0);
+	const size_t count = size_t(std::ceil(seconds / paragraph_seconds));
+
+	std::wstring ret;
+	ret.reserve(paragraph.size() * count);
+	for (size_t i = 0; i < count; ++i) {
+		ret += paragraph;
+	}
+	return ret;
+}
+} // namespace
+
+void long_text() {
+	engine e{ headless_options{} };
+	const std::wstring text = make_text(e, 3600.0);
+	const std::filesystem::path path
+			= std::filesystem::temp_directory_path() / "wsay_bench_hour.wav";
+
+	// The whole render is held in memory, or streamed to the file through
+	// fixed size buffers.
+	suite s{ "1 hour text to wav file, headless" };
+	for (bool fx : { false, true }) {
+		for (bool streamed : { false, true }) {
+			voice vopts;
+			if (fx) {
+				vopts.radio_effect(radio_preset_e::radio1);
+			}
+			vopts.stream_synthesis = streamed;
+			vopts.add_output_file(path);
+
+			const size_t samples = e.speak(vopts, text).bytes / 2;
+			s.run(std::string{ fx ? "radio 1" : "no fx" }
+							+ (streamed ? ", streamed" : ", whole"),
+					samples, []() {}, [&]() { e.speak(vopts, text); }, 2);
+		}
+	}
+	report(s);
+	std::filesystem::remove(path);
+}
+} // namespace bench
+} // namespace wsay
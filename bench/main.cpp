@@ -0,0 +1,39 @@
+#include "bench.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+// Usage : wsay_bench [--json <file>]
+int main(int argc, char** argv) {
+	const char* json_path = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+		} else {
+			std::fprintf(stderr, "Usage : %s [--json <file>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	wsay::bench::pcm_conversion();
+	wsay::bench::noise();
+	wsay::bench::biquads();
+	wsay::bench::atan_shaper();
+	wsay::bench::resampling();
+	wsay::bench::fx_presets();
+	wsay::bench::fx_matrix();
+	wsay::bench::fx_scaling();
+	wsay::bench::pipeline();
+	wsay::bench::batch();
+	wsay::bench::setup();
+	wsay::bench::fanout();
+	wsay::bench::long_text();
+	wsay::bench::queue();
+	wsay::bench::stop();
+
+	if (json_path != nullptr && !wsay::bench::write_json(json_path)) {
+		std::fprintf(stderr, "Couldn't write '%s'.\n", json_path);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,138 @@
+#include "bench.hpp"
+#include "private_include/fx_chain.hpp"
+#include "private_include/pcm.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fea/enum/enum_array.hpp>
+#include <format>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+// 1 minute of audio per combination.
+constexpr size_t num_seconds = 60;
+
+// The chunk size process_fx reads from the tts stream.
+constexpr size_t chunk_size = 64 * 1024;
+
+constexpr fea::enum_array<size_t, sampling_rate_e> rates{
+	8'000,
+	11'025,
+	22'050,
+	44'100,
+};
+
+constexpr fea::enum_array<const char*, sampling_rate_e> rate_names{
+	"8kHz",
+	"11kHz",
+	"22kHz",
+	"44.1kHz",
+};
+
+// Renders like process_fx does on a tts stream, pcm in and out.
+template <class IntT>
+void render(const voice& vopts, const fx_args& args,
+		std::span<const IntT> pcm, std::vector<float>& in,
+		std::vector<float>& out, std::vector<IntT>& out_pcm) {
+	fx_engine engine{ vopts, args };
+	for (size_t i = 0; i < pcm.size(); i += chunk_size) {
+		std::span<const IntT> chunk
+				= pcm.subspan(i, (std::min)(chunk_size, pcm.size() - i));
+		in.resize(chunk.size());
+		pcm_to_float(chunk, in);
+
+		out.clear();
+		engine.process(in, out);
+		out_pcm.resize(out.size());
+		float_to_pcm(out, out_pcm);
+	}
+	out.clear();
+	engine.flush(out);
+	out_pcm.resize(out.size());
+	float_to_pcm(out, out_pcm);
+}
+
+// Same, in fixed-point on the pcm in place.
+template <class IntT>
+void render_fixed(const voice& vopts, const fx_args& args,
+		std::span<const IntT> pcm, std::vector<IntT>& out_pcm) {
+	fx_fixed_engine engine{ vopts, args };
+	out_pcm.assign(pcm.begin(), pcm.end());
+	for (size_t i = 0; i < out_pcm.size(); i += chunk_size) {
+		engine.process(std::span<IntT>{ out_pcm }.subspan(
+				i, (std::min)(chunk_size, out_pcm.size() - i)));
+	}
+	std::vector<IntT> tail;
+	engine.flush(tail);
+}
+
+template <class IntT>
+void bench_bit_depth(suite& s, suite& fixed, bit_depth_e bit_depth,
+		const char* bd_name) {
+	std::vector<float> in;
+	std::vector<float> out;
+	std::vector<IntT> out_pcm;
+
+	for (size_t ri = 0; ri < size_t(sampling_rate_e::count); ++ri) {
+		sampling_rate_e rate = sampling_rate_e(ri);
+		std::vector<float> source(rates[rate] * num_seconds);
+		for (size_t i = 0; i < source.size(); ++i) {
+			source[i] = 0.8f * std::sin(float(i) * 0.03f);
+		}
+		std::vector<IntT> pcm(source.size());
+		float_to_pcm(source, std::span<IntT>{ pcm });
+
+		// The builtin presets only exist at 16 bits, 44.1kHz. Their
+		// runtime equivalent runs at any input format.
+		voice vopts;
+		vopts.bit_depth(bit_depth);
+		vopts.sampling_rate(rate);
+		vopts.radio_effect_seed = 42;
+
+		for (size_t i = 0; i < radio_preset_count(); ++i) {
+			for (bool noise : { true, false }) {
+				fx_args args = radio_presets[radio_preset_e(i)];
+				if (!noise) {
+					args.noise_vol = 0.f;
+				}
+
+				std::string name = std::format("radio {}, {}, {}{}", i + 1,
+						bd_name, rate_names[rate], noise ? "" : " (no noise)");
+				s.rate = rates[rate];
+				s.run(name, pcm.size(), []() {},
+						[&]() {
+							render<IntT>(vopts, args, pcm, in, out, out_pcm);
+						},
+						5);
+
+				// Copying the input in is part of the run, like the stream
+				// read it stands for.
+				fixed.rate = rates[rate];
+				fixed.run(name, pcm.size(), []() {},
+						[&]() {
+							render_fixed<IntT>(vopts, args, pcm, out_pcm);
+						},
+						5);
+			}
+		}
+	}
+}
+} // namespace
+
+void fx_matrix() {
+	suite s{ "fx matrix, pcm in and out" };
+	suite fixed{ "fx matrix, fixed-point" };
+	bench_bit_depth<int8_t>(s, fixed, bit_depth_e::_8, "8 bit");
+	bench_bit_depth<int16_t>(s, fixed, bit_depth_e::_16, "16 bit");
+	report(std::move(s));
+	report(std::move(fixed));
+}
+} // namespace bench
+} // namespace wsay
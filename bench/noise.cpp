@@ -0,0 +1,35 @@
+#include "bench.hpp"
+#include "private_include/noise.hpp"
+
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace wsay {
+namespace bench {
+namespace {
+// 10 minutes of 44.1kHz audio.
+constexpr size_t num_samples = 44'100 * 60 * 10;
+} // namespace
+
+void noise() {
+	std::vector<float> samples(num_samples);
+	suite s{ "white noise" };
+
+	// What white_noise used before noise_gen.
+	s.run("mt19937 + uniform_real_distribution", num_samples, [&]() {
+		static std::random_device rd;
+		static std::mt19937 gen{ rd() };
+		static std::uniform_real_distribution<> dis(-1.0, 1.0);
+		for (float& f : samples) {
+			f = float(dis(gen));
+		}
+	});
+
+	noise_gen gen{ 42 };
+	s.run("noise_gen", num_samples, [&]() { gen.fill(samples, 1.f); });
+
+	report(std::move(s));
+}
+} // namespace bench
+} // namespace wsay
@@ -0,0 +1,83 @@
+#include "bench.hpp"
+#include "private_include/fx_chain.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <format>
+#include <thread>
+#include <vector>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+// 1 minute of 44.1kHz audio, looped to make an hour.
+constexpr size_t minute_samples = 44'100 * 60;
+constexpr size_t num_minutes = 60;
+constexpr size_t chunk_size = 64 * 1024;
+
+template <class Engine>
+void render_hour(Engine& engine, const std::vector<float>& minute,
+		std::vector<float>& out) {
+	for (size_t m = 0; m < num_minutes; ++m) {
+		for (size_t i = 0; i < minute.size(); i += chunk_size) {
+			size_t size = (std::min)(chunk_size, minute.size() - i);
+			engine.process({ minute.data() + i, size }, out);
+			// Output is dropped, only the processing is measured.
+			out.clear();
+		}
+	}
+	engine.flush(out);
+	out.clear();
+}
+} // namespace
+
+void fx_scaling() {
+	std::vector<float> minute(minute_samples);
+	for (size_t i = 0; i < minute.size(); ++i) {
+		minute[i] = 0.8f * std::sin(float(i) * 0.003f);
+	}
+	std::vector<float> out;
+
+	const size_t max_threads = (std::max)(
+			size_t(std::thread::hardware_concurrency()), size_t(8));
+
+	suite s{ "fx parallel, 1 hour" };
+	for (radio_preset_e preset :
+			{ radio_preset_e::radio1, radio_preset_e::radio3 }) {
+		voice vopts;
+		vopts.radio_effect(preset);
+
+		s.run(std::format("radio {} (fx_engine)", size_t(preset) + 1),
+				minute_samples * num_minutes, []() {},
+				[&]() {
+					fx_engine engine{ vopts };
+					render_hour(engine, minute, out);
+				},
+				3);
+
+		for (size_t t = 1; t <= max_threads; t *= 2) {
+			s.run(std::format("radio {} ({} threads)", size_t(preset) + 1, t),
+					minute_samples * num_minutes, []() {},
+					[&]() {
+						fx_parallel engine{ vopts, t };
+						render_hour(engine, minute, out);
+					},
+					3);
+		}
+	}
+	report(s);
+
+	// Speedup against the serial engine.
+	double serial = 0.0;
+	for (const result& r : s.results) {
+		if (r.name.ends_with("(fx_engine)")) {
+			serial = r.seconds;
+			continue;
+		}
+		std::printf("  %-40s %8.2fx\n", r.name.c_str(), serial / r.seconds);
+	}
+	std::printf("\n");
+}
+} // namespace bench
+} // namespace wsay
@@ -0,0 +1,59 @@
+#include "bench.hpp"
+#include "private_include/pcm.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <fea/enum/enum_array.hpp>
+#include <utility>
+#include <vector>
+
+namespace wsay {
+namespace bench {
+namespace {
+// 10 minutes of 44.1kHz audio.
+constexpr size_t num_samples = 44'100 * 60 * 10;
+
+constexpr fea::enum_array<const char*, simd_e> simd_names{
+	"scalar",
+	"sse2",
+	"avx2",
+};
+
+template <class IntT>
+void bench_type(suite& s, const char* type_name) {
+	// Slightly over full scale, to exercise saturation.
+	std::vector<float> floats(num_samples);
+	for (size_t i = 0; i < floats.size(); ++i) {
+		floats[i] = 1.2f * std::sin(float(i) * 0.01f);
+	}
+	std::vector<IntT> ints(num_samples);
+	std::vector<float> out_floats(num_samples);
+
+	for (size_t i = 0; i < size_t(simd_e::count); ++i) {
+		simd_e path = simd_e(i);
+		if (!simd_available(path)) {
+			continue;
+		}
+
+		s.run(std::format("{} to float ({})", type_name, simd_names[path]),
+				num_samples, [&]() {
+					pcm_to_float(
+							path, std::span<const IntT>{ ints }, out_floats);
+				});
+		s.run(std::format("float to {} ({})", type_name, simd_names[path]),
+				num_samples, [&]() {
+					float_to_pcm(path, floats, std::span<IntT>{ ints });
+				});
+	}
+}
+} // namespace
+
+void pcm_conversion() {
+	suite s{ "pcm conversion" };
+	bench_type<int8_t>(s, "int8");
+	bench_type<int16_t>(s, "int16");
+	report(std::move(s));
+}
+} // namespace bench
+} // namespace wsay
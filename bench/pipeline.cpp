@@ -0,0 +1,159 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <string>
+#include <wsay/engine.hpp>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+const std::wstring paragraph
+		= L"The quick brown fox jumps over the lazy dog. Pack my box with five "
+		  L"dozen liquor jugs! How vexingly quick daft zebras jump? Sphinx of "
+		  L"black quartz, judge my vow. ";
+
+std::wstring make_text(size_t paragraphs) {
+	std::wstring ret;
+	for (size_t i = 0; i < paragraphs; ++i) {
+		ret += paragraph;
+	}
+	return ret;
+}
+
+// Samples spoken, measured with a wav file.
+size_t count_samples(engine& e, voice vopts, const std::wstring& text) {
+	const std::filesystem::path path
+			= std::filesystem::temp_directory_path() / "wsay_bench_count.wav";
+	vopts.add_output_file(path);
+	e.speak(vopts, text);
+	const size_t ret = size_t(std::filesystem::file_size(path) - 44) / 2;
+	std::filesystem::remove(path);
+	return ret;
+}
+} // namespace
+
+void pipeline() {
+	// Synthesis, effects and outputs, as fast as they go.
+	{
+		engine e{ headless_options{} };
+		const std::wstring text = make_text(8);
+		const std::filesystem::path path
+				= std::filesystem::temp_directory_path() / "wsay_bench.wav";
+
+		struct config {
+			const char* name;
+			radio_preset_e preset;
+			bool fixed_point;
+			bool pipelined;
+			bool streamed;
+			bool file;
+		};
+		const config configs[] = {
+			{ "no fx, null device", radio_preset_e::count, false, false, false,
+					false },
+			{ "no fx, wav file", radio_preset_e::count, false, false, false,
+					true },
+			{ "radio 1, null device", radio_preset_e::radio1, false, false,
+					false, false },
+			{ "radio 1, wav file", radio_preset_e::radio1, false, false, false,
+					true },
+			{ "radio 1 fixed, null device", radio_preset_e::radio1, true,
+					false, false, false },
+			{ "radio 1 pipelined, null device", radio_preset_e::radio1, false,
+					true, false, false },
+			{ "radio 1 streamed, null device", radio_preset_e::radio1, false,
+					false, true, false },
+			{ "radio 1 streamed, wav file", radio_preset_e::radio1, false,
+					false, true, true },
+		};
+
+		suite s{ "pipeline throughput, headless" };
+		for (const config& c : configs) {
+			voice vopts;
+			if (c.preset != radio_preset_e::count) {
+				vopts.radio_effect(c.preset);
+			}
+			vopts.radio_effect_fixed_point = c.fixed_point;
+			vopts.sentence_pipeline = c.pipelined;
+			vopts.stream_synthesis = c.streamed;
+
+			const size_t samples = count_samples(e, vopts, text);
+			if (c.file) {
+				vopts.add_output_file(path);
+			} else {
+				vopts.add_output_device(0);
+			}
+			s.run(c.name, samples, []() {}, [&]() { e.speak(vopts, text); },
+					5);
+		}
+		std::filesystem::remove(path);
+
+		// Repeated prompts skip synthesis and effects.
+		{
+			voice vopts;
+			vopts.radio_effect(radio_preset_e::radio1);
+			const size_t samples = count_samples(e, vopts, text);
+			vopts.add_output_device(0);
+
+			e.cache_budget(64 * 1024 * 1024);
+			e.speak(vopts, text);
+			s.run("radio 1 cached, null device", samples, []() {},
+					[&]() { e.speak(vopts, text); }, 5);
+			e.cache_budget(0);
+		}
+
+		// Timing every stage costs a few clock reads per chunk.
+		{
+			voice vopts;
+			vopts.radio_effect(radio_preset_e::radio1);
+			vopts.stream_synthesis = true;
+			const size_t samples = count_samples(e, vopts, text);
+			vopts.add_output_device(0);
+
+			e.collect_stats(true);
+			s.run("radio 1 streamed, stats, null device", samples, []() {},
+					[&]() { e.speak(vopts, text); }, 5);
+			e.collect_stats(false);
+		}
+		report(s);
+	}
+
+	// Latency with a voice that synthesizes at a tenth of real-time.
+	{
+		constexpr double synth_rtf = 0.1;
+		engine e{ headless_options{ .synth_rtf = synth_rtf } };
+		const std::wstring text = make_text(1);
+
+		suite s{ std::format(
+				"time to first audio, synth rtf {}, headless", synth_rtf) };
+		const char* names[] = { "whole text", "pipelined", "streamed" };
+		for (size_t mode = 0; mode < std::size(names); ++mode) {
+			voice vopts;
+			vopts.sentence_pipeline = mode == 1;
+			vopts.stream_synthesis = mode == 2;
+			vopts.radio_effect(radio_preset_e::radio1);
+			vopts.add_output_device(0);
+
+			// Only the first audio is timed.
+			double best = 1e9;
+			for (size_t i = 0; i < 3; ++i) {
+				const speak_timings t = e.speak(vopts, text);
+				best = (std::min)(best,
+						std::chrono::duration<double>(t.time_to_first_audio)
+								.count());
+			}
+			s.results.push_back(result{
+					.name = names[mode],
+					.samples = 0,
+					.seconds = best,
+			});
+		}
+		report(s);
+	}
+}
+} // namespace bench
+} // namespace wsay
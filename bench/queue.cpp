@@ -0,0 +1,73 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <format>
+#include <string>
+#include <thread>
+#include <wsay/engine.hpp>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+const std::wstring paragraph
+		= L"The quick brown fox jumps over the lazy dog. Pack my box with five "
+		  L"dozen liquor jugs! How vexingly quick daft zebras jump? Sphinx of "
+		  L"black quartz, judge my vow. ";
+
+const char* priority_names[] = { "low", "normal", "high" };
+} // namespace
+
+void queue() {
+	constexpr double synth_rtf = 0.1;
+	constexpr size_t num_rounds = 3;
+	engine e{ headless_options{ .synth_rtf = synth_rtf } };
+
+	std::wstring news;
+	for (size_t i = 0; i < 3; ++i) {
+		news += paragraph;
+	}
+
+	// A long low priority message is being synthesized when an alert comes
+	// in, a normal message follows it.
+	for (speak_policy_e alert_policy :
+			{ speak_policy_e::append, speak_policy_e::interrupt }) {
+		voice vopts;
+		vopts.add_output_device(0);
+		async_token tok = e.make_async_token(vopts);
+
+		for (size_t i = 0; i < num_rounds; ++i) {
+			e.speak_async(news, tok, speak_priority_e::low,
+					speak_policy_e::append);
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			e.speak_async(L"Severe weather alert.", tok,
+					speak_priority_e::high, alert_policy);
+			e.speak_async(L"Next, sports.", tok, speak_priority_e::normal,
+					speak_policy_e::append);
+			e.wait(tok);
+		}
+
+		const speak_queue_stats stats = tok.queue_stats();
+		suite s{ std::format("enqueue to first audio, alert {}, synth rtf {}, "
+							 "headless",
+				alert_policy == speak_policy_e::append ? "appended"
+													   : "interrupting",
+				synth_rtf) };
+		for (size_t p = 0; p < std::size(priority_names); ++p) {
+			// Never played, interrupted every time.
+			if (stats.first_audio[p].count == 0) {
+				continue;
+			}
+			s.results.push_back(result{
+					.name = std::format("{} priority, mean", priority_names[p]),
+					.samples = 0,
+					.seconds = std::chrono::duration<double>(
+							stats.first_audio[p].mean())
+									   .count(),
+			});
+		}
+		report(s);
+	}
+}
+} // namespace bench
+} // namespace wsay
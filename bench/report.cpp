@@ -0,0 +1,82 @@
+#include "bench.hpp"
+#include "private_include/pcm.hpp"
+
+#include <fea/enum/enum_array.hpp>
+#include <format>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if !defined(WSAY_VERSION)
+#define WSAY_VERSION "unknown"
+#endif
+
+namespace wsay {
+namespace bench {
+namespace {
+constexpr fea::enum_array<const char*, simd_e> simd_names{
+	"scalar",
+	"sse2",
+	"avx2",
+};
+
+std::vector<suite>& reported() {
+	static std::vector<suite> ret;
+	return ret;
+}
+
+std::string escape(std::string_view s) {
+	std::string ret;
+	ret.reserve(s.size());
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			ret += '\\';
+		}
+		ret += c;
+	}
+	return ret;
+}
+} // namespace
+
+void report(suite s) {
+	s.print();
+	reported().push_back(std::move(s));
+}
+
+bool write_json(const char* path) {
+	std::ofstream ofs{ path };
+	if (!ofs.is_open()) {
+		return false;
+	}
+
+	ofs << "{\n";
+	ofs << std::format("  \"version\": \"{}\",\n", WSAY_VERSION);
+	ofs << std::format("  \"simd\": \"{}\",\n", simd_names[simd_best()]);
+	ofs << "  \"suites\": [\n";
+	const std::vector<suite>& suites = reported();
+	for (size_t i = 0; i < suites.size(); ++i) {
+		const suite& s = suites[i];
+		ofs << "    {\n";
+		ofs << std::format("      \"title\": \"{}\",\n", escape(s.title));
+		ofs << "      \"results\": [\n";
+		for (size_t j = 0; j < s.results.size(); ++j) {
+			const result& r = s.results[j];
+			ofs << std::format(
+					"        {{ \"name\": \"{}\", \"samples\": {}, "
+					"\"rate\": {}, \"seconds\": {}, \"samples_per_sec\": {}, "
+					"\"realtime_factor\": {} }}{}\n",
+					escape(r.name), r.samples, r.rate, r.seconds,
+					r.samples_per_sec(), r.realtime_factor(),
+					j + 1 == s.results.size() ? "" : ",");
+		}
+		ofs << "      ]\n";
+		ofs << std::format("    }}{}\n", i + 1 == suites.size() ? "" : ",");
+	}
+	ofs << "  ]\n";
+	ofs << "}\n";
+	return ofs.good();
+}
+} // namespace bench
+} // namespace wsay
@@ -0,0 +1,42 @@
+#include "bench.hpp"
+#include "private_include/resample.hpp"
+
+#include <cmath>
+#include <format>
+#include <utility>
+#include <vector>
+
+namespace wsay {
+namespace bench {
+namespace {
+// 10 minutes of audio.
+constexpr size_t num_seconds = 60 * 10;
+} // namespace
+
+void resampling() {
+	suite s{ "resampling" };
+	std::vector<float> out;
+	// The preset rates, from and to the tts rate.
+	for (size_t low : { 8'000, 11'025, 22'050 }) {
+		for (auto [from, to] : { std::pair{ size_t(44'100), low },
+					 std::pair{ low, size_t(44'100) } }) {
+			std::vector<float> source(from * num_seconds);
+			for (size_t i = 0; i < source.size(); ++i) {
+				source[i] = 0.8f * std::sin(float(i) * 0.003f);
+			}
+			out.reserve(to * num_seconds + 1);
+
+			s.rate = from;
+			s.run(std::format("{} to {}", from, to), source.size(),
+					[&]() { out.clear(); },
+					[&]() {
+						resampler r{ from, to };
+						r.process(source, out);
+						r.flush(out);
+					});
+		}
+	}
+	report(std::move(s));
+}
+} // namespace bench
+} // namespace wsay
@@ -0,0 +1,54 @@
+#include "bench.hpp"
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <wsay/engine.hpp>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+void setup() {
+	// SAPI on Windows, headless elsewhere.
+	engine e;
+	voice vopts;
+
+	// Empty text, only the per utterance setup is timed.
+	suite s{ "speak setup, default device" };
+	s.run("new objects", 0, []() {},
+			[&]() {
+				async_token tok = e.make_async_token(vopts);
+				e.speak_async(L"", tok);
+				e.stop(tok);
+			},
+			100);
+	s.run("pooled objects", 0, []() {}, [&]() { e.speak(vopts, L""); }, 100);
+	report(s);
+
+	// A new engine speaking to the default device, like a wsay call.
+	// Enumeration costs nothing on headless.
+	const std::filesystem::path snapshot
+			= std::filesystem::temp_directory_path()
+			/ "wsay_bench_enumeration.bin";
+	auto remove_snapshot = [&]() {
+		std::error_code ec;
+		std::filesystem::remove(snapshot, ec);
+	};
+	auto start = [&](bool use_snapshot) {
+		engine fresh;
+		if (use_snapshot) {
+			fresh.enumeration_snapshot(snapshot);
+		}
+		fresh.speak(vopts, L"");
+	};
+
+	suite startup{ "startup, default device" };
+	startup.run("enumerated", 0, []() {}, [&]() { start(false); }, 10);
+	startup.run("snapshot cold", 0, remove_snapshot, [&]() { start(true); },
+			10);
+	startup.run("snapshot warm", 0, []() {}, [&]() { start(true); }, 10);
+	report(startup);
+	remove_snapshot();
+}
+} // namespace bench
+} // namespace wsay
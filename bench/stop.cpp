@@ -0,0 +1,103 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <wsay/engine.hpp>
+#include <wsay/voice.hpp>
+
+namespace wsay {
+namespace bench {
+namespace {
+const std::wstring paragraph
+		= L"The quick brown fox jumps over the lazy dog. Pack my box with five "
+		  L"dozen liquor jugs! How vexingly quick daft zebras jump? Sphinx of "
+		  L"black quartz, judge my vow. ";
+} // namespace
+
+void stop() {
+	constexpr size_t num_trials = 30;
+	const std::filesystem::path path
+			= std::filesystem::temp_directory_path() / "wsay_bench_stop.wav";
+
+	// About 6 minutes of audio, stopped while synthesizing, processing or
+	// writing.
+	std::wstring text;
+	for (size_t i = 0; i < 40; ++i) {
+		text += paragraph;
+	}
+
+	struct config {
+		const char* name;
+		double synth_rtf;
+		bool pipelined;
+		bool streamed;
+		bool file;
+	};
+	const config configs[] = {
+		{ "whole text, rtf 0, device", 0.0, false, false, false },
+		{ "whole text, rtf 0, wav file", 0.0, false, false, true },
+		{ "whole text, rtf 0.1, device", 0.1, false, false, false },
+		{ "pipelined, rtf 0.1, device", 0.1, true, false, false },
+		{ "streamed, rtf 0.1, device", 0.1, false, true, false },
+		{ "streamed, rtf 0, wav file", 0.0, false, true, true },
+	};
+
+	// The same delays for every config. Without synthesis delays, the text
+	// renders in under a second, stops land in any stage.
+	std::mt19937 gen{ 42 };
+	std::uniform_int_distribution<int> dist{ 0, 1'000 };
+
+	suite s{ "stop latency, radio 1, headless" };
+	for (const config& c : configs) {
+		engine e{ headless_options{
+				.synth_rtf = c.synth_rtf,
+				.realtime_devices = true,
+		} };
+		voice vopts;
+		vopts.radio_effect(radio_preset_e::radio1);
+		vopts.sentence_pipeline = c.pipelined;
+		vopts.stream_synthesis = c.streamed;
+		if (c.file) {
+			vopts.add_output_file(path);
+		} else {
+			vopts.add_output_device(0);
+		}
+
+		gen.seed(42);
+		std::vector<double> latencies;
+		for (size_t i = 0; i < num_trials; ++i) {
+			async_token tok = e.make_async_token(vopts);
+			e.speak_async(text, tok);
+			std::this_thread::sleep_for(std::chrono::milliseconds(dist(gen)));
+
+			const auto start = std::chrono::steady_clock::now();
+			e.stop(tok);
+			latencies.push_back(std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start)
+								.count());
+		}
+
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&](size_t p) {
+			return latencies[(latencies.size() - 1) * p / 100];
+		};
+		for (size_t p : { 50, 90, 99, 100 }) {
+			s.results.push_back(result{
+					.name = p == 100 ? std::format("{}, max", c.name)
+									 : std::format("{}, p{}", c.name, p),
+					.samples = 0,
+					.seconds = percentile(p),
+			});
+		}
+	}
+	std::filesystem::remove(path);
+	report(s);
+}
+} // namespace bench
+} // namespace wsay
@@ -29,11 +29,228 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #pragma once
+#include "wsay/voice.hpp"
+
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <fea/memory/pimpl_ptr.hpp>
+#include <filesystem>
+#include <functional>
+#include <future>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace wsay {
+// Timings of a speak call.
+struct speak_timings {
+	// From the call to the first audio sent to the outputs.
+	std::chrono::steady_clock::duration time_to_first_audio{};
+	// Text pieces synthesized, more than one when pipelined.
+	size_t chunks = 0;
+	// The audio came from the render cache, nothing was synthesized.
+	bool cached = false;
+	// Pcm sent to the outputs.
+	size_t bytes = 0;
+};
+
+// An utterance of a speak_batch call. Outputs are set in vopts.
+struct speak_job {
+	voice vopts;
+	std::wstring text;
+};
+
+// Outcome of a speak_batch job.
+struct speak_job_result {
+	bool ok = false;
+	// Why the job failed.
+	std::string error;
+	speak_timings timings;
+	// Audio length.
+	double audio_seconds = 0.0;
+	// From the job start to its outputs done.
+	std::chrono::steady_clock::duration duration{};
+};
+
+// Outcome of a speak_batch call.
+struct speak_batch_result {
+	// Matches the job indexes.
+	std::vector<speak_job_result> jobs;
+	size_t num_workers = 0;
+	std::chrono::steady_clock::duration wall_time{};
+	// Sums of all successful jobs.
+	double audio_seconds = 0.0;
+	size_t bytes = 0;
+
+	// Seconds of audio rendered per second, higher is faster.
+	double realtime_factor() const {
+		const double wall = std::chrono::duration<double>(wall_time).count();
+		return wall > 0.0 ? audio_seconds / wall : 0.0;
+	}
+};
+
+// Counters of the render cache.
+struct render_cache_stats {
+	size_t hits = 0;
+	size_t misses = 0;
+	// Renders currently stored.
+	size_t entries = 0;
+	// Pcm bytes currently stored.
+	size_t bytes = 0;
+	// Maximum pcm bytes stored, 0 when disabled.
+	size_t budget = 0;
+};
+
+// Stages of an utterance, timed by engine stats. Stages overlap when
+// pipelined or streamed.
+enum class speak_stage_e : uint8_t {
+	// Adding speech xml to the text.
+	format,
+	// Text to pcm, waiting on the voice included.
+	synthesis,
+	// Radio effects.
+	fx,
+	// Handing pcm to the outputs, device writes and file writes included.
+	output,
+	// Waiting on the outputs to finish playing.
+	drain,
+	count,
+};
+
+// Distribution of durations, in buckets a quarter octave wide.
+struct duration_histogram {
+	// Buckets of the microseconds, 4 per power of 2. Durations over 2 hours
+	// go to the last one.
+	static constexpr size_t num_buckets = 128;
+
+	size_t count = 0;
+	std::chrono::steady_clock::duration total{};
+	std::chrono::steady_clock::duration max{};
+	std::array<size_t, num_buckets> buckets{};
+
+	void add(std::chrono::steady_clock::duration d);
+
+	// The duration p percent of samples are under, p in [0, 100]. Accurate
+	// to a bucket, about 20%.
+	std::chrono::steady_clock::duration percentile(double p) const;
+
+	std::chrono::steady_clock::duration mean() const {
+		if (count == 0) {
+			return {};
+		}
+		return total / std::chrono::steady_clock::rep(count);
+	}
+};
+
+// Where the time of utterances went, see engine::collect_stats.
+// Only utterances spoken to the end are counted.
+struct engine_stats {
+	// Indexed by speak_stage_e, one sample per utterance.
+	std::array<duration_histogram, size_t(speak_stage_e::count)> stages{};
+	// From the start of an utterance to its last pcm handed to the outputs.
+	// Draining outputs isn't included.
+	duration_histogram utterances;
+	// Pcm sent to the outputs.
+	size_t bytes = 0;
+	double audio_seconds = 0.0;
+
+	// Seconds of audio rendered per second, higher is faster.
+	double realtime_factor() const {
+		const double render
+				= std::chrono::duration<double>(utterances.total).count();
+		return render > 0.0 ? audio_seconds / render : 0.0;
+	}
+};
+
+// Options of the headless backend, a stand-in for SAPI.
+// It synthesizes deterministic tones and plays to silent devices, so the
+// whole pipeline runs and can be measured anywhere.
+struct headless_options {
+	// Synthesis time per second of audio. 0 synthesizes as fast as possible,
+	// 0.1 mimics a typical SAPI voice.
+	double synth_rtf = 0.0;
+	// Devices take as long as the audio to play, rather than returning
+	// immediately.
+	bool realtime_devices = false;
+	// Number of silent devices.
+	size_t num_devices = 2;
+};
+
+// Urgency of a speak_async utterance. Pending utterances play by priority,
+// then in the order they were queued.
+enum class speak_priority_e : uint8_t {
+	low,
+	normal,
+	high,
+	count,
+};
+
+// How a speak_async utterance treats the ones before it.
+// Policies only drop utterances of the same or a lower priority.
+enum class speak_policy_e : uint8_t {
+	// Waits for its turn.
+	append,
+	// Drops the pending utterances, plays after the current one.
+	replace_pending,
+	// Drops the pending utterances and interrupts the current one.
+	interrupt,
+	count,
+};
+
+// Time from speak_async to an utterance's first audio.
+struct speak_latency {
+	// Utterances that played.
+	size_t count = 0;
+	std::chrono::steady_clock::duration total{};
+	std::chrono::steady_clock::duration max{};
+
+	std::chrono::steady_clock::duration mean() const {
+		if (count == 0) {
+			return {};
+		}
+		return total / std::chrono::steady_clock::rep(count);
+	}
+};
+
+// Counters of an async token queue.
+struct speak_queue_stats {
+	// Indexed by speak_priority_e.
+	std::array<speak_latency, size_t(speak_priority_e::count)> first_audio{};
+	// Utterances dropped by policies or a full queue, before playing.
+	size_t dropped = 0;
+	// Utterances cut by an interrupt.
+	size_t interrupted = 0;
+};
+
+// How a speak_async utterance ended.
+enum class speak_status_e : uint8_t {
+	// Spoken to every output.
+	done,
+	// Cut by an interrupt, stop or the token destruction.
+	interrupted,
+	// Dropped from the queue before speaking.
+	dropped,
+	// The synthesizer or an output failed.
+	failed,
+	count,
+};
+
+// Outcome of a speak_async utterance.
+struct speak_result {
+	speak_status_e status = speak_status_e::done;
+	speak_timings timings;
+	// Set when failed.
+	std::exception_ptr error;
+};
+
+// Called once a speak_async utterance ends.
+using speak_callback_t = std::function<void(const speak_result&)>;
+
+struct engine;
 struct async_token_imp;
 struct async_token : fea::pimpl_ptr<async_token_imp> {
 	async_token();
@@ -44,13 +261,45 @@ struct async_token : fea::pimpl_ptr<async_token_imp> {
 	async_token(const async_token&) = delete;
 	async_token& operator=(const async_token&) = delete;
 
+	// Timings of the last utterance spoken.
+	speak_timings timings() const;
+
+	// Latencies per priority and dropped utterances.
+	speak_queue_stats queue_stats() const;
+
+	friend struct engine;
+};
+
+// co_await it for the result of a speak_async utterance, see
+// engine::speak_co.
+struct speak_awaitable {
+	bool await_ready() const noexcept {
+		return false;
+	}
+	bool await_suspend(std::coroutine_handle<> handle);
+	speak_result await_resume() {
+		return std::move(_result);
+	}
+
+private:
 	friend struct engine;
+	speak_awaitable(engine& e, async_token& t, const std::wstring& sentence,
+			speak_priority_e priority, speak_policy_e policy);
+
+	engine* _engine = nullptr;
+	async_token* _token = nullptr;
+	std::wstring _sentence;
+	speak_priority_e _priority = speak_priority_e::normal;
+	speak_policy_e _policy = speak_policy_e::interrupt;
+	speak_result _result;
 };
 
-struct voice;
 struct engine_imp;
 struct engine : fea::pimpl_ptr<engine_imp> {
+	// Uses SAPI on Windows, the headless backend elsewhere.
 	engine();
+	// Uses the headless backend.
+	explicit engine(const headless_options& opts);
 	~engine();
 
 	engine(const engine&) = delete;
@@ -58,6 +307,12 @@ struct engine : fea::pimpl_ptr<engine_imp> {
 	engine& operator=(const engine&) = delete;
 	engine& operator=(engine&&) = delete;
 
+	// Voices and devices are enumerated on first use. This remembers their
+	// names in a file at path, so the next runs start without enumerating.
+	// The file is rebuilt when voices or devices are added or removed.
+	// Call before anything else. Empty disables it, the default.
+	void enumeration_snapshot(const std::filesystem::path& path);
+
 	// Returns the available voices. Use matching indexes when referring to a
 	// voice.
 	const std::vector<std::wstring>& voices() const;
@@ -68,21 +323,84 @@ struct engine : fea::pimpl_ptr<engine_imp> {
 
 	// Speaks the sentence using selected voice to playback outputs and file.
 	// Blocking.
-	void speak(const voice& v, const std::wstring& sentence);
+	speak_timings speak(const voice& v, const std::wstring& sentence);
 
 	// You need an async token to use async calls.
 	// This token should be used in all consecutive async calls of a specific
-	// voice.
-	async_token make_async_token(const voice& v) const;
+	// voice. It queues up to max_pending utterances, and must be destroyed
+	// before the engine.
+	async_token make_async_token(
+			const voice& v, size_t max_pending = 16) const;
 
-	// Speaks the sentence using selected voice to playback outputs and file.
-	// Non-blocking.
-	void speak_async(const std::wstring& sentence, async_token& t);
+	// Queues the sentence, the token speaks it on a background thread to
+	// its playback outputs and files. Non-blocking.
+	// Returns false if the queue is full of higher priority utterances, the
+	// sentence is dropped.
+	// on_done is called once the outputs are done, or the utterance is
+	// interrupted or dropped, unless this returns false. It runs on the token
+	// thread, or on the thread dropping the utterance. It mustn't throw, wait
+	// on the token or destroy it. Without it, errors of background speech
+	// are thrown by the next speak_async, wait or stop call.
+	bool speak_async(const std::wstring& sentence, async_token& t,
+			speak_priority_e priority = speak_priority_e::normal,
+			speak_policy_e policy = speak_policy_e::interrupt,
+			speak_callback_t on_done = {});
+
+	// speak_async, with a future of the outcome. Sentences the full queue
+	// rejects are dropped.
+	std::future<speak_result> speak_future(const std::wstring& sentence,
+			async_token& t,
+			speak_priority_e priority = speak_priority_e::normal,
+			speak_policy_e policy = speak_policy_e::interrupt);
+
+	// speak_async, as a coroutine awaitable. co_await it for the outcome.
+	// The coroutine resumes on the token thread, inside on_done, with the
+	// same limits: it can co_await the token again, but mustn't wait on it
+	// or destroy it. Sentences the full queue rejects are dropped, without
+	// suspending.
+	speak_awaitable speak_co(const std::wstring& sentence, async_token& t,
+			speak_priority_e priority = speak_priority_e::normal,
+			speak_policy_e policy = speak_policy_e::interrupt);
+
+	// Blocks until every queued utterance is spoken and told.
+	// Throws when called from the token thread, in on_done or a resumed
+	// speak_co coroutine, it would never return.
+	void wait(async_token& t);
 
-	// Interrupts playback speaking.
-	// Doesn't interrupt file ouput.
+	// Drops queued utterances and interrupts the one speaking. Synthesis,
+	// effects and outputs stop at their next chunk, so this returns within
+	// tens of milliseconds. Files keep what was written before the stop.
 	void stop(async_token& t);
 
+	// Speaks all jobs on num_workers threads, 0 uses every core. Workers
+	// have their own synthesizer, reused while the voice options allow it,
+	// and their own scratch buffers. Failed jobs don't stop the others.
+	// Blocking, returns once every output is done.
+	speak_batch_result speak_batch(
+			const std::vector<speak_job>& jobs, size_t num_workers = 0);
+
+	// Keeps rendered utterances (after effects) up to a total of bytes.
+	// Speaking the same text with the same voice options again skips
+	// synthesis and effects. Renders with a random noise seed replay the same
+	// noise. 0 disables the cache, the default.
+	void cache_budget(size_t bytes);
+
+	// Drops all cached renders. Counters are kept.
+	void invalidate_cache();
+
+	// Hits, misses and memory use of the render cache.
+	render_cache_stats cache_stats() const;
+
+	// Times every stage of the utterances spoken from now on, by all calls.
+	// Off by default, stages aren't timed while off.
+	void collect_stats(bool enable);
+
+	// Per-stage timings collected so far.
+	engine_stats stats() const;
+
+	// Clears the collected timings.
+	void reset_stats();
+
 private:
 	const engine_imp& imp() const;
 	engine_imp& imp();
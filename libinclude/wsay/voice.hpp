@@ -87,11 +87,29 @@ struct voice {
 	uint8_t pitch = 10; // 0-20
 	bool xml_parse = true;
 	bool radio_effect_disable_whitenoise = false;
+	// Radio effect noise seed, renders are reproducible when set.
+	// Max picks a random seed.
+	uint64_t radio_effect_seed = (std::numeric_limits<uint64_t>::max)();
+	// Output radio effects at the preset sampling rate instead of converting
+	// back to 44.1kHz. Smaller files, playback devices resample.
+	bool radio_effect_native_rate = false;
+	// Run radio effects in fixed-point, directly on the pcm. Uses less
+	// memory, output differs slightly from the float effects.
+	bool radio_effect_fixed_point = false;
 	uint16_t paragraph_pause_ms = (std::numeric_limits<uint16_t>::max)();
+	// Synthesize and play long texts sentence by sentence. Playback starts
+	// once the first sentence is synthesized, the next ones render while it
+	// plays.
+	bool sentence_pipeline = false;
+	// Process and play audio while it is synthesized, through a fixed size
+	// buffer. Playback and file writing start within milliseconds and memory
+	// doesn't grow with the text. Takes precedence over sentence_pipeline.
+	bool stream_synthesis = false;
 	size_t voice_idx = 0;
 
 	void radio_effect(radio_preset_e fx) {
 		_radio_effect = fx;
+		_radio_effect_file.clear();
 		_compression = compression_e::none;
 		_bit_depth = bit_depth_e::_16;
 		_sampling_rate = sampling_rate_e::_44;
@@ -100,9 +118,26 @@ struct voice {
 		return _radio_effect;
 	}
 
+	// Uses a radio effect preset file (ini) instead of a builtin preset.
+	// The engine loads the file once, when it takes the voice.
+	void radio_effect(const std::filesystem::path& preset_file) {
+		radio_effect(radio_preset_e::count);
+		_radio_effect_file = preset_file;
+	}
+	const std::filesystem::path& radio_effect_file() const {
+		return _radio_effect_file;
+	}
+
+	// Either a builtin preset or a preset file is set.
+	bool has_radio_effect() const {
+		return _radio_effect != radio_preset_e::count
+				|| !_radio_effect_file.empty();
+	}
+
 	void compression(compression_e comp) {
 		assert(comp != compression_e::count);
 		_radio_effect = radio_preset_e::count;
+		_radio_effect_file.clear();
 		_compression = comp;
 	}
 	compression_e compression() const {
@@ -112,6 +147,7 @@ struct voice {
 	void bit_depth(bit_depth_e bd) {
 		assert(bd != bit_depth_e::count);
 		_radio_effect = radio_preset_e::count;
+		_radio_effect_file.clear();
 		_bit_depth = bd;
 	}
 	bit_depth_e bit_depth() const {
@@ -121,6 +157,7 @@ struct voice {
 	void sampling_rate(sampling_rate_e sr) {
 		assert(sr != sampling_rate_e::count);
 		_radio_effect = radio_preset_e::count;
+		_radio_effect_file.clear();
 		_sampling_rate = sr;
 	}
 	sampling_rate_e sampling_rate() const {
@@ -149,6 +186,7 @@ struct voice {
 private:
 	// If set, supersedes audio settings.
 	radio_preset_e _radio_effect = radio_preset_e::count;
+	std::filesystem::path _radio_effect_file;
 
 	// Audio settings.
 	compression_e _compression = compression_e::none;
@@ -163,4 +201,26 @@ inline constexpr size_t radio_preset_count() {
 	return size_t(radio_preset_e::count);
 }
 
+// Samples per second.
+inline constexpr size_t to_value(sampling_rate_e sr) {
+	switch (sr) {
+	case sampling_rate_e::_8: {
+		return 8000;
+	} break;
+	case sampling_rate_e::_11: {
+		return 11025;
+	} break;
+	case sampling_rate_e::_22: {
+		return 22050;
+	} break;
+	case sampling_rate_e::_44: {
+		return 44100;
+	} break;
+	default: {
+		assert(false);
+	} break;
+	}
+	return (std::numeric_limits<size_t>::max)();
+}
+
 } // namespace wsay
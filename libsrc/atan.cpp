@@ -0,0 +1,111 @@
+#include "private_include/atan.hpp"
+
+#include <array>
+#include <cassert>
+
+#if defined(_M_X64) || defined(__SSE2__) \
+		|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WSAY_ATAN_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace wsay {
+namespace {
+// atan over [0, 1], plus one entry so interpolation never reads past the end.
+constexpr size_t atan_table_size = 512;
+
+const std::array<float, atan_table_size + 1>& get_atan_table() {
+	static const std::array<float, atan_table_size + 1> ret = []() {
+		std::array<float, atan_table_size + 1> r{};
+		for (size_t i = 0; i < r.size(); ++i) {
+			r[i] = float(std::atan(double(i) / double(atan_table_size)));
+		}
+		return r;
+	}();
+	return ret;
+}
+
+void distort_poly(
+		float drive, float norm, float atten, std::span<float> block) {
+	size_t i = 0;
+#if defined(WSAY_ATAN_SSE2)
+	// Same operations as atan_poly, output is identical.
+	const __m128 sign_mask = _mm_set1_ps(-0.f);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 half_pi = _mm_set1_ps(std::numbers::pi_v<float> * 0.5f);
+	const __m128 d = _mm_set1_ps(drive);
+	const __m128 n = _mm_set1_ps(norm);
+	const __m128 at = _mm_set1_ps(atten);
+
+	for (; i + 4 <= block.size(); i += 4) {
+		__m128 x = _mm_mul_ps(d, _mm_loadu_ps(block.data() + i));
+		__m128 ax = _mm_andnot_ps(sign_mask, x);
+		// Operand order matches std::min and std::max with NaNs.
+		__m128 a = _mm_div_ps(_mm_min_ps(one, ax), _mm_max_ps(one, ax));
+		__m128 s = _mm_mul_ps(a, a);
+
+		__m128 p = _mm_set1_ps(-0.01172120f);
+		p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(0.05265332f));
+		p = _mm_sub_ps(_mm_mul_ps(p, s), _mm_set1_ps(0.11643287f));
+		p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(0.19354346f));
+		p = _mm_sub_ps(_mm_mul_ps(p, s), _mm_set1_ps(0.33262347f));
+		p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(0.99997726f));
+		__m128 r = _mm_mul_ps(a, p);
+
+		__m128 above = _mm_cmpgt_ps(ax, one);
+		r = _mm_or_ps(_mm_and_ps(above, _mm_sub_ps(half_pi, r)),
+				_mm_andnot_ps(above, r));
+		r = _mm_or_ps(_mm_andnot_ps(sign_mask, r), _mm_and_ps(sign_mask, x));
+
+		r = _mm_mul_ps(_mm_mul_ps(r, n), at);
+		_mm_storeu_ps(block.data() + i, r);
+	}
+#endif
+	for (; i < block.size(); ++i) {
+		block[i] = atan_poly(drive * block[i]) * norm * atten;
+	}
+}
+} // namespace
+
+float atan_table(float x) {
+	const std::array<float, atan_table_size + 1>& table = get_atan_table();
+
+	// Fold to [0, 1], atan(x) = pi/2 - atan(1/x) above 1.
+	const float ax = std::abs(x);
+	const float a = (std::min)(ax, 1.f) / (std::max)(ax, 1.f);
+
+	// NaN would index garbage.
+	if (a != a) {
+		return a;
+	}
+
+	const float pos = a * float(atan_table_size);
+	const size_t i = (std::min)(size_t(pos), atan_table_size - 1);
+	const float t = pos - float(i);
+	float r = table[i] + (table[i + 1] - table[i]) * t;
+	r = ax > 1.f ? std::numbers::pi_v<float> * 0.5f - r : r;
+	return std::copysign(r, x);
+}
+
+void distort(atan_e path, float drive, float norm, float atten,
+		std::span<float> block) {
+	switch (path) {
+	case atan_e::precise: {
+		for (float& s : block) {
+			s = std::atan(drive * s) * norm * atten;
+		}
+	} break;
+	case atan_e::poly: {
+		distort_poly(drive, norm, atten, block);
+	} break;
+	case atan_e::table: {
+		for (float& s : block) {
+			s = atan_table(drive * s) * norm * atten;
+		}
+	} break;
+	default: {
+		assert(false);
+	} break;
+	}
+}
+} // namespace wsay
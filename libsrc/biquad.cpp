@@ -0,0 +1,268 @@
+#include "private_include/biquad.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <numbers>
+
+#if defined(_M_X64) || defined(__SSE2__) \
+		|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WSAY_BIQUAD_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace wsay {
+namespace {
+biquad_coefs make_peaking(const biquad_args& args, float k, float v) {
+	biquad_coefs ret{};
+	if (args.gain >= 0.f) {
+		const float norm = 1.f / (1.f + 1.f / args.q * k + k * k);
+		ret.a0 = (1.f + v / args.q * k + k * k) * norm;
+		ret.a1 = 2.f * (k * k - 1.f) * norm;
+		ret.a2 = (1.f - v / args.q * k + k * k) * norm;
+		ret.b1 = ret.a1;
+		ret.b2 = (1.f - 1.f / args.q * k + k * k) * norm;
+	} else {
+		const float norm = 1.f / (1.f + v / args.q * k + k * k);
+		ret.a0 = (1.f + 1.f / args.q * k + k * k) * norm;
+		ret.a1 = 2.f * (k * k - 1.f) * norm;
+		ret.a2 = (1.f - 1.f / args.q * k + k * k) * norm;
+		ret.b1 = ret.a1;
+		ret.b2 = (1.f - v / args.q * k + k * k) * norm;
+	}
+	return ret;
+}
+
+biquad_coefs make_lowshelf(const biquad_args& args, float k, float v) {
+	constexpr float sqrt2 = std::numbers::sqrt2_v<float>;
+	const float sqrt2v = std::sqrt(2.f * v);
+
+	biquad_coefs ret{};
+	if (args.gain >= 0.f) {
+		const float norm = 1.f / (1.f + sqrt2 * k + k * k);
+		ret.a0 = (1.f + sqrt2v * k + v * k * k) * norm;
+		ret.a1 = 2.f * (v * k * k - 1.f) * norm;
+		ret.a2 = (1.f - sqrt2v * k + v * k * k) * norm;
+		ret.b1 = 2.f * (k * k - 1.f) * norm;
+		ret.b2 = (1.f - sqrt2 * k + k * k) * norm;
+	} else {
+		const float norm = 1.f / (1.f + sqrt2v * k + v * k * k);
+		ret.a0 = (1.f + sqrt2 * k + k * k) * norm;
+		ret.a1 = 2.f * (k * k - 1.f) * norm;
+		ret.a2 = (1.f - sqrt2 * k + k * k) * norm;
+		ret.b1 = 2.f * (v * k * k - 1.f) * norm;
+		ret.b2 = (1.f - sqrt2v * k + v * k * k) * norm;
+	}
+	return ret;
+}
+
+biquad_coefs make_highshelf(const biquad_args& args, float k, float v) {
+	constexpr float sqrt2 = std::numbers::sqrt2_v<float>;
+	const float sqrt2v = std::sqrt(2.f * v);
+
+	biquad_coefs ret{};
+	if (args.gain >= 0.f) {
+		const float norm = 1.f / (1.f + sqrt2 * k + k * k);
+		ret.a0 = (v + sqrt2v * k + k * k) * norm;
+		ret.a1 = 2.f * (k * k - v) * norm;
+		ret.a2 = (v - sqrt2v * k + k * k) * norm;
+		ret.b1 = 2.f * (k * k - 1.f) * norm;
+		ret.b2 = (1.f - sqrt2 * k + k * k) * norm;
+	} else {
+		const float norm = 1.f / (v + sqrt2v * k + k * k);
+		ret.a0 = (1.f + sqrt2 * k + k * k) * norm;
+		ret.a1 = 2.f * (k * k - 1.f) * norm;
+		ret.a2 = (1.f - sqrt2 * k + k * k) * norm;
+		ret.b1 = 2.f * (k * k - v) * norm;
+		ret.b2 = (v - sqrt2v * k + k * k) * norm;
+	}
+	return ret;
+}
+
+#if defined(WSAY_BIQUAD_SSE2)
+// Moves every lane up by one, lane 0 gets in.
+__m128 shift_in(__m128 v, float in) {
+	__m128 shifted = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4));
+	return _mm_move_ss(shifted, _mm_set_ss(in));
+}
+
+// Lane l processes sample t - l, it is idle before its first sample and
+// after its last one.
+__m128 active_mask(size_t t, size_t size) {
+	auto active = [&](int l) {
+		return (t >= size_t(l) && t - size_t(l) < size) ? -1 : 0;
+	};
+	return _mm_castsi128_ps(
+			_mm_setr_epi32(active(0), active(1), active(2), active(3)));
+}
+
+__m128 select(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+} // namespace
+
+biquad_coefs make_biquad_coefs(const biquad_args& args) {
+	const float k = std::tan(std::numbers::pi_v<float> * args.freq);
+	const float norm = 1.f / (1.f + k / args.q + k * k);
+	const float v = std::pow(10.f, std::abs(args.gain) / 20.f);
+
+	biquad_coefs ret{};
+	switch (args.type) {
+	case biquad_type_e::lowpass: {
+		ret.a0 = k * k * norm;
+		ret.a1 = 2.f * ret.a0;
+		ret.a2 = ret.a0;
+		ret.b1 = 2.f * (k * k - 1.f) * norm;
+		ret.b2 = (1.f - k / args.q + k * k) * norm;
+	} break;
+	case biquad_type_e::highpass: {
+		ret.a0 = 1.f * norm;
+		ret.a1 = -2.f * ret.a0;
+		ret.a2 = ret.a0;
+		ret.b1 = 2.f * (k * k - 1.f) * norm;
+		ret.b2 = (1.f - k / args.q + k * k) * norm;
+	} break;
+	case biquad_type_e::bandbass: {
+		ret.a0 = k / args.q * norm;
+		ret.a1 = 0.f;
+		ret.a2 = -ret.a0;
+		ret.b1 = 2.f * (k * k - 1.f) * norm;
+		ret.b2 = (1.f - k / args.q + k * k) * norm;
+	} break;
+	case biquad_type_e::notch: {
+		ret.a0 = (1.f + k * k) * norm;
+		ret.a1 = 2.f * (k * k - 1.f) * norm;
+		ret.a2 = ret.a0;
+		ret.b1 = ret.a1;
+		ret.b2 = (1.f - k / args.q + k * k) * norm;
+	} break;
+	case biquad_type_e::peaking: {
+		ret = make_peaking(args, k, v);
+	} break;
+	case biquad_type_e::lowshelf: {
+		ret = make_lowshelf(args, k, v);
+	} break;
+	case biquad_type_e::highshelf: {
+		ret = make_highshelf(args, k, v);
+	} break;
+	default: {
+		assert(false);
+	} break;
+	}
+	return ret;
+}
+
+void biquad(
+		const biquad_coefs& c, biquad_state& state, std::span<float> block) {
+	// Each output depends on the previous ones, this doesn't vectorize.
+	float z1 = state.z1;
+	float z2 = state.z2;
+	for (float& s : block) {
+		float ret = s * c.a0 + z1;
+		z1 = s * c.a1 + z2 - c.b1 * ret;
+		z2 = s * c.a2 - c.b2 * ret;
+		s = ret;
+	}
+	state.z1 = z1;
+	state.z2 = z2;
+}
+
+biquad_cascade::biquad_cascade(std::span<const biquad_args> sections) {
+	for (const biquad_args& args : sections) {
+		if (args.type == biquad_type_e::count) {
+			continue;
+		}
+		assert(_size < biquad_max_sections);
+
+		biquad_coefs c = make_biquad_coefs(args);
+		group& g = _groups[_size / lanes];
+		g.a0[g.size] = c.a0;
+		g.a1[g.size] = c.a1;
+		g.a2[g.size] = c.a2;
+		g.b1[g.size] = c.b1;
+		g.b2[g.size] = c.b2;
+		++g.size;
+		++_size;
+	}
+}
+
+size_t biquad_cascade::size() const {
+	return _size;
+}
+
+bool biquad_cascade::empty() const {
+	return _size == 0;
+}
+
+void biquad_cascade::process(std::span<float> block) {
+	process(simd_best(), block);
+}
+
+void biquad_cascade::process(simd_e path, std::span<float> block) {
+	assert(simd_available(path));
+
+	for (group& g : _groups) {
+		if (g.size == 0) {
+			break;
+		}
+
+#if defined(WSAY_BIQUAD_SSE2)
+		// A lone section is faster without the lane shuffling.
+		if (path != simd_e::scalar && g.size > 1 && !block.empty()) {
+			const __m128 a0 = _mm_load_ps(g.a0.data());
+			const __m128 a1 = _mm_load_ps(g.a1.data());
+			const __m128 a2 = _mm_load_ps(g.a2.data());
+			const __m128 b1 = _mm_load_ps(g.b1.data());
+			const __m128 b2 = _mm_load_ps(g.b2.data());
+			__m128 z1 = _mm_load_ps(g.z1.data());
+			__m128 z2 = _mm_load_ps(g.z2.data());
+
+			// Previous step outputs, the next lanes inputs.
+			__m128 y = _mm_setzero_ps();
+			constexpr size_t last = lanes - 1;
+			const size_t size = block.size();
+			for (size_t t = 0; t < size + last; ++t) {
+				__m128 x = shift_in(y, t < size ? block[t] : 0.f);
+				y = _mm_add_ps(_mm_mul_ps(x, a0), z1);
+				__m128 nz1 = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(x, a1), z2),
+						_mm_mul_ps(b1, y));
+				__m128 nz2 = _mm_sub_ps(_mm_mul_ps(x, a2), _mm_mul_ps(b2, y));
+
+				if (t >= last && t < size) {
+					z1 = nz1;
+					z2 = nz2;
+				} else {
+					// Filling or draining the pipeline.
+					__m128 mask = active_mask(t, size);
+					z1 = select(mask, nz1, z1);
+					z2 = select(mask, nz2, z2);
+				}
+
+				if (t >= last) {
+					block[t - last] = _mm_cvtss_f32(
+							_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+				}
+			}
+
+			_mm_store_ps(g.z1.data(), z1);
+			_mm_store_ps(g.z2.data(), z2);
+			continue;
+		}
+#endif
+
+		for (size_t i = 0; i < g.size; ++i) {
+			biquad_coefs c{
+				.a0 = g.a0[i],
+				.a1 = g.a1[i],
+				.a2 = g.a2[i],
+				.b1 = g.b1[i],
+				.b2 = g.b2[i],
+			};
+			biquad_state state{ .z1 = g.z1[i], .z2 = g.z2[i] };
+			biquad(c, state, block);
+			g.z1[i] = state.z1;
+			g.z2[i] = state.z2;
+		}
+	}
+}
+} // namespace wsay
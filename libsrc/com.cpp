@@ -1,4 +1,5 @@
 ﻿#include "private_include/com.hpp"
+#include "private_include/fx_chain.hpp"
 
 #include <algorithm>
 #include <cassert>
@@ -12,7 +13,6 @@
 #include <format>
 #include <iostream>
 #include <memory>
-#include <regex>
 #include <thread>
 
 
@@ -34,18 +34,6 @@ struct coinit {
 };
 inline const coinit _coinit;
 
-std::wstring tts_voice::format_sentence(const std::wstring& in) const {
-	if (text_modifiers.empty()) {
-		return in;
-	}
-
-	std::wstring ret = in;
-	for (const std::function<void(std::wstring&)>& func : text_modifiers) {
-		func(ret);
-	}
-	return ret;
-}
-
 SPSTREAMFORMAT to_spstreamformat(compression_e compression,
 		bit_depth_e bit_depth, sampling_rate_e sampling_rate) {
 	// All mono.
@@ -148,6 +136,137 @@ SPSTREAMFORMAT to_spstreamformat(const voice& vopts) {
 			vopts.compression(), vopts.bit_depth(), vopts.sampling_rate());
 }
 
+SPSTREAMFORMAT to_fx_spstreamformat(const voice& vopts) {
+	return to_spstreamformat(
+			vopts.compression(), vopts.bit_depth(), fx_output_rate(vopts));
+}
+
+CComPtr<IStream> make_data_stream() {
+	CComPtr<IStream> ret;
+	if (!SUCCEEDED(CreateStreamOnHGlobal(nullptr, true, &ret))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't create data stream.");
+	}
+	return ret;
+}
+
+void write_through_stream::reset(
+		const std::function<bool(std::span<const std::byte>)>* on_write) {
+	_on_write = on_write;
+	_position = 0;
+	_aborted = false;
+}
+
+bool write_through_stream::aborted() const {
+	return _aborted;
+}
+
+STDMETHODIMP write_through_stream::Read(void*, ULONG, ULONG* read) {
+	if (read != nullptr) {
+		*read = 0;
+	}
+	return STG_E_ACCESSDENIED;
+}
+
+STDMETHODIMP write_through_stream::Write(
+		const void* pv, ULONG cb, ULONG* written) {
+	if (written != nullptr) {
+		*written = 0;
+	}
+	if (_on_write == nullptr || _aborted) {
+		return STG_E_ACCESSDENIED;
+	}
+	if (pv == nullptr) {
+		return STG_E_INVALIDPOINTER;
+	}
+
+	// Exceptions can't cross into SAPI, failing the write aborts speaking.
+	try {
+		if (!(*_on_write)(
+					{ reinterpret_cast<const std::byte*>(pv), size_t(cb) })) {
+			_aborted = true;
+			return E_ABORT;
+		}
+	} catch (...) {
+		return E_FAIL;
+	}
+
+	_position += cb;
+	if (written != nullptr) {
+		*written = cb;
+	}
+	return S_OK;
+}
+
+STDMETHODIMP write_through_stream::Seek(
+		LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER* new_pos) {
+	// What was written is gone, only seeking in place works.
+	const bool in_place = (origin == STREAM_SEEK_CUR && move.QuadPart == 0)
+			|| (origin != STREAM_SEEK_CUR
+					&& uint64_t(move.QuadPart) == _position);
+	if (!in_place) {
+		return STG_E_INVALIDFUNCTION;
+	}
+	if (new_pos != nullptr) {
+		new_pos->QuadPart = _position;
+	}
+	return S_OK;
+}
+
+STDMETHODIMP write_through_stream::SetSize(ULARGE_INTEGER) {
+	return S_OK;
+}
+
+STDMETHODIMP write_through_stream::CopyTo(
+		IStream*, ULARGE_INTEGER, ULARGE_INTEGER*, ULARGE_INTEGER*) {
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP write_through_stream::Commit(DWORD) {
+	return S_OK;
+}
+
+STDMETHODIMP write_through_stream::Revert() {
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP write_through_stream::LockRegion(
+		ULARGE_INTEGER, ULARGE_INTEGER, DWORD) {
+	return STG_E_INVALIDFUNCTION;
+}
+
+STDMETHODIMP write_through_stream::UnlockRegion(
+		ULARGE_INTEGER, ULARGE_INTEGER, DWORD) {
+	return STG_E_INVALIDFUNCTION;
+}
+
+STDMETHODIMP write_through_stream::Stat(STATSTG* stats, DWORD) {
+	if (stats == nullptr) {
+		return STG_E_INVALIDPOINTER;
+	}
+	*stats = {};
+	stats->type = STGTY_STREAM;
+	stats->cbSize.QuadPart = _position;
+	stats->grfMode = STGM_WRITE;
+	return S_OK;
+}
+
+STDMETHODIMP write_through_stream::Clone(IStream** stream) {
+	if (stream != nullptr) {
+		*stream = nullptr;
+	}
+	return E_NOTIMPL;
+}
+
+CComPtr<write_through_stream> make_write_through_stream() {
+	CComObject<write_through_stream>* obj = nullptr;
+	if (!SUCCEEDED(CComObject<write_through_stream>::CreateInstance(&obj))) {
+		fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
+				"Couldn't create write through stream.");
+	}
+	return CComPtr<write_through_stream>{ obj };
+}
+
 std::vector<CComPtr<ISpObjectToken>> make_voice_tokens() {
 	constexpr std::wstring_view win10_regkey
 			= L"HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Speech_"
@@ -227,19 +346,86 @@ std::vector<std::wstring> make_names(
 	return ret;
 }
 
-wsay::tts_voice make_tts_voice(const voice& vopts,
-		const std::vector<CComPtr<ISpObjectToken>>& voice_tokens) {
-	tts_voice ret{};
+std::vector<std::wstring> make_ids(
+		const std::vector<CComPtr<ISpObjectToken>>& ptrs) {
+	std::vector<std::wstring> ret;
+	for (const CComPtr<ISpObjectToken>& ptr : ptrs) {
+		wil::unique_cotaskmem_string id;
+		if (!SUCCEEDED(ptr->GetId(&id))) {
+			ret.push_back({});
+			continue;
+		}
+		ret.push_back(std::wstring{ id.get() });
+	}
+	return ret;
+}
 
-	// Create underlying data stream.
-	{
-		if (!SUCCEEDED(
-					CreateStreamOnHGlobal(nullptr, true, &ret.data_stream))) {
-			fea::maybe_throw<std::runtime_error>(
-					__FUNCTION__, __LINE__, "Couldn't create data stream.");
+CComPtr<ISpObjectToken> make_token(const std::wstring& id) {
+	CComPtr<ISpObjectToken> ret;
+	if (!SUCCEEDED(SpGetTokenFromId(id.c_str(), &ret))) {
+		return nullptr;
+	}
+	return ret;
+}
+
+std::wstring enumeration_signature() {
+	// Installing or removing a voice adds or removes a token key, which
+	// updates its parent key write time.
+	constexpr const wchar_t* regkeys[] = {
+		L"SOFTWARE\\Microsoft\\Speech\\Voices\\Tokens",
+		L"SOFTWARE\\Microsoft\\Speech_OneCore\\Voices\\Tokens",
+		L"SOFTWARE\\Microsoft\\Speech_OneCore\\CortanaVoices\\Tokens",
+	};
+
+	std::wstring ret;
+	for (const wchar_t* regkey : regkeys) {
+		wil::unique_hkey key;
+		FILETIME time{};
+		if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, regkey, 0, KEY_READ, key.put())
+						!= ERROR_SUCCESS
+				|| RegQueryInfoKeyW(key.get(), nullptr, nullptr, nullptr,
+						   nullptr, nullptr, nullptr, nullptr, nullptr,
+						   nullptr, nullptr, &time)
+						!= ERROR_SUCCESS) {
+			ret += L"- ";
+			continue;
 		}
+		ret += std::format(
+				L"{:x}{:08x} ", time.dwHighDateTime, time.dwLowDateTime);
+	}
+
+	// Active playback endpoints, only their ids. Names are what is slow.
+	CComPtr<IMMDeviceEnumerator> dev_enum;
+	CComPtr<IMMDeviceCollection> endpoints;
+	unsigned int count = 0;
+	if (!SUCCEEDED(dev_enum.CoCreateInstance(__uuidof(MMDeviceEnumerator)))
+			|| !SUCCEEDED(dev_enum->EnumAudioEndpoints(
+					eRender, DEVICE_STATE_ACTIVE, &endpoints))
+			|| !SUCCEEDED(endpoints->GetCount(&count))) {
+		return ret;
 	}
 
+	for (unsigned int i = 0; i < count; ++i) {
+		CComPtr<IMMDevice> endpoint;
+		wil::unique_cotaskmem_string id;
+		if (!SUCCEEDED(endpoints->Item(i, &endpoint))
+				|| !SUCCEEDED(endpoint->GetId(&id))) {
+			ret += L"- ";
+			continue;
+		}
+		ret += id.get();
+		ret += L" ";
+	}
+	return ret;
+}
+
+wsay::tts_voice make_tts_voice(
+		const voice& vopts, ISpObjectToken* voice_token) {
+	tts_voice ret{};
+
+	// Create underlying data stream.
+	ret.data_stream = make_write_through_stream();
+
 	// Create sp stream which uses backing istream.
 	{
 		SPSTREAMFORMAT fmt_e = to_spstreamformat(vopts);
@@ -269,93 +455,125 @@ wsay::tts_voice make_tts_voice(const voice& vopts,
 			fea::maybe_throw<std::runtime_error>(
 					__FUNCTION__, __LINE__, "Couldn't create tts voice.");
 		}
-		if (!SUCCEEDED(ret.voice->SetVoice(voice_tokens.at(vopts.voice_idx)))) {
+		assert(voice_token != nullptr);
+		if (!SUCCEEDED(ret.voice->SetVoice(voice_token))) {
 			fea::maybe_throw<std::runtime_error>(
 					__FUNCTION__, __LINE__, "Couldn't set voice token.");
 		}
 
-		uint16_t vol = std::clamp(vopts.volume, 0_u8, 100_u8);
-		if (!SUCCEEDED(ret.voice->SetVolume(vol))) {
-			fea::maybe_throw<std::runtime_error>(
-					__FUNCTION__, __LINE__, "Couldn't set tts voice volume.");
-		}
-
-		long speed = std::clamp(int(vopts.speed), 0, 100);
-		double speed_temp = (speed / 100.0) * 20.0;
-		speed = long(speed_temp) - 10;
-		if (!SUCCEEDED(ret.voice->SetRate(speed))) {
-			fea::maybe_throw<std::runtime_error>(
-					__FUNCTION__, __LINE__, "Couldn't set tts voice rate.");
-		}
 		if (!SUCCEEDED(ret.voice->SetOutput(ret.sp_stream, false))) {
 			fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
 					"Couldn't set tts voice sp stream.");
 		}
 	}
 
+	configure_tts_voice(vopts, ret);
+	return ret;
+}
+
+void configure_tts_voice(const voice& vopts, tts_voice& tts) {
+	uint16_t vol = std::clamp(vopts.volume, 0_u8, 100_u8);
+	if (!SUCCEEDED(tts->SetVolume(vol))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't set tts voice volume.");
+	}
+
+	long speed = std::clamp(int(vopts.speed), 0, 100);
+	double speed_temp = (speed / 100.0) * 20.0;
+	speed = long(speed_temp) - 10;
+	if (!SUCCEEDED(tts->SetRate(speed))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't set tts voice rate.");
+	}
+
 	// Add flags that are driven by voice options.
+	tts.flags = 0;
 	if (vopts.xml_parse) {
-		ret.flags |= SPF_IS_XML;
+		tts.flags |= SPF_IS_XML;
 	} else {
-		ret.flags |= SPF_IS_NOT_XML;
-	}
-
-	// Add xml tags that are driven by voice options.
-	if (vopts.pitch != 10_u8) {
-		int pitch = int(std::clamp(vopts.pitch, 0_u8, 20_u8));
-		pitch -= 10;
-		assert(pitch >= -10 && pitch <= 10);
-
-		ret.text_modifiers.push_back([p = pitch](std::wstring& text) {
-			assert(p >= -10 && p <= 10);
-			text = std::format(L"<pitch absmiddle=\"{}\">{}</pitch>",
-					std::to_wstring(p), text);
-		});
-	}
-
-	// Add more involved text parsing processes.
-	if (vopts.paragraph_pause_ms != (std::numeric_limits<uint16_t>::max)()) {
-		// Text cleanup.
-		// Might be needed for other parsing.
-		ret.text_modifiers.push_back([](std::wstring& text) {
-			static const std::wregex spaces_re{
-				L"[ \\t\\v]+",
-				std::regex_constants::optimize | std::regex_constants::icase,
-			};
-			static const std::wregex line_endings_re{
-				L"\\s*\\n+\\s*",
-				std::regex_constants::optimize | std::regex_constants::icase,
-			};
-
-			// Cleanup \r\n, multiple consecutive tabs + spaces, etc.
-			fea::replace_all_inplace(text, L'\r', L' ');
-			fea::replace_all_inplace(text, L'\f', L' ');
-			text = std::regex_replace(text, spaces_re, L" ");
-			text = std::regex_replace(text, line_endings_re, L"\n");
-		});
-
-		// Pragraph pause insertion.
-		ret.text_modifiers.push_back(
-				[ms = vopts.paragraph_pause_ms](std::wstring& text) {
-					const std::wstring paragraph_xml
-							= std::format(L"<silence msec=\"{}\"/>", ms);
-
-					// Add silence speech xml.
-					fea::replace_all_inplace(text, L"\n", paragraph_xml);
-				});
+		tts.flags |= SPF_IS_NOT_XML;
 	}
+}
 
+CComPtr<ISpMMSysAudio> make_audio_out(ISpObjectToken* device_token) {
+	assert(device_token != nullptr);
+	CComPtr<ISpMMSysAudio> ret;
+	if (!SUCCEEDED(SpCreateObjectFromToken(device_token, &ret))) {
+		fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
+				"Couldn't create audio out from token.");
+	}
 	return ret;
 }
 
-wsay::device_output make_device_output(const voice_output& vout,
-		const std::vector<CComPtr<ISpObjectToken>>& device_tokens) {
+void set_audio_format(ISpMMSysAudio* audio, SPSTREAMFORMAT format) {
+	CSpStreamFormat audio_fmt;
+	if (!SUCCEEDED(audio_fmt.AssignFormat(format))) {
+		fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
+				"Couldn't set audio format on device output.");
+	}
+
+	// The format can only change while closed.
+	if (!SUCCEEDED(audio->SetState(SPAS_CLOSE, 0))
+			|| !SUCCEEDED(audio->SetFormat(
+					audio_fmt.FormatId(), audio_fmt.WaveFormatExPtr()))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't set audio out format.");
+	}
+	if (!SUCCEEDED(audio->SetState(SPAS_RUN, 0))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't start audio out.");
+	}
+}
+
+void purge_audio(ISpMMSysAudio* audio) {
+	// Stopping an output resets the device, which drops its buffers.
+	if (!SUCCEEDED(audio->SetState(SPAS_STOP, 0))
+			|| !SUCCEEDED(audio->SetState(SPAS_RUN, 0))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't purge audio out.");
+	}
+}
+
+void write_audio(ISpMMSysAudio* audio, std::span<const std::byte> pcm) {
+	unsigned long written = 0;
+	if (!SUCCEEDED(audio->Write(pcm.data(), uint32_t(pcm.size()), &written))
+			|| written != pcm.size()) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't write to audio out.");
+	}
+}
+
+bool audio_drained(ISpMMSysAudio* audio) {
+	SPAUDIOSTATUS status{};
+	if (!SUCCEEDED(audio->GetStatus(&status))) {
+		return true;
+	}
+	return status.CurDevicePos >= status.CurSeekPos;
+}
+
+bool is_file_format(const voice& vopts) {
+	// See make_device_output.
+	const sampling_rate_e file_rate = vopts.radio_effect_native_rate
+			? fx_output_rate(vopts)
+			: output_sample_rate;
+	return vopts.compression() == output_compression
+			&& vopts.bit_depth() == output_bit_depth
+			&& fx_output_rate(vopts) == file_rate;
+}
+
+wsay::device_output make_device_output(const voice& vopts,
+		const voice_output& vout, ISpObjectToken* device_token) {
 	device_output ret{};
 
-	// All outputs use same prescribed format.
+	// All outputs use same prescribed format, unless effects output at their
+	// native rate. Then files keep that rate and devices resample.
 	CSpStreamFormat audio_fmt;
 	SPSTREAMFORMAT fmt_e = to_spstreamformat(
 			output_compression, output_bit_depth, output_sample_rate);
+	if (vout.type == output_type_e::file && vopts.radio_effect_native_rate) {
+		fmt_e = to_spstreamformat(
+				output_compression, output_bit_depth, fx_output_rate(vopts));
+	}
 	if (!SUCCEEDED(audio_fmt.AssignFormat(fmt_e))) {
 		fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
 				"Couldn't set audio format on device output.");
@@ -365,13 +583,9 @@ wsay::device_output make_device_output(const voice_output& vout,
 	case output_type_e::device: {
 		assert(vout.device_idx != (std::numeric_limits<size_t>::max)());
 		assert(vout.file_path.empty());
+		assert(device_token != nullptr);
 
-		if (!SUCCEEDED(SpCreateObjectFromToken(
-					device_tokens.at(vout.device_idx), &ret.sys_audio))) {
-			fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
-					"Couldn't create audio out from token.");
-		}
-
+		ret.sys_audio = make_audio_out(device_token);
 		if (!SUCCEEDED(ret.sys_audio->SetFormat(
 					audio_fmt.FormatId(), audio_fmt.WaveFormatExPtr()))) {
 			fea::maybe_throw<std::runtime_error>(
@@ -417,36 +631,61 @@ wsay::device_output make_device_output(const voice_output& vout,
 	return ret;
 }
 
-void clone_input_stream(
-		const tts_voice& tts, std::vector<device_output>& device_outputs) {
-	GUID fmt_guid{};
-	wil::unique_cotaskmem_ptr<WAVEFORMATEX> wave_fmt;
-	if (!SUCCEEDED(tts.sp_stream->GetFormat(
-				&fmt_guid, wil::out_param(wave_fmt)))) {
+CComPtr<ISpStream> make_pcm_stream(
+		const voice& vopts, std::span<const std::byte> pcm) {
+	CComPtr<IStream> data_stream = make_data_stream();
+	unsigned long bytes_written = 0;
+	if (!SUCCEEDED(data_stream->Write(
+				pcm.data(), uint32_t(pcm.size()), &bytes_written))
+			|| bytes_written != pcm.size()) {
 		fea::maybe_throw<std::runtime_error>(
-				__FUNCTION__, __LINE__, "Couldn't get input stream format.");
+				__FUNCTION__, __LINE__, "Couldn't write output stream.");
+	}
+	if (!SUCCEEDED(IStream_Reset(data_stream))) {
+		fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
+				"Couldn't reset output stream playhead.");
 	}
 
-	for (device_output& outv : device_outputs) {
-		if (!SUCCEEDED(tts.data_stream->Clone(&outv.data_stream_clone))) {
-			fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
-					"Couldn't clone input data stream format.");
-		}
-
-		if (!SUCCEEDED(outv.sp_stream_clone.CoCreateInstance(CLSID_SpStream))) {
-			fea::maybe_throw<std::runtime_error>(
-					__FUNCTION__, __LINE__, "Couldn't create clone sp stream.");
-		}
+	// Effects may have changed the stream sampling rate.
+	CSpStreamFormat audio_fmt;
+	if (!SUCCEEDED(audio_fmt.AssignFormat(to_fx_spstreamformat(vopts)))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't set output stream format.");
+	}
 
-		if (!SUCCEEDED(outv.sp_stream_clone->SetBaseStream(
-					outv.data_stream_clone, fmt_guid, wave_fmt.get()))) {
-			fea::maybe_throw<std::runtime_error>(
-					__FUNCTION__, __LINE__, "Couldn't set clone base stream.");
-		}
+	CComPtr<ISpStream> ret;
+	if (!SUCCEEDED(ret.CoCreateInstance(CLSID_SpStream))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't create output sp stream.");
+	}
+	if (!SUCCEEDED(ret->SetBaseStream(data_stream, audio_fmt.FormatId(),
+				audio_fmt.WaveFormatExPtr()))) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't set output base stream.");
 	}
+	return ret;
 }
 
 
+std::wstring default_output_device_id() {
+	CComPtr<IMMDeviceEnumerator> dev_enum;
+	if (!SUCCEEDED(dev_enum.CoCreateInstance(__uuidof(MMDeviceEnumerator)))) {
+		return {};
+	}
+
+	CComPtr<IMMDevice> default_device;
+	if (!SUCCEEDED(dev_enum->GetDefaultAudioEndpoint(
+				eRender, eMultimedia, &default_device))) {
+		return {};
+	}
+
+	wil::unique_cotaskmem_string id_str;
+	if (!SUCCEEDED(default_device->GetId(&id_str))) {
+		return {};
+	}
+	return std::wstring{ id_str.get() };
+}
+
 size_t default_output_device_idx(
 		const std::vector<std::wstring>& device_names) {
 	CComPtr<IMMDeviceEnumerator> dev_enum;
@@ -1,51 +1,621 @@
 #include "wsay/engine.hpp"
-#include "private_include/com.hpp"
+#include "private_include/backend.hpp"
 #include "private_include/fx.hpp"
+#include "private_include/fx_presets.hpp"
+#include "private_include/object_pool.hpp"
+#include "private_include/render_cache.hpp"
+#include "private_include/speech_queue.hpp"
+#include "private_include/spsc_ring.hpp"
+#include "private_include/stage_stats.hpp"
+#include "private_include/text.hpp"
 #include "wsay/voice.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <fea/numerics/literals.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <fea/utils/scope.hpp>
 #include <fea/utils/throw.hpp>
-#include <format>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string_view>
 #include <thread>
-
-using namespace fea::literals;
+#include <utility>
+#include <vector>
 
 namespace wsay {
+namespace {
+// Shortest text piece synthesized on its own when pipelining, shorter
+// sentences are merged with the next ones.
+constexpr size_t pipeline_min_chunk = 32;
+
+// Synthesized pcm buffered between the synthesizer and the effects when
+// streaming, a few seconds of audio.
+constexpr size_t stream_ring_size = 256 * 1024;
+
+// Streamed pcm is processed and played in pieces of this duration.
+constexpr size_t stream_block_ms = 100;
+} // namespace
+
 struct async_token_imp {
 	voice vopts;
-	tts_voice tts;
-	std::vector<device_output> device_outputs;
+	text_formatter formatter;
+	std::unique_ptr<synthesizer> tts;
+	std::vector<std::unique_ptr<audio_sink>> sinks;
+	// Matches sinks.
+	std::vector<voice_output> outputs;
+	speak_timings timings;
+
+	// Synthesized pcm, reused between calls.
+	std::vector<std::byte> pcm;
+	// Processed chunk, when pipelining or streaming.
+	std::vector<std::byte> chunk_pcm;
+	// Synthesized pcm on its way to the effects, when streaming.
+	std::unique_ptr<spsc_ring> ring;
+	// The last buffer handed to the outputs, reused once they let go of it.
+	std::shared_ptr<std::vector<std::byte>> shared;
+	fx_buffers fx_scratch;
+	// Long effect renders use up to this many threads.
+	size_t fx_threads = (std::numeric_limits<size_t>::max)();
+	// Abandons the utterance being spoken.
+	std::atomic<bool> cancelled = false;
+	// Times the stages of the next utterances.
+	bool collect_stats = false;
+	stage_times stages{};
+
+	// speak_async state, guarded by queue_mutex.
+	mutable std::mutex queue_mutex;
+	std::condition_variable queue_cv;
+	speech_queue queue;
+	// Priority of the utterance being spoken.
+	std::optional<speak_priority_e> current;
+	// The worker is calling an on_done.
+	bool notifying = false;
+	speak_timings last_timings;
+	speak_queue_stats stats;
+	// Thrown by the next call.
+	std::exception_ptr error;
+	bool quit = false;
+	// Speaks the queue, started by the first speak_async.
+	std::thread worker;
+
+	~async_token_imp();
 };
 
 struct engine_imp {
-	engine_imp()
-			: voice_tokens(make_voice_tokens())
-			, voice_names(make_names(voice_tokens))
-			, device_tokens(make_device_tokens())
-			, device_names(make_names(device_tokens)) {
-		assert(voice_tokens.size() == voice_names.size());
-		assert(device_tokens.size() == device_names.size());
+	std::unique_ptr<backend> platform;
+	render_cache cache;
+	object_pool pool;
+	stage_stats stats;
+};
+
+namespace {
+// Throws on options the backend can't speak. Parses the preset file once,
+// renders of vopts read it back from the preset cache.
+void check_voice(backend& platform, const voice& vopts) {
+	if (vopts.voice_idx >= platform.voices().size()) {
+		fea::maybe_throw<std::invalid_argument>(
+				__FUNCTION__, __LINE__, "Invalid voice index.");
+	}
+
+	for (const voice_output& vout : vopts.outputs()) {
+		if (vout.type == output_type_e::device
+				&& vout.device_idx >= platform.devices().size()) {
+			fea::maybe_throw<std::invalid_argument>(
+					__FUNCTION__, __LINE__, "Invalid device index.");
+		}
+
+		if (vout.type == output_type_e::file && vout.file_path.empty()) {
+			fea::maybe_throw<std::invalid_argument>(
+					__FUNCTION__, __LINE__, "Empty file path.");
+		}
 	}
 
-	const std::vector<CComPtr<ISpObjectToken>> voice_tokens;
-	const std::vector<std::wstring> voice_names;
+	// Report bad radio preset files now, rather than mid speech.
+	if (!vopts.radio_effect_file().empty()) {
+		cache_fx_preset(vopts.radio_effect_file());
+	}
+}
 
-	const std::vector<CComPtr<ISpObjectToken>> device_tokens;
-	const std::vector<std::wstring> device_names;
+// Replaces the token sinks with the vopts outputs. Either devices or output
+// files.
+template <class MakeSink>
+void make_sinks(backend& platform, async_token_imp& tok, MakeSink&& make_sink) {
+	tok.sinks.clear();
+	tok.outputs = tok.vopts.outputs();
 
-	std::vector<std::byte> scratch_buffer;
-	std::vector<float> scratch_samples;
-};
+	// Use the default device if we have no outputs.
+	if (tok.outputs.empty()) {
+		if (platform.devices().empty()) {
+			fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
+					"Trying to use default playback device, but no devices "
+					"exist. Aborting.");
+		}
+
+		voice_output vout;
+		vout.type = output_type_e::device;
+		vout.device_idx = platform.default_device_idx();
+		tok.outputs.push_back(vout);
+	}
+
+	for (const voice_output& vout : tok.outputs) {
+		tok.sinks.push_back(make_sink(vout));
+	}
+}
+
+// Seconds of audio in processed pcm.
+double audio_seconds(const voice& vopts, size_t bytes) {
+	const size_t sample_size = vopts.bit_depth() == bit_depth_e::_8 ? 1 : 2;
+	return double(bytes)
+			/ double(to_value(fx_output_rate(vopts)) * sample_size);
+}
+
+// Moves pcm to a buffer the outputs can share. pcm gets the last shared
+// buffer back if nothing holds it anymore, to reuse its memory.
+shared_pcm share(async_token_imp& tok, std::vector<std::byte>& pcm) {
+	if (!tok.shared || tok.shared.use_count() != 1) {
+		tok.shared = std::make_shared<std::vector<std::byte>>();
+	}
+	tok.shared->swap(pcm);
+	pcm.clear();
+	return tok.shared;
+}
+
+// Renders the text and plays it on the token outputs.
+void speak_text(
+		render_cache& cache, async_token_imp& tok, const std::wstring& text) {
+	const auto start = std::chrono::steady_clock::now();
+	tok.timings = {};
+	tok.stages = {};
+
+	// Adds the time func takes to its stage, when collecting stats.
+	auto timed = [&](speak_stage_e stage, auto&& func) {
+		if (!tok.collect_stats) {
+			func();
+			return;
+		}
+		const auto stage_start = std::chrono::steady_clock::now();
+		func();
+		tok.stages[size_t(stage)]
+				+= std::chrono::steady_clock::now() - stage_start;
+	};
+
+	// Adds speech xml to the text.
+	auto format = [&](const std::wstring& t) {
+		std::wstring ret;
+		timed(speak_stage_e::format,
+				[&]() { ret = tok.formatter.format_sentence(t); });
+		return ret;
+	};
+
+	// Replaces the pcm with the synthesized text. Stops early once
+	// cancelled.
+	auto synthesize = [&](const std::wstring& t) {
+		tok.pcm.clear();
+		const std::wstring formatted = format(t);
+		timed(speak_stage_e::synthesis, [&]() {
+			tok.tts->synthesize(formatted, [&](std::span<const std::byte> pcm) {
+				tok.pcm.insert(tok.pcm.end(), pcm.begin(), pcm.end());
+				return !tok.cancelled;
+			});
+		});
+	};
+
+	// Interrupts what the outputs are playing when purge is set, else queues
+	// after it. All outputs read the same buffer.
+	auto play = [&](const shared_pcm& pcm, bool purge) {
+		timed(speak_stage_e::output, [&]() {
+			for (std::unique_ptr<audio_sink>& sink : tok.sinks) {
+				sink->play(pcm, purge);
+			}
+		});
+		tok.timings.bytes += pcm->size();
+	};
+
+	// Repeated utterances go straight to the outputs.
+	if (shared_pcm pcm = cache.find(tok.vopts, text)) {
+		play(pcm, true);
+		tok.timings.time_to_first_audio
+				= std::chrono::steady_clock::now() - start;
+		tok.timings.chunks = 0;
+		tok.timings.cached = true;
+		return;
+	}
+	const size_t cache_budget = cache.budget();
+	bool use_cache = cache_budget != 0;
+
+	// Keeps the processed chunk for the cache. Renders too long for it
+	// aren't held in memory.
+	auto keep_chunk = [&](std::vector<std::byte>& rendered) {
+		if (!use_cache) {
+			return;
+		}
+		if (rendered.size() + tok.chunk_pcm.size() > cache_budget) {
+			use_cache = false;
+			rendered = {};
+			return;
+		}
+		rendered.insert(
+				rendered.end(), tok.chunk_pcm.begin(), tok.chunk_pcm.end());
+	};
+
+	// The synthesizer fills the ring from another thread, the effects and
+	// outputs drain it here as it fills.
+	if (tok.vopts.stream_synthesis
+			&& tok.vopts.compression() == compression_e::none) {
+		if (!tok.ring) {
+			tok.ring = std::make_unique<spsc_ring>(stream_ring_size);
+		}
+		spsc_ring& ring = *tok.ring;
+		ring.reset();
+
+		// Only the producer times synthesis.
+		std::exception_ptr synth_error;
+		std::thread producer{ [&]() {
+			try {
+				const std::wstring formatted = format(text);
+				timed(speak_stage_e::synthesis, [&]() {
+					tok.tts->synthesize(
+							formatted, [&](std::span<const std::byte> pcm) {
+								// Stops once the consumer or token cancels.
+								return ring.write(pcm) && !tok.cancelled;
+							});
+				});
+			} catch (...) {
+				synth_error = std::current_exception();
+			}
+			ring.close();
+		} };
+
+		// Failing outputs interrupt the synthesizer.
+		fea::on_exit join_producer = [&]() {
+			if (producer.joinable()) {
+				ring.cancel();
+				tok.tts->stop();
+				producer.join();
+			}
+		};
+
+		const size_t sample_size
+				= tok.vopts.bit_depth() == bit_depth_e::_8 ? 1 : 2;
+		const size_t block_size = to_value(tok.vopts.sampling_rate())
+				* stream_block_ms / 1000 * sample_size;
+		tok.pcm.resize(block_size);
+
+		fx_stream fx{ tok.vopts };
+		std::vector<std::byte> rendered;
+		bool first = true;
+		while (true) {
+			// Returns 0 once synthesis is done and the ring drained.
+			const size_t size = ring.read(tok.pcm, block_size);
+			const bool last = size == 0;
+
+			tok.chunk_pcm.clear();
+			timed(speak_stage_e::fx, [&]() {
+				fx.process(
+						std::span{ tok.pcm }.first(size), last, tok.chunk_pcm);
+			});
+
+			keep_chunk(rendered);
+
+			if (tok.cancelled) {
+				return;
+			}
 
+			// Empty text still interrupts playback.
+			if (!tok.chunk_pcm.empty() || (last && first)) {
+				play(share(tok, tok.chunk_pcm), first);
+				if (first) {
+					tok.timings.time_to_first_audio
+							= std::chrono::steady_clock::now() - start;
+					first = false;
+				}
+			}
+			if (last) {
+				break;
+			}
+		}
+
+		producer.join();
+		if (synth_error) {
+			std::rethrow_exception(synth_error);
+		}
+		tok.timings.chunks = 1;
+
+		if (use_cache) {
+			cache.insert(tok.vopts, text, std::move(rendered));
+		}
+		return;
+	}
+
+	if (tok.vopts.sentence_pipeline) {
+		std::vector<std::wstring_view> chunks = split_sentences(
+				text, tok.vopts.xml_parse, pipeline_min_chunk);
+		// Empty text still interrupts playback.
+		if (chunks.empty()) {
+			chunks.push_back({});
+		}
+
+		// The effects render all chunks as one.
+		fx_stream fx{ tok.vopts };
+		std::vector<std::byte> rendered;
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			if (tok.cancelled) {
+				return;
+			}
+			synthesize(std::wstring{ chunks[i] });
+			if (tok.cancelled) {
+				return;
+			}
+
+			// Outputs play the chunk while the tts renders the next one.
+			tok.chunk_pcm.clear();
+			timed(speak_stage_e::fx, [&]() {
+				fx.process(tok.pcm, i + 1 == chunks.size(), tok.chunk_pcm);
+			});
+			keep_chunk(rendered);
+
+			// The first chunk interrupts playback, the next ones queue.
+			play(share(tok, tok.chunk_pcm), i == 0);
+			if (i == 0) {
+				tok.timings.time_to_first_audio
+						= std::chrono::steady_clock::now() - start;
+			}
+		}
+		tok.timings.chunks = chunks.size();
+
+		if (use_cache) {
+			cache.insert(tok.vopts, text, std::move(rendered));
+		}
+		return;
+	}
+
+	synthesize(text);
+	if (tok.cancelled) {
+		return;
+	}
+	timed(speak_stage_e::fx, [&]() {
+		process_fx(tok.vopts, tok.pcm, tok.fx_scratch, tok.fx_threads,
+				&tok.cancelled);
+	});
+	if (tok.cancelled) {
+		return;
+	}
+
+	// Play the pcm on all outputs.
+	const shared_pcm pcm = share(tok, tok.pcm);
+	play(pcm, true);
+	tok.timings.time_to_first_audio = std::chrono::steady_clock::now() - start;
+	tok.timings.chunks = 1;
+
+	if (use_cache) {
+		// Shared with the outputs.
+		cache.insert(tok.vopts, text, pcm);
+	}
+}
+
+// Waits on the token outputs to finish playing.
+void drain(async_token_imp& tok) {
+	const auto start = std::chrono::steady_clock::now();
+	for (std::unique_ptr<audio_sink>& sink : tok.sinks) {
+		sink->wait();
+	}
+	if (tok.collect_stats) {
+		tok.stages[size_t(speak_stage_e::drain)]
+				+= std::chrono::steady_clock::now() - start;
+	}
+}
+
+// Adds the utterance the token spoke to the stats, if it was timed.
+// render is the speak_text duration.
+void record_stats(stage_stats& stats, const async_token_imp& tok,
+		std::chrono::steady_clock::duration render) {
+	if (tok.collect_stats) {
+		stats.record(tok.stages, render, tok.timings.bytes,
+				audio_seconds(tok.vopts, tok.timings.bytes));
+	}
+}
+
+// Abandons the utterance being spoken, if any. Must hold the queue mutex,
+// so the worker doesn't start the next one meanwhile.
+void cancel_current(async_token_imp& tok) {
+	if (!tok.current) {
+		return;
+	}
+	tok.cancelled = true;
+	tok.tts->stop();
+	for (std::unique_ptr<audio_sink>& sink : tok.sinks) {
+		sink->stop();
+	}
+}
+
+// Tells the callbacks of dropped utterances. Mustn't hold the queue mutex,
+// they may call the engine.
+void notify_dropped(std::vector<speech_queue::item>& items) {
+	for (speech_queue::item& item : items) {
+		if (item.on_done) {
+			item.on_done(speak_result{
+					.status = speak_status_e::dropped,
+					.timings = {},
+					.error = nullptr,
+			});
+		}
+	}
+	items.clear();
+}
+
+// Must hold the queue mutex.
+void rethrow_error(async_token_imp& tok) {
+	if (tok.error) {
+		std::exception_ptr e = std::exchange(tok.error, nullptr);
+		std::rethrow_exception(e);
+	}
+}
+
+// Speaks the token queue, one utterance after the other, until it quits.
+void speak_queue(
+		render_cache& cache, stage_stats& stats, async_token_imp& tok) {
+	std::unique_lock lock{ tok.queue_mutex };
+	while (true) {
+		tok.queue_cv.wait(
+				lock, [&]() { return tok.quit || !tok.queue.empty(); });
+		if (tok.quit) {
+			return;
+		}
+
+		speech_queue::item item = std::move(*tok.queue.pop());
+		tok.current = item.priority;
+		tok.cancelled = false;
+		// Under the lock, a stop of this utterance can't come before it.
+		for (std::unique_ptr<audio_sink>& sink : tok.sinks) {
+			sink->reset();
+		}
+		tok.collect_stats = stats.enabled();
+		lock.unlock();
+
+		const auto start = std::chrono::steady_clock::now();
+		speak_result result;
+		try {
+			speak_text(cache, tok, item.text);
+			const auto render = std::chrono::steady_clock::now() - start;
+			// Audio played while being cancelled.
+			if (tok.cancelled) {
+				for (std::unique_ptr<audio_sink>& sink : tok.sinks) {
+					sink->stop();
+				}
+			}
+
+			// The next utterance starts once this one is heard.
+			drain(tok);
+			if (!tok.cancelled) {
+				record_stats(stats, tok, render);
+			}
+		} catch (...) {
+			result.status = speak_status_e::failed;
+			result.error = std::current_exception();
+		}
+		if (result.status == speak_status_e::done && tok.cancelled) {
+			result.status = speak_status_e::interrupted;
+		}
+		result.timings = tok.timings;
+
+		lock.lock();
+		tok.current.reset();
+		tok.last_timings = tok.timings;
+		if (result.error && !item.on_done) {
+			tok.error = result.error;
+		} else if (!result.error && tok.timings.bytes != 0) {
+			const std::chrono::steady_clock::duration latency
+					= start - item.enqueued + tok.timings.time_to_first_audio;
+			speak_latency& l = tok.stats.first_audio[size_t(item.priority)];
+			++l.count;
+			l.total += latency;
+			l.max = (std::max)(l.max, latency);
+		}
+
+		if (item.on_done) {
+			tok.notifying = true;
+			lock.unlock();
+			try {
+				item.on_done(result);
+			} catch (...) {
+				// Mustn't throw, reported by the next call.
+				lock.lock();
+				tok.error = std::current_exception();
+				lock.unlock();
+			}
+			lock.lock();
+			tok.notifying = false;
+		}
+		tok.queue_cv.notify_all();
+	}
+}
+} // namespace
+
+async_token_imp::~async_token_imp() {
+	if (!worker.joinable()) {
+		return;
+	}
+
+	std::vector<speech_queue::item> dropped;
+	{
+		std::unique_lock lock{ queue_mutex };
+		quit = true;
+		queue.clear(dropped);
+		// Destructors can't throw, the worker stops anyway.
+		try {
+			cancel_current(*this);
+		} catch (...) {
+		}
+	}
+	queue_cv.notify_all();
+	worker.join();
+
+	try {
+		notify_dropped(dropped);
+	} catch (...) {
+	}
+}
+
+
+speak_awaitable::speak_awaitable(engine& e, async_token& t,
+		const std::wstring& sentence, speak_priority_e priority,
+		speak_policy_e policy)
+		: _engine(&e)
+		, _token(&t)
+		, _sentence(sentence)
+		, _priority(priority)
+		, _policy(policy) {
+}
+
+bool speak_awaitable::await_suspend(std::coroutine_handle<> handle) {
+	// The coroutine may resume on the token thread before this returns,
+	// members aren't touched once queued.
+	const bool queued = _engine->speak_async(_sentence, *_token, _priority,
+			_policy, [this, handle](const speak_result& result) {
+				_result = result;
+				handle.resume();
+			});
+
+	if (!queued) {
+		_result.status = speak_status_e::dropped;
+	}
+	return queued;
+}
 
 async_token::async_token() = default;
 async_token::async_token(async_token&&) = default;
 async_token::~async_token() = default;
 async_token& async_token::operator=(async_token&&) = default;
 
-engine::engine() = default;
+speak_timings async_token::timings() const {
+	std::unique_lock lock{ _impl->queue_mutex };
+	return _impl->last_timings;
+}
+
+speak_queue_stats async_token::queue_stats() const {
+	std::unique_lock lock{ _impl->queue_mutex };
+	speak_queue_stats ret = _impl->stats;
+	ret.dropped = _impl->queue.dropped();
+	return ret;
+}
+
+engine::engine() {
+#if defined(_WIN32)
+	imp().platform = make_sapi_backend();
+#else
+	imp().platform = make_headless_backend(headless_options{});
+#endif
+}
+engine::engine(const headless_options& opts) {
+	imp().platform = make_headless_backend(opts);
+}
 engine::~engine() = default;
 // engine& engine::operator=(engine&&) = default;
 // engine& engine::operator=(const engine&) = default;
@@ -53,170 +623,282 @@ engine::~engine() = default;
 // engine::engine(const engine&) = default;
 
 
+void engine::enumeration_snapshot(const std::filesystem::path& path) {
+	imp().platform->snapshot_path(path);
+}
+
 const std::vector<std::wstring>& engine::voices() const {
-	return imp().voice_names;
+	return imp().platform->voices();
 }
 
 const std::vector<std::wstring>& engine::devices() const {
-	return imp().device_names;
+	return imp().platform->devices();
 }
 
 // https://learn.microsoft.com/en-us/previous-versions/windows/desktop/ee431811(v=vs.85)
-void engine::speak(const voice& vopts, const std::wstring& sentence) {
-	async_token tok = make_async_token(vopts);
-	speak_async(sentence, tok);
-
-	for (device_output& outv : tok._impl->device_outputs) {
-		if (!SUCCEEDED(outv->WaitUntilDone(INFINITE))) {
-			fea::maybe_throw(
-					__FUNCTION__, __LINE__, "Couldn't wait on output speak.");
-		}
+speak_timings engine::speak(const voice& vopts, const std::wstring& sentence) {
+	backend& platform = *imp().platform;
+	object_pool& pool = imp().pool;
+	check_voice(platform, vopts);
+
+	// Reuses the synthesizer and devices of previous calls.
+	async_token_imp tok;
+	tok.vopts = vopts;
+	tok.formatter = text_formatter{ tok.vopts };
+	tok.tts = pool.acquire_synthesizer(platform, tok.vopts);
+	make_sinks(platform, tok, [&](const voice_output& vout) {
+		return pool.acquire_sink(platform, tok.vopts, vout);
+	});
+	tok.collect_stats = imp().stats.enabled();
+
+	const auto start = std::chrono::steady_clock::now();
+	speak_text(imp().cache, tok, sentence);
+	const auto render = std::chrono::steady_clock::now() - start;
+	drain(tok);
+	record_stats(imp().stats, tok, render);
+
+	// Only successful calls get here, failed ones drop objects that may be in
+	// a bad state.
+	pool.release(tok.vopts, std::move(tok.tts));
+	for (size_t i = 0; i < tok.sinks.size(); ++i) {
+		pool.release(tok.vopts, tok.outputs[i], std::move(tok.sinks[i]));
 	}
+	return tok.timings;
 }
 
-async_token engine::make_async_token(const voice& in_vopts) const {
+async_token engine::make_async_token(
+		const voice& in_vopts, size_t max_pending) const {
+	backend& platform = *imp().platform;
+	check_voice(platform, in_vopts);
+
 	async_token ret;
 	ret._impl->vopts = in_vopts;
+	ret._impl->queue = speech_queue{ max_pending };
 
-	// Error checking.
-	if (ret._impl->vopts.voice_idx >= imp().voice_tokens.size()) {
-		fea::maybe_throw<std::invalid_argument>(
-				__FUNCTION__, __LINE__, "Invalid voice index.");
-	}
-
-	for (const voice_output& vout : ret._impl->vopts.outputs()) {
-		if (vout.type == output_type_e::device
-				&& vout.device_idx >= imp().device_tokens.size()) {
-			fea::maybe_throw<std::invalid_argument>(
-					__FUNCTION__, __LINE__, "Invalid device index.");
-		}
+	// Adds SAPI xml options to sentences, if required.
+	ret._impl->formatter = text_formatter{ ret._impl->vopts };
 
-		if (vout.type == output_type_e::file && vout.file_path.empty()) {
-			fea::maybe_throw<std::invalid_argument>(
-					__FUNCTION__, __LINE__, "Empty file path.");
-		}
-	}
+	// The synthesizer renders to memory, sinks play the processed audio to
+	// various outputs.
+	ret._impl->tts = platform.make_synthesizer(ret._impl->vopts);
+	make_sinks(platform, *ret._impl, [&](const voice_output& vout) {
+		return platform.make_sink(ret._impl->vopts, vout);
+	});
+	return ret;
+}
 
-	// The voice that will do the tts, outputs to ispstream.
-	// Other voices will play stream to various outputs.
-	ret._impl->tts = make_tts_voice(ret._impl->vopts, imp().voice_tokens);
+bool engine::speak_async(const std::wstring& in_sentence, async_token& t,
+		speak_priority_e priority, speak_policy_e policy,
+		speak_callback_t on_done) {
+	assert(priority < speak_priority_e::count);
+	assert(policy < speak_policy_e::count);
+	async_token_imp& tok = *t._impl;
 
-	// Create output voices. Either devices or output files.
-	for (const voice_output& vout : ret._impl->vopts.outputs()) {
-		ret._impl->device_outputs.push_back(
-				make_device_output(vout, imp().device_tokens));
+	std::vector<speech_queue::item> dropped;
+	std::unique_lock lock{ tok.queue_mutex };
+	rethrow_error(tok);
+
+	const bool queued = tok.queue.push(
+			speech_queue::item{
+					.text = in_sentence,
+					.priority = priority,
+					.enqueued = std::chrono::steady_clock::now(),
+					.on_done = std::move(on_done),
+			},
+			policy, dropped);
+
+	// Higher priority utterances aren't interrupted.
+	if (queued && policy == speak_policy_e::interrupt && tok.current
+			&& *tok.current <= priority) {
+		++tok.stats.interrupted;
+		cancel_current(tok);
 	}
 
-	// Make a default voice if we have no outputs.
-	if (ret._impl->device_outputs.empty()) {
-		if (imp().device_tokens.empty()) {
-			assert(imp().device_names.empty());
-			fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
-					"Trying to use default playback device, but no devices "
-					"exist. Aborting.");
-		}
+	if (!tok.worker.joinable()) {
+		render_cache& cache = imp().cache;
+		stage_stats& stats = imp().stats;
+		tok.worker = std::thread{ [&cache, &stats, &tok]() {
+			speak_queue(cache, stats, tok);
+		} };
+	}
+	tok.queue_cv.notify_all();
+	lock.unlock();
 
-		voice_output vout;
-		vout.type = output_type_e::device;
-		vout.device_idx = default_output_device_idx(imp().device_names);
+	notify_dropped(dropped);
+	return queued;
+}
 
-		ret._impl->device_outputs.push_back(
-				make_device_output(vout, imp().device_tokens));
+std::future<speak_result> engine::speak_future(const std::wstring& sentence,
+		async_token& t, speak_priority_e priority, speak_policy_e policy) {
+	// Callbacks are copyable, the promise isn't.
+	auto promise = std::make_shared<std::promise<speak_result>>();
+	std::future<speak_result> ret = promise->get_future();
+	const bool queued = speak_async(sentence, t, priority, policy,
+			[promise](const speak_result& result) {
+				promise->set_value(result);
+			});
+
+	if (!queued) {
+		promise->set_value(speak_result{
+				.status = speak_status_e::dropped,
+				.timings = {},
+				.error = nullptr,
+		});
 	}
-
 	return ret;
 }
 
-void engine::speak_async(const std::wstring& in_sentence, async_token& t) {
-	async_token_imp& tok = *t._impl;
+speak_awaitable engine::speak_co(const std::wstring& sentence, async_token& t,
+		speak_priority_e priority, speak_policy_e policy) {
+	return speak_awaitable{ *this, t, sentence, priority, policy };
+}
 
-	// Adds SAPI xml options to the sentence, if required.
-	std::wstring sentence = tok.tts.format_sentence(in_sentence);
+void engine::wait(async_token& t) {
+	async_token_imp& tok = *t._impl;
+	std::unique_lock lock{ tok.queue_mutex };
+	// The worker would wait on itself.
+	if (tok.worker.get_id() == std::this_thread::get_id()) {
+		fea::maybe_throw<std::logic_error>(__FUNCTION__, __LINE__,
+				"Can't wait on a token from its own thread.");
+	}
+	tok.queue_cv.wait(lock, [&]() {
+		return tok.queue.empty() && !tok.current && !tok.notifying;
+	});
+	rethrow_error(tok);
+}
 
-	// Clear the currently playing stream.
+void engine::stop(async_token& t) {
+	async_token_imp& tok = *t._impl;
+	std::vector<speech_queue::item> dropped;
 	{
-		// Seek beginning.
-		if (!SUCCEEDED(IStream_Reset(tok.tts.data_stream))) {
-			fea::maybe_throw(__FUNCTION__, __LINE__,
-					"Couldn't reset tts stream playhead.");
-		}
+		std::unique_lock lock{ tok.queue_mutex };
+		tok.queue.clear(dropped);
 
-		// Clear.
-		if (!SUCCEEDED(tok.tts.data_stream->SetSize({ 0 }))) {
-			fea::maybe_throw(__FUNCTION__, __LINE__,
-					"Couldn't set tts data stream size to 0.");
-		}
+		// Stops input voice and outputs, waits on purge.
+		cancel_current(tok);
+		tok.queue_cv.wait(lock, [&]() { return !tok.current; });
 	}
+	notify_dropped(dropped);
 
-	// Fill the stream with tts.
-	unsigned long flags
-			= SPF_DEFAULT | SPF_ASYNC | SPF_PURGEBEFORESPEAK | tok.tts.flags;
-	if (!SUCCEEDED(tok.tts->Speak(sentence.c_str(), flags, nullptr))) {
-		fea::maybe_throw<std::invalid_argument>(
-				__FUNCTION__, __LINE__, "Tts voice couldn't speak.");
-	}
-	if (!SUCCEEDED(tok.tts->WaitUntilDone(INFINITE))) {
-		fea::maybe_throw(
-				__FUNCTION__, __LINE__, "Couldn't wait on input speak.");
-	}
-
-	process_fx(tok.vopts, tok.tts.data_stream, imp().scratch_buffer,
-			imp().scratch_samples);
-
-	// Clone the input stream to output streams. They have an independent
-	// playhead but same data.
-	for (device_output& outv : tok.device_outputs) {
-		if (outv.data_stream_clone == nullptr) {
-			clone_input_stream(tok.tts, tok.device_outputs);
-		} else {
-			// Already cloned, reset output stream to beginning.
-			if (!SUCCEEDED(IStream_Reset(outv.data_stream_clone))) {
-				fea::maybe_throw(__FUNCTION__, __LINE__,
-						"Couldn't reset output stream playhead.");
+	std::unique_lock lock{ tok.queue_mutex };
+	rethrow_error(tok);
+}
+
+speak_batch_result engine::speak_batch(
+		const std::vector<speak_job>& jobs, size_t num_workers) {
+	const size_t num_cores = (std::max)(
+			size_t(std::thread::hardware_concurrency()), size_t(1));
+	if (num_workers == 0) {
+		num_workers = num_cores;
+	}
+	num_workers = std::clamp(
+			num_workers, size_t(1), (std::max)(jobs.size(), size_t(1)));
+
+	speak_batch_result ret;
+	ret.jobs.resize(jobs.size());
+	ret.num_workers = num_workers;
+
+	const auto start = std::chrono::steady_clock::now();
+	std::atomic<size_t> next_job = 0;
+	auto work = [&]() {
+		// Reused from one job to the next.
+		async_token_imp tok;
+		// Split long effect renders over the cores left.
+		tok.fx_threads = (std::max)(num_cores / num_workers, size_t(1));
+		tok.collect_stats = imp().stats.enabled();
+
+		backend& platform = *imp().platform;
+		for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+			const speak_job& job = jobs[i];
+			speak_job_result& result = ret.jobs[i];
+			const auto job_start = std::chrono::steady_clock::now();
+			try {
+				check_voice(platform, job.vopts);
+				if (tok.tts != nullptr
+						&& synthesizer_key(tok.vopts)
+								   == synthesizer_key(job.vopts)) {
+					tok.tts->configure(job.vopts);
+				} else {
+					tok.tts = platform.make_synthesizer(job.vopts);
+				}
+				tok.vopts = job.vopts;
+				tok.formatter = text_formatter{ tok.vopts };
+				make_sinks(platform, tok, [&](const voice_output& vout) {
+					return platform.make_sink(tok.vopts, vout);
+				});
+
+				const auto render_start = std::chrono::steady_clock::now();
+				speak_text(imp().cache, tok, job.text);
+				const auto render
+						= std::chrono::steady_clock::now() - render_start;
+				drain(tok);
+				// Closes files.
+				tok.sinks.clear();
+				record_stats(imp().stats, tok, render);
+
+				result.ok = true;
+				result.timings = tok.timings;
+				result.audio_seconds
+						= audio_seconds(tok.vopts, tok.timings.bytes);
+			} catch (const std::exception& e) {
+				result.error = e.what();
+				// Start the next job from scratch.
+				tok.sinks.clear();
+				tok.tts.reset();
+			} catch (...) {
+				result.error = "Unknown error.";
+				tok.sinks.clear();
+				tok.tts.reset();
 			}
+			result.duration = std::chrono::steady_clock::now() - job_start;
+		}
+	};
+
+	if (num_workers == 1) {
+		work();
+	} else {
+		std::vector<std::thread> workers;
+		workers.reserve(num_workers);
+		for (size_t i = 0; i < num_workers; ++i) {
+			workers.emplace_back(work);
+		}
+		for (std::thread& t : workers) {
+			t.join();
 		}
 	}
 
-	// Play the stream on all output devices.
-	for (device_output& outv : tok.device_outputs) {
-		if (!SUCCEEDED(outv->SpeakStream(outv.sp_stream_clone,
-					SPF_DEFAULT | SPF_ASYNC | SPF_PURGEBEFORESPEAK, nullptr))) {
-			fea::maybe_throw<std::runtime_error>(
-					__FUNCTION__, __LINE__, "Couldn't speak output stream.");
+	ret.wall_time = std::chrono::steady_clock::now() - start;
+	for (const speak_job_result& result : ret.jobs) {
+		if (result.ok) {
+			ret.audio_seconds += result.audio_seconds;
+			ret.bytes += result.timings.bytes;
 		}
 	}
+	return ret;
 }
 
-void engine::stop(async_token& t) {
-	async_token_imp& tok = *t._impl;
+void engine::cache_budget(size_t bytes) {
+	imp().cache.budget(bytes);
+}
 
-	// Stop input voice.
-	if (!SUCCEEDED(tok.tts->Speak(L"",
-				SPF_DEFAULT | SPF_ASYNC | SPF_PURGEBEFORESPEAK, nullptr))) {
-		fea::maybe_throw<std::invalid_argument>(
-				__FUNCTION__, __LINE__, "Input couldn't stop.");
-	}
-	if (!SUCCEEDED(tok.tts->WaitUntilDone(INFINITE))) {
-		fea::maybe_throw(
-				__FUNCTION__, __LINE__, "Couldn't wait on input speak.");
-	}
+void engine::invalidate_cache() {
+	imp().cache.clear();
+}
 
-	// Stop outputs.
-	for (device_output& outv : tok.device_outputs) {
-		if (!SUCCEEDED(outv->Speak(L"",
-					SPF_DEFAULT | SPF_ASYNC | SPF_PURGEBEFORESPEAK, nullptr))) {
-			fea::maybe_throw<std::runtime_error>(
-					__FUNCTION__, __LINE__, "Output couldn't stop.");
-		}
-	}
+render_cache_stats engine::cache_stats() const {
+	return imp().cache.stats();
+}
 
-	// Wait on purge.
-	for (device_output& outv : tok.device_outputs) {
-		if (!SUCCEEDED(outv->WaitUntilDone(INFINITE))) {
-			fea::maybe_throw(
-					__FUNCTION__, __LINE__, "Couldn't wait on output speak.");
-		}
-	}
+void engine::collect_stats(bool enable) {
+	imp().stats.enabled(enable);
+}
+
+engine_stats engine::stats() const {
+	return imp().stats.stats();
+}
+
+void engine::reset_stats() {
+	imp().stats.reset();
 }
 
 const engine_imp& engine::imp() const {
@@ -0,0 +1,167 @@
+#include "private_include/enum_snapshot.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <system_error>
+#include <thread>
+
+namespace wsay {
+namespace {
+constexpr char magic[8] = { 'w', 's', 'a', 'y', 'e', 'n', 'u', 'm' };
+// Bump when the layout changes.
+constexpr uint32_t version = 1;
+
+void write_u64(std::ofstream& ofs, uint64_t v) {
+	ofs.write(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void write_str(std::ofstream& ofs, std::wstring_view str) {
+	write_u64(ofs, str.size());
+	ofs.write(reinterpret_cast<const char*>(str.data()),
+			std::streamsize(str.size() * sizeof(wchar_t)));
+}
+
+void write_strs(std::ofstream& ofs, const std::vector<std::wstring>& strs) {
+	write_u64(ofs, strs.size());
+	for (const std::wstring& str : strs) {
+		write_str(ofs, str);
+	}
+}
+
+// Reads from the file contents, fails rather than overrun them.
+struct reader {
+	bool read_u64(uint64_t& v) {
+		if (data.size() - pos < sizeof(v)) {
+			return false;
+		}
+		std::memcpy(&v, data.data() + pos, sizeof(v));
+		pos += sizeof(v);
+		return true;
+	}
+
+	bool read_str(std::wstring& str) {
+		uint64_t size = 0;
+		if (!read_u64(size) || (data.size() - pos) / sizeof(wchar_t) < size) {
+			return false;
+		}
+		str.resize(size_t(size));
+		const size_t bytes = str.size() * sizeof(wchar_t);
+		std::memcpy(str.data(), data.data() + pos, bytes);
+		pos += bytes;
+		return true;
+	}
+
+	bool read_strs(std::vector<std::wstring>& strs) {
+		uint64_t count = 0;
+		// Each string takes at least its size.
+		if (!read_u64(count)
+				|| (data.size() - pos) / sizeof(uint64_t) < count) {
+			return false;
+		}
+		strs.resize(size_t(count));
+		for (std::wstring& str : strs) {
+			if (!read_str(str)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const std::vector<char>& data;
+	size_t pos = 0;
+};
+} // namespace
+
+std::optional<enum_snapshot> load_enum_snapshot(
+		const std::filesystem::path& path, std::wstring_view signature) {
+	std::vector<char> data;
+	{
+		std::ifstream ifs{ path, std::ios::binary };
+		if (!ifs.is_open()) {
+			return std::nullopt;
+		}
+		data.assign(std::istreambuf_iterator<char>{ ifs },
+				std::istreambuf_iterator<char>{});
+	}
+
+	constexpr size_t header_size = sizeof(magic) + 2 * sizeof(uint32_t);
+	if (data.size() < header_size
+			|| std::memcmp(data.data(), magic, sizeof(magic)) != 0) {
+		return std::nullopt;
+	}
+
+	// Written by another build, or on another platform.
+	uint32_t header[2] = {};
+	std::memcpy(header, data.data() + sizeof(magic), sizeof(header));
+	if (header[0] != version || header[1] != sizeof(wchar_t)) {
+		return std::nullopt;
+	}
+
+	reader r{ .data = data, .pos = header_size };
+	enum_snapshot ret;
+	uint64_t default_idx = 0;
+	if (!r.read_str(ret.signature) || ret.signature != signature
+			|| !r.read_strs(ret.voice_ids) || !r.read_strs(ret.voice_names)
+			|| !r.read_strs(ret.device_ids) || !r.read_strs(ret.device_names)
+			|| !r.read_str(ret.default_device_id) || !r.read_u64(default_idx)) {
+		return std::nullopt;
+	}
+	ret.default_device_idx = size_t(default_idx);
+
+	if (ret.voice_ids.size() != ret.voice_names.size()
+			|| ret.device_ids.size() != ret.device_names.size()) {
+		return std::nullopt;
+	}
+	return ret;
+}
+
+bool save_enum_snapshot(
+		const std::filesystem::path& path, const enum_snapshot& snap) {
+	// Written aside, then swapped in.
+	std::filesystem::path tmp_path = path;
+	tmp_path += std::format(".{}.tmp",
+			std::hash<std::thread::id>{}(std::this_thread::get_id())
+					^ size_t(std::chrono::steady_clock::now()
+									 .time_since_epoch()
+									 .count()));
+
+	{
+		std::ofstream ofs{ tmp_path, std::ios::binary | std::ios::trunc };
+		if (!ofs.is_open()) {
+			return false;
+		}
+
+		const uint32_t header[2] = { version, uint32_t(sizeof(wchar_t)) };
+		ofs.write(magic, sizeof(magic));
+		ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+		write_str(ofs, snap.signature);
+		write_strs(ofs, snap.voice_ids);
+		write_strs(ofs, snap.voice_names);
+		write_strs(ofs, snap.device_ids);
+		write_strs(ofs, snap.device_names);
+		write_str(ofs, snap.default_device_id);
+		write_u64(ofs, snap.default_device_idx);
+
+		ofs.flush();
+		if (!ofs.good()) {
+			ofs.close();
+			std::error_code ec;
+			std::filesystem::remove(tmp_path, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmp_path, path, ec);
+	if (ec) {
+		std::filesystem::remove(tmp_path, ec);
+		return false;
+	}
+	return true;
+}
+} // namespace wsay
@@ -0,0 +1,918 @@
+#include "private_include/fx_chain.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <fea/meta/static_for.hpp>
+#include <fea/performance/intrinsics.hpp>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace wsay {
+namespace {
+// Stages run over this many kept samples at a time.
+constexpr size_t fx_block_size = 256;
+
+// fx_parallel segment length, in seconds of input.
+constexpr size_t fx_segment_seconds = 10;
+
+// Renders shorter than this many seconds aren't split.
+constexpr size_t fx_parallel_min_seconds = 60;
+
+constexpr size_t round_up(size_t v, size_t multiple) {
+	return (v + multiple - 1) / multiple * multiple;
+}
+
+noise_gen make_noise_gen(const voice& vopts) {
+	if (vopts.radio_effect_seed == (std::numeric_limits<uint64_t>::max)()) {
+		return noise_gen{};
+	}
+	return noise_gen{ vopts.radio_effect_seed };
+}
+
+// Block kernels, shared by the builtin and runtime chains.
+void bit_crush(float bit_mul, float bit_div, std::span<float> block) {
+	for (float& s : block) {
+		s = std::floor(s * bit_mul) * bit_div;
+	}
+}
+
+void white_noise(noise_gen& gen, float global_vol, float vol,
+		std::span<float> block) {
+	std::array<float, fx_block_size> noise;
+	assert(block.size() <= noise.size());
+	gen.fill({ noise.data(), block.size() }, global_vol);
+
+	const float dry = 1.f - vol;
+	for (size_t i = 0; i < block.size(); ++i) {
+		block[i] = (block[i] * dry) + (noise[i] * vol);
+	}
+}
+
+void gain(float g, std::span<float> block) {
+	for (float& s : block) {
+		s *= g;
+	}
+}
+
+// Compile-time specialized stages, for the builtin presets.
+template <size_t BitDepth>
+void bit_crush(std::span<float> block) {
+	constexpr float bit_mul
+			= float(fea::make_bitmask<uint32_t, (BitDepth - 1)>());
+	constexpr float bit_div = 1.f / bit_mul;
+	bit_crush(bit_mul, bit_div, block);
+}
+
+float distortion_norm(float drive) {
+	return 1.f / (std::atan(drive * 100.f));
+}
+
+template <float Drive>
+void distort(atan_e path, float norm, std::span<float> block) {
+	static_assert(Drive >= 0.f && Drive <= 1.f, "Invalid drive.");
+	constexpr float d = Drive * 100.f;
+	constexpr float atten = (1.f - (Drive * Drive + (0.9f - Drive)));
+	if constexpr (Drive != 0.f) {
+		distort(path, d, norm, atten, block);
+	}
+}
+
+template <float Vol>
+void white_noise(noise_gen& gen, float global_vol, std::span<float> block) {
+	static_assert(Vol >= 0.f && Vol <= 1.f, "Invalid volume.");
+	if constexpr (Vol != 0.f) {
+		white_noise(gen, global_vol, Vol, block);
+	}
+}
+
+template <float Gain>
+void gain(std::span<float> block) {
+	if constexpr (Gain != 1.f) {
+		gain(Gain, block);
+	}
+}
+
+// Runtime stages, one pre-instantiated kernel per stage type.
+void stage_bit_crush(const fx_stage& st, fx_state&, std::span<float> block) {
+	bit_crush(st.params[0], st.params[1], block);
+}
+
+void stage_noise(const fx_stage& st, fx_state& state, std::span<float> block) {
+	white_noise(state.noise, state.global_vol, st.params[0], block);
+}
+
+void stage_distort(
+		const fx_stage& st, fx_state& state, std::span<float> block) {
+	distort(state.atan, st.params[0], st.params[1], st.params[2], block);
+}
+
+void stage_eq(const fx_stage&, fx_state& state, std::span<float> block) {
+	state.eq.process(block);
+}
+
+void stage_gain(const fx_stage& st, fx_state&, std::span<float> block) {
+	gain(st.params[0], block);
+}
+
+// Builds the runtime chain, in the same order as the builtin one.
+// Stages that wouldn't change the signal are skipped.
+std::vector<fx_stage> make_fx_stages(const fx_args& args) {
+	std::vector<fx_stage> ret;
+
+	fx_stage noise{ .process = &stage_noise };
+	noise.params[0] = args.noise_vol;
+	if (args.noise_vol != 0.f && !args.noise_after_bitcrush) {
+		ret.push_back(noise);
+	}
+
+	float bit_mul = float((uint32_t(1) << (args.bit_depth - 1)) - 1u);
+	fx_stage crush{ .process = &stage_bit_crush };
+	crush.params[0] = bit_mul;
+	crush.params[1] = 1.f / bit_mul;
+	ret.push_back(crush);
+
+	if (args.noise_vol != 0.f && args.noise_after_bitcrush) {
+		ret.push_back(noise);
+	}
+
+	if (args.dist_drive != 0.f) {
+		fx_stage dist{ .process = &stage_distort };
+		dist.params[0] = args.dist_drive * 100.f;
+		dist.params[1] = distortion_norm(args.dist_drive);
+		dist.params[2] = (1.f
+				- (args.dist_drive * args.dist_drive
+						+ (0.9f - args.dist_drive)));
+		ret.push_back(dist);
+	}
+
+	bool has_eq = std::any_of(
+			args.biquads.begin(), args.biquads.end(), [](const biquad_args& b) {
+				return b.type != biquad_type_e::count;
+			});
+	if (has_eq) {
+		ret.push_back(fx_stage{ .process = &stage_eq });
+	}
+
+	if (args.gain != 1.f) {
+		fx_stage g{ .process = &stage_gain };
+		g.params[0] = args.gain;
+		ret.push_back(g);
+	}
+	return ret;
+}
+
+template <radio_preset_e EffectE, bool DisableWhitenoise>
+constexpr fx_args get_fx_args() {
+	if constexpr (DisableWhitenoise) {
+		fx_args ret = radio_presets[EffectE];
+		ret.noise_vol = 0.f;
+		return ret;
+	} else {
+		return radio_presets[EffectE];
+	}
+}
+
+template <radio_preset_e EffectE, bool DisableWhitenoise>
+void fx(fx_state& state, std::span<float> samples) {
+	constexpr fx_args args = get_fx_args<EffectE, DisableWhitenoise>();
+
+	// std::atan not constexpr.
+	const float dist_norm = distortion_norm(args.dist_drive);
+
+	// Each stage is a separate pass over the block, so the stateless ones
+	// vectorize.
+	for (size_t i = 0; i < samples.size(); i += fx_block_size) {
+		std::span<float> block = samples.subspan(
+				i, (std::min)(fx_block_size, samples.size() - i));
+
+		if constexpr (!args.noise_after_bitcrush) {
+			white_noise<args.noise_vol>(state.noise, state.global_vol, block);
+		}
+		bit_crush<args.bit_depth>(block);
+		if constexpr (args.noise_after_bitcrush) {
+			white_noise<args.noise_vol>(state.noise, state.global_vol, block);
+		}
+		distort<args.dist_drive>(state.atan, dist_norm, block);
+		state.eq.process(block);
+		gain<args.gain>(block);
+	}
+}
+
+// Runs the preset chain on samples at the preset rate.
+void process_chain(fx_state& state, std::span<float> samples) {
+	if (!state.stages.empty()) {
+		for (size_t i = 0; i < samples.size(); i += fx_block_size) {
+			std::span<float> block = samples.subspan(
+					i, (std::min)(fx_block_size, samples.size() - i));
+			for (const fx_stage& st : state.stages) {
+				st.process(st, state, block);
+			}
+		}
+		return;
+	}
+
+	fea::static_for<size_t(radio_preset_e::count)>([&](auto const_i) {
+		constexpr radio_preset_e fx_e = radio_preset_e(size_t(const_i));
+		if (fx_e == state.preset) {
+			if (state.disable_whitenoise) {
+				fx<fx_e, true>(state, samples);
+			} else {
+				fx<fx_e, false>(state, samples);
+			}
+		}
+	});
+}
+
+// The vopts preset as runtime arguments.
+fx_args to_fx_args(const voice& vopts) {
+	assert(vopts.has_radio_effect());
+	fx_args ret = vopts.radio_effect_file().empty()
+			? radio_presets[vopts.radio_effect()]
+			: load_fx_preset(vopts);
+	if (vopts.radio_effect_disable_whitenoise) {
+		ret.noise_vol = 0.f;
+	}
+	return ret;
+}
+
+// Fixed-point kernels.
+// Samples are Q15 at the int16 scale, int max is 1.f like the float path.
+// Blocks are int32 for headroom between stages.
+constexpr int32_t q15_max = (std::numeric_limits<int16_t>::max)();
+
+int16_t saturate_q15(int64_t v) {
+	return int16_t((std::min)((std::max)(v, int64_t(-q15_max - 1)),
+			int64_t(q15_max)));
+}
+
+// int8 pcm to Q15 and back, truncating like pcm_to_float and float_to_pcm.
+int32_t to_q15(int8_t v) {
+	return int32_t(v) * q15_max / 127;
+}
+int32_t to_q15(int16_t v) {
+	return v;
+}
+
+template <class IntT>
+IntT from_q15(int16_t v) {
+	if constexpr (std::is_same_v<IntT, int8_t>) {
+		return int8_t(int32_t(v) * 127 / q15_max);
+	} else {
+		return v;
+	}
+}
+
+// s = s * dry + noise * amplitude
+// Both gains are Q47, the noise is full int32 range.
+void white_noise_q15(noise_gen& gen, int64_t dry, int64_t amplitude,
+		std::span<int32_t> block) {
+	std::array<int32_t, fx_block_size> noise;
+	assert(block.size() <= noise.size());
+	gen.fill(std::span<int32_t>{ noise.data(), block.size() });
+
+	for (size_t i = 0; i < block.size(); ++i) {
+		int64_t acc = int64_t(block[i]) * dry + int64_t(noise[i]) * amplitude;
+		block[i] = int32_t((acc + (int64_t(1) << 46)) >> 47);
+	}
+}
+
+// s = floor(s * bit_mul) / bit_mul, bit_mul under q15_max.
+// step is q15_max / bit_mul in Q16.
+void bit_crush_q15(int64_t bit_mul, int64_t step, std::span<int32_t> block) {
+	// ceil(2^47 / q15_max), the floored division by q15_max is exact for
+	// |s * bit_mul| < 2^29.
+	constexpr int64_t recip
+			= ((int64_t(1) << 47) + q15_max - 1) / int64_t(q15_max);
+	for (int32_t& s : block) {
+		int64_t n = int64_t(s) * bit_mul;
+		// floor(n / d) = ~floor(~n / d) for negative n.
+		int64_t sign = n >> 63;
+		int64_t q = sign ^ (((n ^ sign) * recip) >> 47);
+		s = int32_t((q * step + (int64_t(1) << 15)) >> 16);
+	}
+}
+
+// Looks up the precomputed waveshaper, inputs are within int16.
+void distort_q15(const std::vector<int16_t>& shaper, std::span<int32_t> block) {
+	for (int32_t& s : block) {
+		s = shaper[size_t(saturate_q15(s) + q15_max + 1)];
+	}
+}
+
+// Sum of the absolute impulse response, the output bound for inputs within
+// [-1, 1]. Infinite if it doesn't decay.
+double impulse_l1(const biquad_coefs& c) {
+	double z1 = 0.0;
+	double z2 = 0.0;
+	double ret = 0.0;
+	for (size_t i = 0; i < (size_t(1) << 16); ++i) {
+		const double x = i == 0 ? 1.0 : 0.0;
+		const double y = x * c.a0 + z1;
+		z1 = x * c.a1 + z2 - c.b1 * y;
+		z2 = x * c.a2 - c.b2 * y;
+		ret += std::abs(y);
+		if (i > 16 && std::abs(z1) + std::abs(z2) < 1e-12) {
+			return ret;
+		}
+	}
+	return std::numeric_limits<double>::infinity();
+}
+
+// Direct form I with first order error feedback, the recursion carries
+// 8 extra bits. Coefficients are scaled by 2^shift.
+// Clamp bounds the recursion, for sections that could overflow it.
+template <bool Clamp>
+void biquad_q15(fixed_biquad& bq, std::span<int32_t> block) {
+	constexpr int extra = fixed_biquad::extra;
+	constexpr int64_t y_max = (std::numeric_limits<int32_t>::max)();
+	const int64_t a0 = bq.a0;
+	const int64_t a1 = bq.a1;
+	const int64_t a2 = bq.a2;
+	const int64_t b1 = bq.b1;
+	const int64_t b2 = bq.b2;
+	const int shift = bq.shift;
+
+	// Locals, block writes could alias the state.
+	int64_t x1 = bq.x1;
+	int64_t x2 = bq.x2;
+	int64_t y1 = bq.y1;
+	int64_t y2 = bq.y2;
+	int64_t err = bq.err;
+	for (int32_t& s : block) {
+		const int64_t x = s;
+		int64_t acc = (a0 * x + a1 * x1 + a2 * x2) << extra;
+		acc += err - b1 * y1 - b2 * y2;
+
+		int64_t y = acc >> shift;
+		err = acc - (y << shift);
+		if constexpr (Clamp) {
+			y = (std::min)((std::max)(y, -y_max), y_max);
+		}
+
+		x2 = x1;
+		x1 = x;
+		y2 = y1;
+		y1 = y;
+		s = int32_t((y + (1 << (extra - 1))) >> extra);
+	}
+	bq.x1 = int32_t(x1);
+	bq.x2 = int32_t(x2);
+	bq.y1 = y1;
+	bq.y2 = y2;
+	bq.err = err;
+}
+
+// s *= gain, gain is Q16.
+void gain_q15(int64_t gain, std::span<int32_t> block) {
+	constexpr int32_t i32_min = (std::numeric_limits<int32_t>::min)();
+	constexpr int32_t i32_max = (std::numeric_limits<int32_t>::max)();
+	for (int32_t& s : block) {
+		int64_t v = (int64_t(s) * gain + (int64_t(1) << 15)) >> 16;
+		s = int32_t(
+				(std::min)((std::max)(v, int64_t(i32_min)), int64_t(i32_max)));
+	}
+}
+} // namespace
+
+fx_engine::fx_engine(const voice& vopts)
+		: _state({
+				.preset = vopts.radio_effect(),
+				.disable_whitenoise = vopts.radio_effect_disable_whitenoise,
+				.global_vol = float(vopts.volume) * 0.01f,
+				.atan = atan_e::poly,
+				.eq = {},
+				.noise = make_noise_gen(vopts),
+				.stages = {},
+		})
+		, _in_rate(to_value(vopts.sampling_rate()))
+		, _fx_rate(_in_rate)
+		, _native_rate(vopts.radio_effect_native_rate) {
+	if (!vopts.radio_effect_file().empty()) {
+		fx_args args = load_fx_preset(vopts);
+		if (vopts.radio_effect_disable_whitenoise) {
+			args.noise_vol = 0.f;
+		}
+		_state.eq = biquad_cascade{ args.biquads };
+		_state.stages = make_fx_stages(args);
+		_fx_rate = to_value(args.sampling_rate);
+	} else if (_state.preset != radio_preset_e::count) {
+		const fx_args& args = radio_presets[_state.preset];
+		_state.eq = biquad_cascade{ args.biquads };
+		_fx_rate = to_value(args.sampling_rate);
+	}
+	init_rates();
+}
+
+fx_engine::fx_engine(const voice& vopts, const fx_args& args)
+		: _state({
+				.preset = radio_preset_e::count,
+				.disable_whitenoise = false,
+				.global_vol = float(vopts.volume) * 0.01f,
+				.atan = atan_e::poly,
+				.eq = biquad_cascade{ args.biquads },
+				.noise = make_noise_gen(vopts),
+				.stages = make_fx_stages(args),
+		})
+		, _in_rate(to_value(vopts.sampling_rate()))
+		, _fx_rate(to_value(args.sampling_rate))
+		, _native_rate(vopts.radio_effect_native_rate) {
+	init_rates();
+}
+
+void fx_engine::process(std::span<const float> in, std::vector<float>& out) {
+	_in_count += in.size();
+
+	if (_fx_rate == _in_rate) {
+		size_t begin = out.size();
+		emit(in, out);
+		process_chain(_state, { out.data() + begin, out.size() - begin });
+		return;
+	}
+
+	// Decimate to the preset rate and run the chain there.
+	_low.clear();
+	_decimator.process(in, _low);
+	process_chain(_state, _low);
+
+	if (_native_rate) {
+		emit(_low, out);
+		return;
+	}
+
+	// Back to the input rate.
+	_high.clear();
+	_interpolator.process(_low, _high);
+	emit(_high, out);
+}
+
+void fx_engine::flush(std::vector<float>& out) {
+	if (_fx_rate == _in_rate) {
+		return;
+	}
+
+	_out_limit = _in_count;
+	if (_native_rate) {
+		_out_limit = (_in_count * _fx_rate + _in_rate - 1) / _in_rate;
+	}
+
+	// Push the resampler tails through the chain.
+	_low.clear();
+	_decimator.flush(_low);
+	process_chain(_state, _low);
+
+	if (_native_rate) {
+		emit(_low, out);
+	} else {
+		_high.clear();
+		_interpolator.process(_low, _high);
+		_interpolator.flush(_high);
+		emit(_high, out);
+	}
+	assert(_out_count == _out_limit);
+}
+
+void fx_engine::start_at(size_t in_offset) {
+	assert(_in_count == 0);
+	assert(in_offset % segment_alignment() == 0);
+	// The chain draws one noise sample per preset rate sample.
+	_state.noise.discard(in_offset / segment_alignment()
+			* (_fx_rate / std::gcd(_in_rate, _fx_rate)));
+}
+
+size_t fx_engine::segment_alignment() const {
+	return _in_rate / std::gcd(_in_rate, _fx_rate);
+}
+
+void fx_engine::distortion_atan(atan_e path) {
+	assert(path != atan_e::count);
+	_state.atan = path;
+}
+
+void fx_engine::init_rates() {
+	if (_fx_rate == _in_rate) {
+		return;
+	}
+
+	_decimator = resampler{ _in_rate, _fx_rate };
+	double delay = _decimator.delay();
+	if (!_native_rate) {
+		_interpolator = resampler{ _fx_rate, _in_rate };
+		delay = delay * double(_in_rate) / double(_fx_rate)
+				+ _interpolator.delay();
+	}
+	_skip = size_t(std::lround(delay));
+}
+
+void fx_engine::emit(std::span<const float> s, std::vector<float>& out) {
+	size_t skip = (std::min)(_skip, s.size());
+	_skip -= skip;
+	s = s.subspan(skip);
+
+	size_t size = (std::min)(s.size(), _out_limit - _out_count);
+	out.insert(out.end(), s.begin(), s.begin() + size);
+	_out_count += size;
+}
+
+fx_parallel::fx_parallel(const voice& vopts, size_t num_threads)
+		: _proto(vopts)
+		, _num_threads((std::max)(num_threads, size_t(1)))
+		, _in_rate(to_value(vopts.sampling_rate()))
+		, _out_rate(to_value(fx_output_rate(vopts))) {
+	const size_t align = _proto.segment_alignment();
+	_segment_size = round_up(_in_rate * fx_segment_seconds, align);
+	// Long enough for the biquads to forget their initial state.
+	_warmup = round_up(_in_rate / 4, align);
+	// Covers both resampler delays.
+	_lookahead = round_up(2048, align);
+}
+
+void fx_parallel::process(std::span<const float> in, std::vector<float>& out) {
+	_in.insert(_in.end(), in.begin(), in.end());
+
+	const size_t window = _num_threads * _segment_size;
+	while (_in_offset + _in.size() >= _next + window + _lookahead) {
+		render(_next + window, false, out);
+	}
+}
+
+void fx_parallel::flush(std::vector<float>& out) {
+	render(_in_offset + _in.size(), true, out);
+}
+
+void fx_parallel::render(size_t end, bool last, std::vector<float>& out) {
+	const size_t in_end = _in_offset + _in.size();
+
+	std::vector<size_t> begins;
+	for (size_t b = _next; b < end; b += _segment_size) {
+		begins.push_back(b);
+	}
+	_seg_out.resize(begins.size());
+	std::vector<fx_engine> engines(begins.size(), _proto);
+	// The kept part of each segment output.
+	std::vector<std::pair<size_t, size_t>> seg_ranges(begins.size());
+
+	auto render_segment = [&](size_t seg_idx) {
+		const size_t begin = begins[seg_idx];
+		const size_t seg_end = (std::min)(begin + _segment_size, end);
+		const bool seg_last = last && seg_end == end;
+
+		// The first segment starts cold, like the serial render.
+		const size_t warm = begin - (std::min)(begin, _warmup);
+		const size_t feed_end = seg_last
+				? in_end
+				: (std::min)(seg_end + _lookahead, in_end);
+		// Segments close to the end need the resampler tails too.
+		const bool flush = last && feed_end == in_end;
+		assert(warm >= _in_offset);
+
+		fx_engine& engine = engines[seg_idx];
+		std::vector<float>& seg_out = _seg_out[seg_idx];
+		seg_out.clear();
+
+		engine.start_at(warm);
+		engine.process(
+				{ _in.data() + (warm - _in_offset), feed_end - warm }, seg_out);
+		if (flush) {
+			engine.flush(seg_out);
+		}
+
+		// Drop the warmup, and whatever belongs to the next segment.
+		const size_t skip = out_index(begin) - out_index(warm);
+		const size_t keep = seg_last
+				? seg_out.size() - skip
+				: out_index(seg_end) - out_index(begin);
+		assert(seg_out.size() >= skip + keep);
+		seg_ranges[seg_idx] = { skip, skip + keep };
+	};
+
+	// Segments are interleaved over the threads, this one included.
+	const size_t num_threads = (std::min)(_num_threads, begins.size());
+	auto work = [&](size_t thread_idx) {
+		for (size_t i = thread_idx; i < begins.size(); i += num_threads) {
+			render_segment(i);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(num_threads);
+	for (size_t t = 1; t < num_threads; ++t) {
+		threads.emplace_back(work, t);
+	}
+	work(0);
+	for (std::thread& t : threads) {
+		t.join();
+	}
+
+	for (size_t i = 0; i < begins.size(); ++i) {
+		auto [from, to] = seg_ranges[i];
+		out.insert(out.end(), _seg_out[i].begin() + from,
+				_seg_out[i].begin() + to);
+	}
+
+	// Keep what the next segments warm up on.
+	_next = end;
+	const size_t keep_from = _next - (std::min)(_next, _warmup);
+	if (keep_from > _in_offset) {
+		_in.erase(_in.begin(), _in.begin() + (keep_from - _in_offset));
+		_in_offset = keep_from;
+	}
+}
+
+size_t fx_parallel::out_index(size_t in_idx) const {
+	return in_idx / _in_rate * _out_rate
+			+ in_idx % _in_rate * _out_rate / _in_rate;
+}
+
+fx_fixed_engine::fx_fixed_engine(const voice& vopts)
+		: fx_fixed_engine(vopts, to_fx_args(vopts)) {
+}
+
+fx_fixed_engine::fx_fixed_engine(const voice& vopts, const fx_args& args)
+		: _noise(make_noise_gen(vopts))
+		, _noise_after_bitcrush(args.noise_after_bitcrush)
+		, _in_rate(to_value(vopts.sampling_rate()))
+		, _fx_rate(to_value(args.sampling_rate))
+		, _native_rate(vopts.radio_effect_native_rate) {
+	constexpr double q47 = double(int64_t(1) << 47);
+	const double global_vol = double(vopts.volume) * 0.01;
+	if (args.noise_vol != 0.f) {
+		// Same as the float mix, amplitude brings int32 noise to Q15.
+		_noise_dry = std::llround((1.0 - double(args.noise_vol)) * q47);
+		_noise_amplitude = std::llround(double(args.noise_vol) * global_vol
+				* double(q15_max) * 65536.0);
+	}
+
+	// 16 bits and over is lossless at Q15.
+	if (args.bit_depth < 16) {
+		_crush_mul = (int64_t(1) << (args.bit_depth - 1)) - 1;
+		_crush_step = std::llround(
+				double(q15_max) * 65536.0 / double(_crush_mul));
+	}
+
+	if (args.dist_drive != 0.f) {
+		// Tabulate the float waveshaper over every int16 input.
+		const float drive = args.dist_drive * 100.f;
+		const float atten = (1.f
+				- (args.dist_drive * args.dist_drive
+						+ (0.9f - args.dist_drive)));
+		std::vector<float> shaped(size_t(q15_max) * 2 + 2);
+		for (size_t i = 0; i < shaped.size(); ++i) {
+			shaped[i] = float(int32_t(i) - q15_max - 1) / float(q15_max);
+		}
+		distort(atan_e::precise, drive, distortion_norm(args.dist_drive),
+				atten, shaped);
+
+		_shaper.resize(shaped.size());
+		for (size_t i = 0; i < shaped.size(); ++i) {
+			_shaper[i] = saturate_q15(
+					std::llround(double(shaped[i]) * double(q15_max)));
+		}
+	}
+
+	// Bounds the eq input, distortion and crushing output within [-1, 1].
+	double eq_bound = double(q15_max);
+	for (const biquad_args& b : args.biquads) {
+		if (b.type == biquad_type_e::count) {
+			continue;
+		}
+		biquad_coefs c = make_biquad_coefs(b);
+		const std::array<float, 5> coefs{ c.a0, c.a1, c.a2, c.b1, c.b2 };
+		float max_coef = 0.f;
+		for (float v : coefs) {
+			max_coef = (std::max)(max_coef, std::abs(v));
+		}
+
+		// As much precision as fits, |b1| < 2 keeps at least Q28.
+		fixed_biquad& bq = _eq[_eq_size++];
+		bq.shift = (std::min)(
+				29 - int(std::ceil(std::log2((std::max)(max_coef, 1.f)))), 29);
+		const double scale = std::ldexp(1.0, bq.shift);
+		bq.a0 = int32_t(std::llround(double(c.a0) * scale));
+		bq.a1 = int32_t(std::llround(double(c.a1) * scale));
+		bq.a2 = int32_t(std::llround(double(c.a2) * scale));
+		bq.b1 = int32_t(std::llround(double(c.b1) * scale));
+		bq.b2 = int32_t(std::llround(double(c.b2) * scale));
+
+		// The recursion holds 32 bits, clamp if the output could exceed it.
+		eq_bound *= impulse_l1(c);
+		bq.clamp = eq_bound * double(1 << fixed_biquad::extra)
+				>= double((std::numeric_limits<int32_t>::max)());
+	}
+
+	if (args.gain != 1.f) {
+		_gain = std::llround(double(args.gain) * 65536.0);
+	}
+
+	if (_fx_rate != _in_rate) {
+		_decimator = resampler_q15{ _in_rate, _fx_rate };
+		double delay = _decimator.delay();
+		if (!_native_rate) {
+			_interpolator = resampler_q15{ _fx_rate, _in_rate };
+			delay = delay * double(_in_rate) / double(_fx_rate)
+					+ _interpolator.delay();
+		}
+		_skip = size_t(std::lround(delay));
+	}
+}
+
+size_t fx_fixed_engine::process(std::span<int16_t> samples) {
+	return process_pcm(samples);
+}
+
+size_t fx_fixed_engine::process(std::span<int8_t> samples) {
+	return process_pcm(samples);
+}
+
+void fx_fixed_engine::flush(std::vector<int16_t>& out) {
+	flush_pcm(out);
+}
+
+void fx_fixed_engine::flush(std::vector<int8_t>& out) {
+	flush_pcm(out);
+}
+
+template <class IntT>
+size_t fx_fixed_engine::process_pcm(std::span<IntT> samples) {
+	_in_count += samples.size();
+
+	if (_fx_rate == _in_rate) {
+		// No delay, straight in place.
+		std::array<int32_t, fx_block_size> block;
+		for (size_t i = 0; i < samples.size(); i += fx_block_size) {
+			size_t size = (std::min)(fx_block_size, samples.size() - i);
+			for (size_t j = 0; j < size; ++j) {
+				block[j] = to_q15(samples[i + j]);
+			}
+			process_chain({ block.data(), size });
+			for (size_t j = 0; j < size; ++j) {
+				samples[i + j] = from_q15<IntT>(saturate_q15(block[j]));
+			}
+		}
+		return samples.size();
+	}
+
+	// Decimate to the preset rate and run the chain there.
+	std::span<const int16_t> in;
+	if constexpr (std::is_same_v<IntT, int16_t>) {
+		in = samples;
+	} else {
+		_wide.resize(samples.size());
+		for (size_t i = 0; i < samples.size(); ++i) {
+			_wide[i] = int16_t(to_q15(samples[i]));
+		}
+		in = _wide;
+	}
+
+	_low.clear();
+	_decimator.process(in, _low);
+	process_chain(_low);
+
+	if (_native_rate) {
+		emit(_low);
+	} else {
+		// Back to the input rate.
+		_high.clear();
+		_interpolator.process(_low, _high);
+		emit(_high);
+	}
+
+	// Output never overtakes input, whatever doesn't fit fits later.
+	size_t size = (std::min)(_pending.size(), samples.size());
+	for (size_t i = 0; i < size; ++i) {
+		samples[i] = from_q15<IntT>(_pending[i]);
+	}
+	_pending.erase(_pending.begin(), _pending.begin() + size);
+	return size;
+}
+
+template <class IntT>
+void fx_fixed_engine::flush_pcm(std::vector<IntT>& out) {
+	if (_fx_rate != _in_rate) {
+		_out_limit = _in_count;
+		if (_native_rate) {
+			_out_limit = (_in_count * _fx_rate + _in_rate - 1) / _in_rate;
+		}
+
+		// Push the resampler tails through the chain.
+		_low.clear();
+		_decimator.flush(_low);
+		process_chain(_low);
+
+		if (_native_rate) {
+			emit(_low);
+		} else {
+			_high.clear();
+			_interpolator.process(_low, _high);
+			_interpolator.flush(_high);
+			emit(_high);
+		}
+		assert(_out_count == _out_limit);
+	}
+
+	for (int16_t s : _pending) {
+		out.push_back(from_q15<IntT>(s));
+	}
+	_pending.clear();
+}
+
+void fx_fixed_engine::process_chain(std::span<int32_t> block) {
+	const bool noise = _noise_amplitude != 0;
+	if (noise && !_noise_after_bitcrush) {
+		white_noise_q15(_noise, _noise_dry, _noise_amplitude, block);
+	}
+	if (_crush_mul != 0) {
+		bit_crush_q15(_crush_mul, _crush_step, block);
+	}
+	if (noise && _noise_after_bitcrush) {
+		white_noise_q15(_noise, _noise_dry, _noise_amplitude, block);
+	}
+	if (!_shaper.empty()) {
+		distort_q15(_shaper, block);
+	}
+	for (size_t i = 0; i < _eq_size; ++i) {
+		if (_eq[i].clamp) {
+			biquad_q15<true>(_eq[i], block);
+		} else {
+			biquad_q15<false>(_eq[i], block);
+		}
+	}
+	if (_gain != 0) {
+		gain_q15(_gain, block);
+	}
+}
+
+void fx_fixed_engine::process_chain(std::vector<int16_t>& samples) {
+	std::array<int32_t, fx_block_size> block;
+	for (size_t i = 0; i < samples.size(); i += fx_block_size) {
+		size_t size = (std::min)(fx_block_size, samples.size() - i);
+		std::copy_n(samples.begin() + i, size, block.begin());
+		process_chain({ block.data(), size });
+		for (size_t j = 0; j < size; ++j) {
+			samples[i + j] = saturate_q15(block[j]);
+		}
+	}
+}
+
+void fx_fixed_engine::emit(std::span<const int16_t> s) {
+	size_t skip = (std::min)(_skip, s.size());
+	_skip -= skip;
+	s = s.subspan(skip);
+
+	size_t size = (std::min)(s.size(), _out_limit - _out_count);
+	_pending.insert(_pending.end(), s.begin(), s.begin() + size);
+	_out_count += size;
+}
+
+size_t fx_thread_count(const voice& vopts, size_t num_samples) {
+	if (!vopts.has_radio_effect()
+			|| num_samples < to_value(vopts.sampling_rate())
+							* fx_parallel_min_seconds) {
+		return 1;
+	}
+	return (std::max)(size_t(std::thread::hardware_concurrency()), size_t(1));
+}
+
+sampling_rate_e fx_output_rate(const voice& vopts) {
+	if (!vopts.has_radio_effect() || !vopts.radio_effect_native_rate) {
+		return vopts.sampling_rate();
+	}
+	if (!vopts.radio_effect_file().empty()) {
+		return load_fx_preset(vopts).sampling_rate;
+	}
+	return radio_presets[vopts.radio_effect()].sampling_rate;
+}
+
+void process_fx(const voice& vopts, std::vector<float>& samples) {
+	if (!vopts.has_radio_effect()) {
+		return;
+	}
+
+	fx_engine engine{ vopts };
+	std::vector<float> out;
+	out.reserve(samples.size());
+	engine.process(samples, out);
+	engine.flush(out);
+	samples = std::move(out);
+}
+
+void process_fx(
+		const voice& vopts, std::vector<float>& samples, size_t num_threads) {
+	if (!vopts.has_radio_effect()) {
+		return;
+	}
+
+	fx_parallel engine{ vopts, num_threads };
+	std::vector<float> out;
+	out.reserve(samples.size());
+	engine.process(samples, out);
+	engine.flush(out);
+	samples = std::move(out);
+}
+} // namespace wsay
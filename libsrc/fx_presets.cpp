@@ -0,0 +1,298 @@
+#include "private_include/fx_presets.hpp"
+
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <exception>
+#include <fea/utils/throw.hpp>
+#include <format>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace wsay {
+namespace {
+// Parsed preset files, by path. Refreshed by cache_fx_preset.
+std::mutex preset_cache_mutex;
+std::map<std::filesystem::path, std::shared_ptr<const fx_args>> preset_cache;
+
+enum class section_e : uint8_t {
+	radio,
+	biquad,
+	count,
+};
+
+std::string_view trim(std::string_view s) {
+	constexpr std::string_view ws = " \t\r\n";
+	size_t b = s.find_first_not_of(ws);
+	if (b == std::string_view::npos) {
+		return {};
+	}
+	size_t e = s.find_last_not_of(ws);
+	return s.substr(b, e - b + 1);
+}
+
+[[noreturn]] void invalid(size_t line_num, std::string_view msg) {
+	fea::maybe_throw<std::invalid_argument>(__FUNCTION__, __LINE__,
+			std::format("Radio preset line {} : {}", line_num, msg));
+	// Unreachable, satisfies noreturn.
+	std::terminate();
+}
+
+float to_float(size_t line_num, std::string_view key, std::string_view val) {
+	float ret = 0.f;
+	auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), ret);
+	if (ec != std::errc{} || ptr != val.data() + val.size()) {
+		invalid(line_num, std::format("'{}' expects a number.", key));
+	}
+	return ret;
+}
+
+// Checks min <= v <= max.
+float to_float(size_t line_num, std::string_view key, std::string_view val,
+		float min, float max) {
+	float ret = to_float(line_num, key, val);
+	if (!(ret >= min && ret <= max)) {
+		invalid(line_num,
+				std::format("'{}' must be between {} and {}.", key, min, max));
+	}
+	return ret;
+}
+
+size_t to_size(size_t line_num, std::string_view key, std::string_view val) {
+	size_t ret = 0;
+	auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), ret);
+	if (ec != std::errc{} || ptr != val.data() + val.size()) {
+		invalid(line_num, std::format("'{}' expects an integer.", key));
+	}
+	return ret;
+}
+
+bool to_bool(size_t line_num, std::string_view key, std::string_view val) {
+	if (val == "true" || val == "1") {
+		return true;
+	}
+	if (val == "false" || val == "0") {
+		return false;
+	}
+	invalid(line_num, std::format("'{}' expects true or false.", key));
+}
+
+sampling_rate_e to_sampling_rate(
+		size_t line_num, std::string_view key, std::string_view val) {
+	switch (to_size(line_num, key, val)) {
+	case 8000: {
+		return sampling_rate_e::_8;
+	} break;
+	case 11025: {
+		return sampling_rate_e::_11;
+	} break;
+	case 22050: {
+		return sampling_rate_e::_22;
+	} break;
+	case 44100: {
+		return sampling_rate_e::_44;
+	} break;
+	default: {
+	} break;
+	}
+	invalid(line_num,
+			std::format("'{}' must be 8000, 11025, 22050 or 44100.", key));
+}
+
+biquad_type_e to_biquad_type(
+		size_t line_num, std::string_view key, std::string_view val) {
+	if (val == "lowpass") {
+		return biquad_type_e::lowpass;
+	}
+	if (val == "highpass") {
+		return biquad_type_e::highpass;
+	}
+	if (val == "bandpass") {
+		return biquad_type_e::bandbass;
+	}
+	if (val == "notch") {
+		return biquad_type_e::notch;
+	}
+	if (val == "peaking") {
+		return biquad_type_e::peaking;
+	}
+	if (val == "lowshelf") {
+		return biquad_type_e::lowshelf;
+	}
+	if (val == "highshelf") {
+		return biquad_type_e::highshelf;
+	}
+	invalid(line_num,
+			std::format("'{}' must be lowpass, highpass, bandpass, notch, "
+						"peaking, lowshelf or highshelf.",
+					key));
+}
+
+void parse_radio(size_t line_num, std::string_view key, std::string_view val,
+		fx_args& args) {
+	if (key == "bit_depth") {
+		args.bit_depth = to_size(line_num, key, val);
+		if (args.bit_depth < 2 || args.bit_depth > 24) {
+			invalid(line_num, "'bit_depth' must be between 2 and 24.");
+		}
+	} else if (key == "sampling_rate") {
+		args.sampling_rate = to_sampling_rate(line_num, key, val);
+	} else if (key == "dist_drive") {
+		args.dist_drive = to_float(line_num, key, val, 0.f, 1.f);
+	} else if (key == "noise_vol") {
+		args.noise_vol = to_float(line_num, key, val, 0.f, 1.f);
+	} else if (key == "noise_after_bitcrush") {
+		args.noise_after_bitcrush = to_bool(line_num, key, val);
+	} else if (key == "gain") {
+		args.gain = to_float(line_num, key, val, 0.f, 100.f);
+	} else {
+		invalid(line_num, std::format("Unknown [radio] key '{}'.", key));
+	}
+}
+
+void parse_biquad(size_t line_num, std::string_view key, std::string_view val,
+		biquad_args& args) {
+	if (key == "type") {
+		args.type = to_biquad_type(line_num, key, val);
+	} else if (key == "freq") {
+		// Normalized by the preset sampling rate.
+		args.freq = to_float(line_num, key, val);
+		if (!(args.freq > 0.f && args.freq < 0.5f)) {
+			invalid(line_num, "'freq' must be between 0 and 0.5 (exclusive).");
+		}
+	} else if (key == "q") {
+		args.q = to_float(line_num, key, val);
+		if (!(args.q > 0.f) || std::isinf(args.q)) {
+			invalid(line_num, "'q' must be a number greater than 0.");
+		}
+	} else if (key == "gain") {
+		args.gain = to_float(line_num, key, val, -48.f, 48.f);
+	} else {
+		invalid(line_num, std::format("Unknown [biquad] key '{}'.", key));
+	}
+}
+} // namespace
+
+fx_args parse_fx_preset(std::string_view ini) {
+	// Defaults barely alter the signal, 24 bits at 44.1kHz.
+	fx_args ret{
+		.bit_depth = 24,
+		.sampling_rate = sampling_rate_e::_44,
+		.dist_drive = 0.f,
+		.noise_vol = 0.f,
+		.noise_after_bitcrush = false,
+		.biquads = {},
+		.gain = 1.f,
+	};
+
+	section_e section = section_e::count;
+	// Each [biquad] section adds a filter to the cascade.
+	size_t num_biquads = 0;
+	size_t line_num = 0;
+	while (!ini.empty()) {
+		++line_num;
+		size_t nl = ini.find('\n');
+		std::string_view line = trim(ini.substr(0, nl));
+		ini = nl == std::string_view::npos ? std::string_view{}
+											: ini.substr(nl + 1);
+
+		if (line.empty() || line.front() == '#' || line.front() == ';') {
+			continue;
+		}
+
+		if (line.front() == '[') {
+			if (line.back() != ']') {
+				invalid(line_num, "Unterminated section.");
+			}
+			std::string_view name = trim(line.substr(1, line.size() - 2));
+			if (name == "radio") {
+				section = section_e::radio;
+			} else if (name == "biquad") {
+				if (num_biquads == ret.biquads.size()) {
+					invalid(line_num,
+							std::format("Too many [biquad] sections, the "
+										"maximum is {}.",
+									ret.biquads.size()));
+				}
+				section = section_e::biquad;
+				++num_biquads;
+			} else {
+				invalid(line_num, std::format("Unknown section '{}'.", name));
+			}
+			continue;
+		}
+
+		size_t eq = line.find('=');
+		if (eq == std::string_view::npos) {
+			invalid(line_num, "Expected 'key = value'.");
+		}
+		std::string_view key = trim(line.substr(0, eq));
+		std::string_view val = trim(line.substr(eq + 1));
+
+		switch (section) {
+		case section_e::radio: {
+			parse_radio(line_num, key, val, ret);
+		} break;
+		case section_e::biquad: {
+			parse_biquad(line_num, key, val, ret.biquads[num_biquads - 1]);
+		} break;
+		default: {
+			invalid(line_num, "Key outside of a section.");
+		} break;
+		}
+	}
+
+	for (size_t i = 0; i < num_biquads; ++i) {
+		if (ret.biquads[i].type == biquad_type_e::count) {
+			fea::maybe_throw<std::invalid_argument>(__FUNCTION__, __LINE__,
+					std::format("Radio preset [biquad] section {} is missing "
+								"its 'type'.",
+							i + 1));
+		}
+	}
+	return ret;
+}
+
+fx_args load_fx_preset(const std::filesystem::path& preset_file) {
+	std::ifstream ifs{ preset_file, std::ios::binary };
+	if (!ifs.is_open()) {
+		fea::maybe_throw<std::invalid_argument>(__FUNCTION__, __LINE__,
+				std::format("Couldn't open radio preset file '{}'.",
+						preset_file.string()));
+	}
+
+	std::stringstream ss;
+	ss << ifs.rdbuf();
+	return parse_fx_preset(ss.str());
+}
+
+fx_args load_fx_preset(const voice& vopts) {
+	assert(!vopts.radio_effect_file().empty());
+	std::shared_ptr<const fx_args> cached;
+	{
+		std::unique_lock lock{ preset_cache_mutex };
+		auto it = preset_cache.find(vopts.radio_effect_file());
+		if (it != preset_cache.end()) {
+			cached = it->second;
+		}
+	}
+
+	if (cached == nullptr) {
+		return load_fx_preset(vopts.radio_effect_file());
+	}
+	return *cached;
+}
+
+void cache_fx_preset(const std::filesystem::path& preset_file) {
+	// Parse outside the lock, renders keep reading the previous version.
+	auto preset = std::make_shared<const fx_args>(load_fx_preset(preset_file));
+	std::unique_lock lock{ preset_cache_mutex };
+	preset_cache.insert_or_assign(preset_file, std::move(preset));
+}
+} // namespace wsay
@@ -0,0 +1,356 @@
+#include "private_include/backend.hpp"
+#include "private_include/fx_chain.hpp"
+#include "private_include/pcm.hpp"
+#include "private_include/wav.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cwctype>
+#include <fea/numerics/literals.hpp>
+#include <fea/utils/throw.hpp>
+#include <format>
+#include <mutex>
+#include <numbers>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace fea::literals;
+
+namespace wsay {
+namespace {
+// Synthesized audio is handed out in pieces of this length.
+constexpr size_t block_ms = 10;
+
+// Durations at normal speed.
+constexpr double letter_ms = 70.0;
+constexpr double space_ms = 40.0;
+constexpr double comma_ms = 120.0;
+constexpr double sentence_ms = 200.0;
+
+struct headless_voice_info {
+	const wchar_t* name;
+	// Fundamental frequency, in Hz.
+	double f0;
+};
+
+constexpr std::array<headless_voice_info, 2> headless_voices{ {
+		{ L"Headless Low - wsay tone generator", 120.0 },
+		{ L"Headless High - wsay tone generator", 210.0 },
+} };
+
+size_t bytes_per_sample(bit_depth_e bit_depth) {
+	return bit_depth == bit_depth_e::_8 ? 1 : 2;
+}
+
+// Returns the value of a speech xml attribute, 0 if missing.
+int attribute(std::wstring_view tag, std::wstring_view name) {
+	size_t pos = tag.find(name);
+	if (pos == std::wstring_view::npos) {
+		return 0;
+	}
+	pos = tag.find_first_of(L"\"'", pos + name.size());
+	if (pos == std::wstring_view::npos) {
+		return 0;
+	}
+
+	int ret = 0;
+	bool negative = false;
+	for (size_t i = pos + 1; i < tag.size(); ++i) {
+		const wchar_t c = tag[i];
+		if (c == L'-' && i == pos + 1) {
+			negative = true;
+		} else if (c >= L'0' && c <= L'9') {
+			ret = (std::min)(ret * 10 + int(c - L'0'), 1'000'000);
+		} else {
+			break;
+		}
+	}
+	return negative ? -ret : ret;
+}
+
+// Speaks every letter as a short voiced tone. Output only depends on the
+// text and voice options.
+struct headless_synthesizer final : synthesizer {
+	headless_synthesizer(const voice& vopts, double synth_rtf)
+			: _rate(double(to_value(vopts.sampling_rate())))
+			, _bit_depth(vopts.bit_depth())
+			, _f0(headless_voices[vopts.voice_idx].f0)
+			, _synth_rtf(synth_rtf) {
+		configure(vopts);
+	}
+
+	void synthesize(
+			const std::wstring& text, const pcm_callback_t& on_pcm) override {
+		_stop = false;
+		_block.clear();
+		_produced = 0;
+		_start = std::chrono::steady_clock::now();
+
+		// Pitch tags nest.
+		std::vector<double> pitch_stack{ 1.0 };
+
+		size_t i = 0;
+		while (i < text.size() && !_stop) {
+			const wchar_t c = text[i];
+			if (_xml && c == L'<') {
+				size_t end = text.find(L'>', i);
+				end = end == std::wstring::npos ? text.size() : end + 1;
+				std::wstring_view tag{ text.data() + i, end - i };
+				i = end;
+
+				if (tag.starts_with(L"<silence")) {
+					silence(double((std::max)(attribute(tag, L"msec"), 0)),
+							on_pcm);
+				} else if (tag.starts_with(L"<pitch")) {
+					// Half a semitone per step.
+					const int p
+							= std::clamp(attribute(tag, L"absmiddle"), -10, 10);
+					pitch_stack.push_back(std::pow(2.0, double(p) / 24.0));
+				} else if (tag.starts_with(L"</pitch")
+						&& pitch_stack.size() > 1) {
+					pitch_stack.pop_back();
+				}
+				continue;
+			}
+			++i;
+
+			if (c == L'.' || c == L'!' || c == L'?' || c == L'\n') {
+				silence(sentence_ms * _time_scale, on_pcm);
+			} else if (c == L',' || c == L';' || c == L':') {
+				silence(comma_ms * _time_scale, on_pcm);
+			} else if (std::iswspace(c)) {
+				silence(space_ms * _time_scale, on_pcm);
+			} else if (!std::iswpunct(c)) {
+				syllable(c, _f0 * pitch_stack.back(), on_pcm);
+			}
+		}
+		emit(on_pcm);
+	}
+
+	void stop() override {
+		_stop = true;
+	}
+
+	void configure(const voice& vopts) override {
+		_xml = vopts.xml_parse;
+		_amplitude
+				= 0.5 * double(std::clamp(vopts.volume, 0_u8, 100_u8)) / 100.0;
+
+		// Matches SAPI rates, -10 to 10, 10 being 3 times faster.
+		const double rate
+				= double(std::clamp(int(vopts.speed), 0, 100)) / 5.0 - 10.0;
+		_time_scale = std::pow(3.0, -rate / 10.0);
+	}
+
+private:
+	void push(float sample, const pcm_callback_t& on_pcm) {
+		_block.push_back(sample);
+		if (_block.size() == size_t(_rate) * block_ms / 1'000) {
+			emit(on_pcm);
+		}
+	}
+
+	void silence(double ms, const pcm_callback_t& on_pcm) {
+		const size_t count = size_t(ms * _rate / 1'000.0);
+		for (size_t i = 0; i < count && !_stop; ++i) {
+			push(0.f, on_pcm);
+		}
+	}
+
+	// A raised cosine burst of the fundamental, plus a formant picked by the
+	// character.
+	void syllable(wchar_t c, double f0, const pcm_callback_t& on_pcm) {
+		constexpr double two_pi = 2.0 * std::numbers::pi;
+		const size_t count = size_t(letter_ms * _time_scale * _rate / 1'000.0);
+		const double formant = 500.0 + 120.0 * double(uint32_t(c) % 16);
+		if (count < 2) {
+			return;
+		}
+
+		double phase0 = 0.0;
+		double phase1 = 0.0;
+		for (size_t i = 0; i < count && !_stop; ++i) {
+			const double env = 0.5
+					- 0.5 * std::cos(two_pi * double(i) / double(count - 1));
+			const double s
+					= 0.7 * std::sin(phase0) + 0.3 * std::sin(phase1);
+			push(float(_amplitude * env * s), on_pcm);
+
+			phase0 = std::fmod(phase0 + two_pi * f0 / _rate, two_pi);
+			phase1 = std::fmod(phase1 + two_pi * formant / _rate, two_pi);
+		}
+	}
+
+	// Hands out the pending samples, then waits as long as a voice with the
+	// configured real-time factor would have.
+	void emit(const pcm_callback_t& on_pcm) {
+		if (_block.empty()) {
+			return;
+		}
+
+		const size_t size = _block.size();
+		if (_bit_depth == bit_depth_e::_8) {
+			_pcm.resize(size);
+			int8_t* data = reinterpret_cast<int8_t*>(_pcm.data());
+			float_to_pcm(_block, std::span<int8_t>{ data, size });
+		} else {
+			_pcm.resize(size * sizeof(int16_t));
+			int16_t* data = reinterpret_cast<int16_t*>(_pcm.data());
+			float_to_pcm(_block, std::span<int16_t>{ data, size });
+		}
+		if (!on_pcm(_pcm)) {
+			_stop = true;
+		}
+
+		_produced += _block.size();
+		_block.clear();
+
+		if (_synth_rtf > 0.0) {
+			using duration_t = std::chrono::steady_clock::duration;
+			const std::chrono::duration<double> dt{ _synth_rtf
+				* double(_produced) / _rate };
+			std::this_thread::sleep_until(
+					_start + std::chrono::duration_cast<duration_t>(dt));
+		}
+	}
+
+	double _rate = 44'100.0;
+	bit_depth_e _bit_depth = bit_depth_e::_16;
+	bool _xml = true;
+	double _f0 = 120.0;
+	double _amplitude = 0.5;
+	double _time_scale = 1.0;
+	double _synth_rtf = 0.0;
+
+	std::atomic<bool> _stop = false;
+	std::chrono::steady_clock::time_point _start{};
+	size_t _produced = 0;
+	std::vector<float> _block;
+	std::vector<std::byte> _pcm;
+};
+
+// Discards audio. When realtime, plays for as long as the audio lasts and
+// holds the queued buffers until then, like a device reading them.
+struct headless_device final : audio_sink {
+	headless_device(const voice& vopts, bool realtime)
+			: _realtime(realtime) {
+		configure(vopts);
+	}
+
+	void play(const shared_pcm& pcm, bool purge) override {
+		if (!_realtime) {
+			return;
+		}
+
+		const std::chrono::duration<double> dt{ double(pcm->size())
+												/ _bytes_per_sec };
+		std::unique_lock lock{ _mutex };
+		const auto now = std::chrono::steady_clock::now();
+		if (purge || _end < now) {
+			_end = now;
+			_queue.clear();
+		}
+		_end += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				dt);
+		_queue.push_back(pcm);
+	}
+
+	void wait() override {
+		// Playback may be extended or stopped while waiting.
+		std::unique_lock lock{ _mutex };
+		while (std::chrono::steady_clock::now() < _end) {
+			const auto end = _end;
+			_cv.wait_until(lock, end);
+		}
+		_queue.clear();
+	}
+
+	void stop() override {
+		{
+			std::unique_lock lock{ _mutex };
+			_end = std::chrono::steady_clock::now();
+			_queue.clear();
+		}
+		_cv.notify_all();
+	}
+
+	void reset() override {
+		// The next play purges.
+	}
+
+	void configure(const voice& vopts) override {
+		_bytes_per_sec = double(to_value(fx_output_rate(vopts))
+				* bytes_per_sample(vopts.bit_depth()));
+	}
+
+private:
+	double _bytes_per_sec = 88'200.0;
+	bool _realtime = false;
+
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	// When the queued audio is done playing.
+	std::chrono::steady_clock::time_point _end{};
+	std::vector<shared_pcm> _queue;
+};
+
+struct headless_backend final : backend {
+	explicit headless_backend(const headless_options& opts)
+			: _opts(opts) {
+		for (const headless_voice_info& info : headless_voices) {
+			_voices.push_back(info.name);
+		}
+		for (size_t i = 0; i < _opts.num_devices; ++i) {
+			_devices.push_back(std::format(L"Headless Device {}", i));
+		}
+	}
+
+	void snapshot_path(const std::filesystem::path&) override {
+		// Nothing to enumerate.
+	}
+
+	const std::vector<std::wstring>& voices() override {
+		return _voices;
+	}
+	const std::vector<std::wstring>& devices() override {
+		return _devices;
+	}
+	size_t default_device_idx() override {
+		return 0;
+	}
+
+	std::unique_ptr<synthesizer> make_synthesizer(const voice& vopts) override {
+		if (vopts.compression() != compression_e::none) {
+			fea::maybe_throw<std::invalid_argument>(__FUNCTION__, __LINE__,
+					"Headless voices only output uncompressed pcm.");
+		}
+		return std::make_unique<headless_synthesizer>(vopts, _opts.synth_rtf);
+	}
+
+	std::unique_ptr<audio_sink> make_sink(
+			const voice& vopts, const voice_output& vout) override {
+		if (vout.type == output_type_e::file) {
+			return std::make_unique<wav_sink>(vopts, vout.file_path);
+		}
+		return std::make_unique<headless_device>(
+				vopts, _opts.realtime_devices);
+	}
+
+private:
+	headless_options _opts;
+	std::vector<std::wstring> _voices;
+	std::vector<std::wstring> _devices;
+};
+} // namespace
+
+std::unique_ptr<backend> make_headless_backend(const headless_options& opts) {
+	return std::make_unique<headless_backend>(opts);
+}
+} // namespace wsay
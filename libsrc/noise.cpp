@@ -0,0 +1,132 @@
+#include "private_include/noise.hpp"
+
+#include <random>
+
+namespace wsay {
+namespace {
+// https://prng.di.unimi.it/splitmix64.c
+// Spreads a single seed over the lanes.
+uint64_t splitmix64(uint64_t& x) {
+	uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+uint64_t random_seed() {
+	std::random_device rd;
+	return uint64_t(rd()) << 32 | uint64_t(rd());
+}
+
+uint32_t xorshift32(uint32_t x) {
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+// xorshift is linear over GF(2), steps are 32x32 bit matrix products.
+// Column b holds the image of bit b.
+using gf2_matrix = std::array<uint32_t, 32>;
+
+uint32_t gf2_apply(const gf2_matrix& m, uint32_t v) {
+	uint32_t ret = 0;
+	for (size_t b = 0; b < 32; ++b) {
+		ret ^= m[b] & (0u - ((v >> b) & 1u));
+	}
+	return ret;
+}
+
+gf2_matrix gf2_multiply(const gf2_matrix& lhs, const gf2_matrix& rhs) {
+	gf2_matrix ret{};
+	for (size_t b = 0; b < 32; ++b) {
+		ret[b] = gf2_apply(lhs, rhs[b]);
+	}
+	return ret;
+}
+
+// Advances every state by steps.
+void xorshift32_jump(std::span<uint32_t> states, uint64_t steps) {
+	gf2_matrix m{};
+	for (size_t b = 0; b < 32; ++b) {
+		m[b] = xorshift32(1u << b);
+	}
+
+	while (steps != 0) {
+		if (steps & 1u) {
+			for (uint32_t& x : states) {
+				x = gf2_apply(m, x);
+			}
+		}
+		m = gf2_multiply(m, m);
+		steps >>= 1;
+	}
+}
+} // namespace
+
+noise_gen::noise_gen()
+		: noise_gen(random_seed()) {
+}
+
+noise_gen::noise_gen(uint64_t seed) {
+	for (uint32_t& s : _state) {
+		s = uint32_t(splitmix64(seed));
+		// xorshift never leaves 0.
+		if (s == 0) {
+			s = 0x9e3779b9u;
+		}
+	}
+}
+
+template <class T, class Func>
+void noise_gen::fill_lanes(std::span<T> out, Func&& convert) {
+	std::array<uint32_t, lanes> state = _state;
+	size_t lane = _lane;
+	size_t i = 0;
+
+	// Finish the lane group a previous fill started.
+	for (; lane != 0 && i < out.size(); ++i) {
+		state[lane] = xorshift32(state[lane]);
+		out[i] = convert(state[lane]);
+		lane = (lane + 1) % lanes;
+	}
+
+	for (; i + lanes <= out.size(); i += lanes) {
+		for (size_t l = 0; l < lanes; ++l) {
+			state[l] = xorshift32(state[l]);
+			out[i + l] = convert(state[l]);
+		}
+	}
+
+	for (; i < out.size(); ++i) {
+		state[lane] = xorshift32(state[lane]);
+		out[i] = convert(state[lane]);
+		lane = (lane + 1) % lanes;
+	}
+
+	_state = state;
+	_lane = lane;
+}
+
+void noise_gen::fill(std::span<float> out, float amplitude) {
+	// Signed 32 bit range to [-amplitude, amplitude).
+	const float norm = amplitude * (1.f / 2147483648.f);
+	fill_lanes(out, [norm](uint32_t x) { return float(int32_t(x)) * norm; });
+}
+
+void noise_gen::fill(std::span<int32_t> out) {
+	fill_lanes(out, [](uint32_t x) { return int32_t(x); });
+}
+
+void noise_gen::discard(uint64_t n) {
+	xorshift32_jump(_state, n / lanes);
+
+	// Sample i comes from lane (_lane + i) % lanes.
+	const size_t rem = size_t(n % lanes);
+	for (size_t i = 0; i < rem; ++i) {
+		size_t l = (_lane + i) % lanes;
+		_state[l] = xorshift32(_state[l]);
+	}
+	_lane = (_lane + rem) % lanes;
+}
+} // namespace wsay
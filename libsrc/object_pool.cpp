@@ -0,0 +1,87 @@
+#include "private_include/object_pool.hpp"
+
+namespace wsay {
+namespace {
+// Idle objects kept per key, for concurrent speakers.
+constexpr size_t max_idle = 4;
+
+template <class Key, class T>
+std::unique_ptr<T> pop(
+		std::unordered_map<Key, std::vector<std::unique_ptr<T>>>& pool,
+		const Key& key) {
+	auto it = pool.find(key);
+	if (it == pool.end() || it->second.empty()) {
+		return nullptr;
+	}
+	std::unique_ptr<T> ret = std::move(it->second.back());
+	it->second.pop_back();
+	return ret;
+}
+
+template <class Key, class T>
+void push(std::unordered_map<Key, std::vector<std::unique_ptr<T>>>& pool,
+		const Key& key, std::unique_ptr<T>&& obj) {
+	std::vector<std::unique_ptr<T>>& idle = pool[key];
+	if (idle.size() < max_idle) {
+		idle.push_back(std::move(obj));
+	}
+}
+
+// Compressed formats play through a different kind of sink.
+uint64_t sink_key(const voice& vopts, const voice_output& vout) {
+	return uint64_t(vout.device_idx) << 8 | uint64_t(vopts.compression());
+}
+} // namespace
+
+uint64_t synthesizer_key(const voice& vopts) {
+	return uint64_t(vopts.voice_idx) << 24
+			| uint64_t(vopts.compression()) << 16
+			| uint64_t(vopts.bit_depth()) << 8
+			| uint64_t(vopts.sampling_rate());
+}
+
+std::unique_ptr<synthesizer> object_pool::acquire_synthesizer(
+		backend& platform, const voice& vopts) {
+	std::unique_ptr<synthesizer> ret;
+	{
+		std::unique_lock lock{ _mutex };
+		ret = pop(_synthesizers, synthesizer_key(vopts));
+	}
+
+	if (ret == nullptr) {
+		return platform.make_synthesizer(vopts);
+	}
+	ret->configure(vopts);
+	return ret;
+}
+
+std::unique_ptr<audio_sink> object_pool::acquire_sink(
+		backend& platform, const voice& vopts, const voice_output& vout) {
+	std::unique_ptr<audio_sink> ret;
+	if (vout.type == output_type_e::device) {
+		std::unique_lock lock{ _mutex };
+		ret = pop(_devices, sink_key(vopts, vout));
+	}
+
+	if (ret == nullptr) {
+		return platform.make_sink(vopts, vout);
+	}
+	ret->configure(vopts);
+	return ret;
+}
+
+void object_pool::release(
+		const voice& vopts, std::unique_ptr<synthesizer>&& tts) {
+	std::unique_lock lock{ _mutex };
+	push(_synthesizers, synthesizer_key(vopts), std::move(tts));
+}
+
+void object_pool::release(const voice& vopts, const voice_output& vout,
+		std::unique_ptr<audio_sink>&& sink) {
+	if (vout.type != output_type_e::device) {
+		return;
+	}
+	std::unique_lock lock{ _mutex };
+	push(_devices, sink_key(vopts, vout), std::move(sink));
+}
+} // namespace wsay
@@ -0,0 +1,314 @@
+#include "private_include/pcm.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+
+#if defined(__AVX2__)
+#define WSAY_PCM_AVX2 1
+#endif
+
+#if defined(_M_X64) || defined(__SSE2__) \
+		|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WSAY_PCM_SSE2 1
+#endif
+
+#if defined(WSAY_PCM_SSE2) || defined(WSAY_PCM_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace wsay {
+namespace {
+// Matches the historical conversion, int max maps to 1.f.
+template <class IntT>
+inline constexpr float to_float_norm
+		= 1.f / float((std::numeric_limits<IntT>::max)());
+
+template <class IntT>
+inline constexpr float to_pcm_norm = float((std::numeric_limits<IntT>::max)());
+
+template <class IntT>
+inline constexpr float pcm_min = float((std::numeric_limits<IntT>::min)());
+
+template <class IntT>
+inline constexpr float pcm_max = float((std::numeric_limits<IntT>::max)());
+
+template <class IntT>
+void to_float_scalar(const IntT* in, float* out, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		out[i] = float(in[i]) * to_float_norm<IntT>;
+	}
+}
+
+template <class IntT>
+void to_pcm_scalar(const float* in, IntT* out, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		// Clamp before truncating, NaNs end up at min like the simd paths.
+		float s = (std::max)(pcm_min<IntT>, in[i] * to_pcm_norm<IntT>);
+		out[i] = IntT((std::min)(pcm_max<IntT>, s));
+	}
+}
+
+#if defined(WSAY_PCM_SSE2)
+template <class IntT>
+__m128i to_i32_sse2(const float* in) {
+	const __m128 norm = _mm_set1_ps(to_pcm_norm<IntT>);
+	const __m128 lo = _mm_set1_ps(pcm_min<IntT>);
+	const __m128 hi = _mm_set1_ps(pcm_max<IntT>);
+
+	__m128 s = _mm_mul_ps(_mm_loadu_ps(in), norm);
+	s = _mm_min_ps(_mm_max_ps(s, lo), hi);
+	return _mm_cvttps_epi32(s);
+}
+
+void to_float_sse2(const int16_t* in, float* out, size_t size) {
+	const __m128 norm = _mm_set1_ps(to_float_norm<int16_t>);
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		// Sign extend by unpacking into high words and shifting down.
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), norm));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), norm));
+	}
+	to_float_scalar(in + i, out + i, size - i);
+}
+
+void to_float_sse2(const int8_t* in, float* out, size_t size) {
+	const __m128 norm = _mm_set1_ps(to_float_norm<int8_t>);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m128i w[2] = {
+			_mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8),
+			_mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8),
+		};
+
+		for (size_t j = 0; j < 2; ++j) {
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(w[j], w[j]), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(w[j], w[j]), 16);
+			float* o = out + i + j * 8;
+			_mm_storeu_ps(o, _mm_mul_ps(_mm_cvtepi32_ps(lo), norm));
+			_mm_storeu_ps(o + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), norm));
+		}
+	}
+	to_float_scalar(in + i, out + i, size - i);
+}
+
+void to_pcm_sse2(const float* in, int16_t* out, size_t size) {
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		__m128i a = to_i32_sse2<int16_t>(in + i);
+		__m128i b = to_i32_sse2<int16_t>(in + i + 4);
+		_mm_storeu_si128(
+				reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(a, b));
+	}
+	to_pcm_scalar(in + i, out + i, size - i);
+}
+
+void to_pcm_sse2(const float* in, int8_t* out, size_t size) {
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i a = to_i32_sse2<int8_t>(in + i);
+		__m128i b = to_i32_sse2<int8_t>(in + i + 4);
+		__m128i c = to_i32_sse2<int8_t>(in + i + 8);
+		__m128i d = to_i32_sse2<int8_t>(in + i + 12);
+		__m128i v = _mm_packs_epi16(
+				_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+	}
+	to_pcm_scalar(in + i, out + i, size - i);
+}
+#endif
+
+#if defined(WSAY_PCM_AVX2)
+template <class IntT>
+__m256i to_i32_avx2(const float* in) {
+	const __m256 norm = _mm256_set1_ps(to_pcm_norm<IntT>);
+	const __m256 lo = _mm256_set1_ps(pcm_min<IntT>);
+	const __m256 hi = _mm256_set1_ps(pcm_max<IntT>);
+
+	__m256 s = _mm256_mul_ps(_mm256_loadu_ps(in), norm);
+	s = _mm256_min_ps(_mm256_max_ps(s, lo), hi);
+	return _mm256_cvttps_epi32(s);
+}
+
+void to_float_avx2(const int16_t* in, float* out, size_t size) {
+	const __m256 norm = _mm256_set1_ps(to_float_norm<int16_t>);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m128i b = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(in + i + 8));
+		_mm256_storeu_ps(out + i,
+				_mm256_mul_ps(
+						_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), norm));
+		_mm256_storeu_ps(out + i + 8,
+				_mm256_mul_ps(
+						_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b)), norm));
+	}
+	to_float_scalar(in + i, out + i, size - i);
+}
+
+void to_float_avx2(const int8_t* in, float* out, size_t size) {
+	const __m256 norm = _mm256_set1_ps(to_float_norm<int8_t>);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		__m256i a = _mm256_cvtepi8_epi32(v);
+		__m256i b = _mm256_cvtepi8_epi32(_mm_srli_si128(v, 8));
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(a), norm));
+		_mm256_storeu_ps(
+				out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(b), norm));
+	}
+	to_float_scalar(in + i, out + i, size - i);
+}
+
+void to_pcm_avx2(const float* in, int16_t* out, size_t size) {
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m256i a = to_i32_avx2<int16_t>(in + i);
+		__m256i b = to_i32_avx2<int16_t>(in + i + 8);
+		// Packing works per 128 bit lane, put the quads back in order.
+		__m256i v = _mm256_permute4x64_epi64(
+				_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+	}
+	to_pcm_scalar(in + i, out + i, size - i);
+}
+
+void to_pcm_avx2(const float* in, int8_t* out, size_t size) {
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i a = to_i32_avx2<int8_t>(in + i);
+		__m256i b = to_i32_avx2<int8_t>(in + i + 8);
+		__m256i c = to_i32_avx2<int8_t>(in + i + 16);
+		__m256i d = to_i32_avx2<int8_t>(in + i + 24);
+		__m256i v = _mm256_packs_epi16(
+				_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+		v = _mm256_permutevar8x32_epi32(v, order);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+	}
+	to_pcm_scalar(in + i, out + i, size - i);
+}
+#endif
+
+template <class IntT>
+void to_float(simd_e path, std::span<const IntT> in, std::span<float> out) {
+	assert(out.size() >= in.size());
+	assert(simd_available(path));
+
+	switch (path) {
+#if defined(WSAY_PCM_AVX2)
+	case simd_e::avx2: {
+		to_float_avx2(in.data(), out.data(), in.size());
+	} break;
+#endif
+#if defined(WSAY_PCM_SSE2)
+	case simd_e::sse2: {
+		to_float_sse2(in.data(), out.data(), in.size());
+	} break;
+#endif
+	default: {
+		to_float_scalar(in.data(), out.data(), in.size());
+	} break;
+	}
+}
+
+template <class IntT>
+void to_pcm(simd_e path, std::span<const float> in, std::span<IntT> out) {
+	assert(out.size() >= in.size());
+	assert(simd_available(path));
+
+	switch (path) {
+#if defined(WSAY_PCM_AVX2)
+	case simd_e::avx2: {
+		to_pcm_avx2(in.data(), out.data(), in.size());
+	} break;
+#endif
+#if defined(WSAY_PCM_SSE2)
+	case simd_e::sse2: {
+		to_pcm_sse2(in.data(), out.data(), in.size());
+	} break;
+#endif
+	default: {
+		to_pcm_scalar(in.data(), out.data(), in.size());
+	} break;
+	}
+}
+} // namespace
+
+bool simd_available(simd_e path) {
+	switch (path) {
+	case simd_e::scalar: {
+		return true;
+	} break;
+	case simd_e::sse2: {
+#if defined(WSAY_PCM_SSE2)
+		return true;
+#else
+		return false;
+#endif
+	} break;
+	case simd_e::avx2: {
+#if defined(WSAY_PCM_AVX2)
+		return true;
+#else
+		return false;
+#endif
+	} break;
+	default: {
+		assert(false);
+	} break;
+	}
+	return false;
+}
+
+simd_e simd_best() {
+#if defined(WSAY_PCM_AVX2)
+	return simd_e::avx2;
+#elif defined(WSAY_PCM_SSE2)
+	return simd_e::sse2;
+#else
+	return simd_e::scalar;
+#endif
+}
+
+void pcm_to_float(std::span<const int8_t> in, std::span<float> out) {
+	to_float(simd_best(), in, out);
+}
+void pcm_to_float(std::span<const int16_t> in, std::span<float> out) {
+	to_float(simd_best(), in, out);
+}
+void float_to_pcm(std::span<const float> in, std::span<int8_t> out) {
+	to_pcm(simd_best(), in, out);
+}
+void float_to_pcm(std::span<const float> in, std::span<int16_t> out) {
+	to_pcm(simd_best(), in, out);
+}
+
+void pcm_to_float(
+		simd_e path, std::span<const int8_t> in, std::span<float> out) {
+	to_float(path, in, out);
+}
+void pcm_to_float(
+		simd_e path, std::span<const int16_t> in, std::span<float> out) {
+	to_float(path, in, out);
+}
+void float_to_pcm(
+		simd_e path, std::span<const float> in, std::span<int8_t> out) {
+	to_pcm(path, in, out);
+}
+void float_to_pcm(
+		simd_e path, std::span<const float> in, std::span<int16_t> out) {
+	to_pcm(path, in, out);
+}
+} // namespace wsay
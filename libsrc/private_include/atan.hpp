@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <span>
+
+namespace wsay {
+// The atan implementations used by the distortion waveshaper.
+enum class atan_e : uint8_t {
+	// std::atan, reference.
+	precise,
+	// Odd polynomial, simd. Max error under 2e-6 radians.
+	poly,
+	// Lookup table with linear interpolation, scalar.
+	// Max error under 5e-7 radians.
+	table,
+	count,
+};
+
+// Polynomial atan, distort() runs a simd version of it.
+// Max error against std::atan is under 2e-6 radians, for any input.
+inline float atan_poly(float x) {
+	// Fold to [0, 1], atan(x) = pi/2 - atan(1/x) above 1.
+	const float ax = std::abs(x);
+	const float a = (std::min)(ax, 1.f) / (std::max)(ax, 1.f);
+	const float s = a * a;
+	// Horner, minimax coefficients.
+	float p = -0.01172120f;
+	p = p * s + 0.05265332f;
+	p = p * s - 0.11643287f;
+	p = p * s + 0.19354346f;
+	p = p * s - 0.33262347f;
+	p = p * s + 0.99997726f;
+	float r = a * p;
+	r = ax > 1.f ? std::numbers::pi_v<float> * 0.5f - r : r;
+	return std::copysign(r, x);
+}
+
+// Table based atan, max error under 5e-7 radians.
+extern float atan_table(float x);
+
+// The distortion waveshaper, in place.
+// s = atan(drive * s) * norm * atten
+extern void distort(atan_e path, float drive, float norm, float atten,
+		std::span<float> block);
+} // namespace wsay
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include "wsay/engine.hpp"
+#include "wsay/voice.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace wsay {
+// Final pcm of an utterance, or of a piece of it. Immutable, shared by every
+// output, the render cache and whoever plays it.
+using shared_pcm = std::shared_ptr<const std::vector<std::byte>>;
+
+// Receives pcm as it is synthesized. Returns false to stop synthesis.
+using pcm_callback_t = std::function<bool(std::span<const std::byte>)>;
+
+// Turns text into pcm, in the vopts format.
+struct synthesizer {
+	virtual ~synthesizer() = default;
+
+	// Synthesizes formatted text (with speech xml, if vopts allow it).
+	// Calls on_pcm with consecutive pieces of audio as they are produced,
+	// maybe from a backend thread. Blocking, returns after the last piece,
+	// or soon after on_pcm returns false.
+	virtual void synthesize(
+			const std::wstring& text, const pcm_callback_t& on_pcm)
+			= 0;
+
+	// Interrupts synthesis, from any thread. Doesn't wait.
+	virtual void stop() = 0;
+
+	// Applies the vopts volume, speed and xml options, to reuse the
+	// synthesizer. Its voice and audio format don't change.
+	virtual void configure(const voice& vopts) = 0;
+};
+
+// Plays or saves processed pcm, at fx_output_rate().
+struct audio_sink {
+	virtual ~audio_sink() = default;
+
+	// Queues pcm behind what is playing, or interrupts it first when purge
+	// is set. Devices play it asynchronously, reading the shared buffer
+	// rather than copying it.
+	virtual void play(const shared_pcm& pcm, bool purge) = 0;
+
+	// Blocks until everything queued is played.
+	virtual void wait() = 0;
+
+	// Interrupts playback and drops the queue, doesn't wait. Can be called
+	// while another thread plays or waits. Files keep what was written.
+	// Stopped files ignore plays until the next reset.
+	virtual void stop() = 0;
+
+	// Readies a stopped sink for the next utterance. Not called while
+	// playing or stopping.
+	virtual void reset() = 0;
+
+	// Plays pcm in the vopts effects format from now on, to reuse the
+	// device. Files keep their format.
+	virtual void configure(const voice& vopts) = 0;
+};
+
+// Lists voices and devices, creates synthesizers and sinks for them.
+// Thread safe.
+struct backend {
+	virtual ~backend() = default;
+
+	// Remembers voice and device names in a file at path, to skip
+	// enumerating them on the next runs. Empty disables it.
+	// Call before anything else.
+	virtual void snapshot_path(const std::filesystem::path& path) = 0;
+
+	// Enumerated on first use.
+	virtual const std::vector<std::wstring>& voices() = 0;
+	virtual const std::vector<std::wstring>& devices() = 0;
+
+	// The system playback device, used when a voice has no outputs.
+	virtual size_t default_device_idx() = 0;
+
+	virtual std::unique_ptr<synthesizer> make_synthesizer(const voice& vopts)
+			= 0;
+	virtual std::unique_ptr<audio_sink> make_sink(
+			const voice& vopts, const voice_output& vout)
+			= 0;
+};
+
+#if defined(_WIN32)
+// SAPI voices, audio devices and file output.
+extern std::unique_ptr<backend> make_sapi_backend();
+#endif
+
+// Tone generator voices, silent devices and wav files.
+extern std::unique_ptr<backend> make_headless_backend(
+		const headless_options& opts);
+} // namespace wsay
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include "private_include/pcm.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace wsay {
+enum class biquad_type_e : uint8_t {
+	lowpass,
+	highpass,
+	bandbass,
+	notch,
+	peaking,
+	lowshelf,
+	highshelf,
+	count,
+};
+
+struct biquad_args {
+	biquad_type_e type = biquad_type_e::count;
+	// Normalized frequency, freq / sampling rate.
+	float freq = 0.5f;
+	// Ignored by shelves.
+	float q = 0.707f;
+	// In dB, peaking and shelves only.
+	float gain = 0.f;
+};
+
+struct biquad_coefs {
+	float a0 = 1.f;
+	float a1 = 0.f;
+	float a2 = 0.f;
+	float b1 = 0.f;
+	float b2 = 0.f;
+};
+
+struct biquad_state {
+	float z1 = 0.f;
+	float z2 = 0.f;
+};
+
+// https://www.earlevel.com/main/2012/11/26/biquad-c-source-code/
+extern biquad_coefs make_biquad_coefs(const biquad_args& args);
+
+// A single transposed direct form II section, in place.
+extern void biquad(
+		const biquad_coefs& c, biquad_state& state, std::span<float> block);
+
+inline constexpr size_t biquad_max_sections = 8;
+
+// A cascade of biquad sections, processed in order, in place.
+// Keeps its state, so blocks can be fed in consecutive chunks.
+// With simd, sections run in groups of 4 lanes. Each lane is a section
+// working a few samples behind the previous one, so a group costs about
+// as much as a single scalar section. Output is identical to running the
+// sections one after the other.
+struct biquad_cascade {
+	biquad_cascade() = default;
+	// Sections of type count are skipped.
+	explicit biquad_cascade(std::span<const biquad_args> sections);
+
+	// Number of active sections.
+	size_t size() const;
+	bool empty() const;
+
+	void process(std::span<float> block);
+
+	// Same as above, using a specific path. Used for benchmarking and
+	// testing. The path must be available, avx2 runs the sse2 path.
+	void process(simd_e path, std::span<float> block);
+
+private:
+	static constexpr size_t lanes = 4;
+
+	// Struct of arrays, one section per lane.
+	// Unused lanes are pass-throughs.
+	struct group {
+		alignas(16) std::array<float, lanes> a0{ 1.f, 1.f, 1.f, 1.f };
+		alignas(16) std::array<float, lanes> a1{};
+		alignas(16) std::array<float, lanes> a2{};
+		alignas(16) std::array<float, lanes> b1{};
+		alignas(16) std::array<float, lanes> b2{};
+		alignas(16) std::array<float, lanes> z1{};
+		alignas(16) std::array<float, lanes> z2{};
+		size_t size = 0;
+	};
+
+	std::array<group, biquad_max_sections / lanes> _groups;
+	size_t _size = 0;
+};
+} // namespace wsay
@@ -44,7 +44,11 @@ extern CComModule _Module;
 #include <sphelper.h>
 #pragma warning(pop)
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -52,20 +56,61 @@ extern CComModule _Module;
 #include <wil/result.h>
 
 namespace wsay {
+// Hands what is written to a callback instead of storing it. The tts voice
+// writes to it as it synthesizes, from a SAPI thread.
+class ATL_NO_VTABLE write_through_stream
+		: public CComObjectRootEx<CComMultiThreadModel>
+		, public IStream {
+public:
+	BEGIN_COM_MAP(write_through_stream)
+	COM_INTERFACE_ENTRY(IStream)
+	COM_INTERFACE_ENTRY(ISequentialStream)
+	END_COM_MAP()
+
+	// Forwards writes to on_write, until the next reset. Writes fail
+	// without a callback, or once it returns false. on_write must outlive
+	// the writes.
+	void reset(const std::function<bool(std::span<const std::byte>)>* on_write);
+
+	// on_write returned false since the last reset.
+	bool aborted() const;
+
+	// ISequentialStream
+	STDMETHODIMP Read(void* pv, ULONG cb, ULONG* read) override;
+	STDMETHODIMP Write(const void* pv, ULONG cb, ULONG* written) override;
+
+	// IStream, only the write position can be queried.
+	STDMETHODIMP Seek(LARGE_INTEGER move, DWORD origin,
+			ULARGE_INTEGER* new_pos) override;
+	STDMETHODIMP SetSize(ULARGE_INTEGER size) override;
+	STDMETHODIMP CopyTo(IStream* stream, ULARGE_INTEGER cb,
+			ULARGE_INTEGER* read, ULARGE_INTEGER* written) override;
+	STDMETHODIMP Commit(DWORD flags) override;
+	STDMETHODIMP Revert() override;
+	STDMETHODIMP LockRegion(
+			ULARGE_INTEGER offset, ULARGE_INTEGER cb, DWORD type) override;
+	STDMETHODIMP UnlockRegion(
+			ULARGE_INTEGER offset, ULARGE_INTEGER cb, DWORD type) override;
+	STDMETHODIMP Stat(STATSTG* stats, DWORD flags) override;
+	STDMETHODIMP Clone(IStream** stream) override;
+
+private:
+	const std::function<bool(std::span<const std::byte>)>* _on_write
+			= nullptr;
+	std::atomic<bool> _aborted = false;
+	// Bytes written since the reset.
+	uint64_t _position = 0;
+};
+
 struct tts_voice {
 	auto* operator->() {
 		return voice.operator->();
 	}
 
-	// Format speak sentence according to input vopts.
-	std::wstring format_sentence(const std::wstring& in) const;
-
 	// Option flags.
 	unsigned long flags = 0;
-	// String processing, if applicable.
-	std::vector<std::function<void(std::wstring&)>> text_modifiers{};
-	// Our backing data stream (bytes).
-	CComPtr<IStream> data_stream{};
+	// Our backing data stream, forwards the pcm as it is synthesized.
+	CComPtr<write_through_stream> data_stream{};
 	// Points to data stream.
 	CComPtr<ISpStream> sp_stream{};
 	// The initialized voice.
@@ -77,10 +122,8 @@ struct device_output {
 		return voice.operator->();
 	}
 
-	// Clone of tts_voice data_stream.
-	CComPtr<IStream> data_stream_clone{};
-	// Clone of tts_voice sp_stream.
-	CComPtr<ISpStream> sp_stream_clone{};
+	// The pcm being played.
+	CComPtr<ISpStream> sp_stream{};
 	// The file output stream.
 	CComPtr<ISpStream> file_stream{};
 	// The audio output format.
@@ -94,6 +137,15 @@ extern SPSTREAMFORMAT to_spstreamformat(compression_e compression,
 		bit_depth_e bit_depth, sampling_rate_e sampling_rate);
 extern SPSTREAMFORMAT to_spstreamformat(const voice& vopts);
 
+// The tts stream format, once effects are applied.
+extern SPSTREAMFORMAT to_fx_spstreamformat(const voice& vopts);
+
+// Creates an empty in memory stream.
+extern CComPtr<IStream> make_data_stream();
+
+// Creates a write_through_stream, without a callback.
+extern CComPtr<write_through_stream> make_write_through_stream();
+
 // Creates all voice tokens found on PC.
 extern std::vector<CComPtr<ISpObjectToken>> make_voice_tokens();
 
@@ -104,13 +156,49 @@ extern std::vector<CComPtr<ISpObjectToken>> make_device_tokens();
 extern std::vector<std::wstring> make_names(
 		const std::vector<CComPtr<ISpObjectToken>>& ptrs);
 
-// Creates a tts_voice according to vopts options.
-extern tts_voice make_tts_voice(const voice& vopts,
-		const std::vector<CComPtr<ISpObjectToken>>& voice_tokens);
+// Creates a matching list of ids for given tokens.
+extern std::vector<std::wstring> make_ids(
+		const std::vector<CComPtr<ISpObjectToken>>& ptrs);
+
+// Creates a single token from its id, without enumerating its category.
+// Returns null if it doesn't exist anymore.
+extern CComPtr<ISpObjectToken> make_token(const std::wstring& id);
+
+// Cheap fingerprint of the installed voices and active devices, changes
+// when they are added or removed. Renaming doesn't change it.
+extern std::wstring enumeration_signature();
+
+// Creates a tts_voice according to vopts options, speaking with voice_token.
+extern tts_voice make_tts_voice(
+		const voice& vopts, ISpObjectToken* voice_token);
+
+// Applies the vopts volume, rate and xml options to an existing tts_voice.
+extern void configure_tts_voice(const voice& vopts, tts_voice& tts);
+
+// Creates the audio out of a device, to write pcm to directly.
+extern CComPtr<ISpMMSysAudio> make_audio_out(ISpObjectToken* device_token);
+
+// Closes the audio out, sets its format and starts it again.
+// Queued audio is dropped.
+extern void set_audio_format(ISpMMSysAudio* audio, SPSTREAMFORMAT format);
+
+// Drops the audio queued on the device.
+extern void purge_audio(ISpMMSysAudio* audio);
+
+// Queues pcm on the device, blocks while its buffer is full.
+extern void write_audio(ISpMMSysAudio* audio, std::span<const std::byte> pcm);
+
+// Everything written to the device was played.
+extern bool audio_drained(ISpMMSysAudio* audio);
+
+// Processed pcm is in the format files are saved in, it can be written as
+// is rather than converted by a voice.
+extern bool is_file_format(const voice& vopts);
 
 // Creates a device_out according to vout options.
-extern device_output make_device_output(const voice_output& vout,
-		const std::vector<CComPtr<ISpObjectToken>>& device_tokens);
+// device_token is the vout device, null for files.
+extern device_output make_device_output(const voice& vopts,
+		const voice_output& vout, ISpObjectToken* device_token);
 
 // Creates everything needed for speaking.
 extern void make_everything(
@@ -119,10 +207,14 @@ extern void make_everything(
 		const std::vector<std::wstring>& device_names, const voice& vopts,
 		tts_voice& tts, std::vector<device_output>& device_outputs);
 
-// Clones input tts stream into device output streams.
-// Clones have same bytes but independent playhead.
-extern void clone_input_stream(
-		const tts_voice& tts, std::vector<device_output>& device_outputs);
+// Copies processed pcm to a stream output voices can play.
+// Uses the effects output format.
+extern CComPtr<ISpStream> make_pcm_stream(
+		const voice& vopts, std::span<const std::byte> pcm);
+
+// Returns the system playback device endpoint id, empty on failure.
+// Cheaper than matching it to a device name.
+extern std::wstring default_output_device_id();
 
 // Given a list of devices, returns the user selected output device if possible.
 // Returns 0 if it can't figure it out.
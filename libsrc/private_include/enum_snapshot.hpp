@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wsay {
+// Voice and device names saved between runs, so startup can skip
+// enumerating them.
+struct enum_snapshot {
+	// Identifies the installed voices and devices when the snapshot was
+	// taken. It is stale once they change.
+	std::wstring signature;
+
+	// Token ids recreate a single token without enumerating.
+	std::vector<std::wstring> voice_ids;
+	std::vector<std::wstring> voice_names;
+	std::vector<std::wstring> device_ids;
+	std::vector<std::wstring> device_names;
+
+	// The last system playback device seen, and its index.
+	std::wstring default_device_id;
+	size_t default_device_idx = 0;
+};
+
+// Reads the snapshot saved at path.
+// Returns nothing if it is missing, corrupt or its signature differs.
+extern std::optional<enum_snapshot> load_enum_snapshot(
+		const std::filesystem::path& path, std::wstring_view signature);
+
+// Saves the snapshot to path, replacing it whole so concurrent runs never
+// read a partial file. Returns false on failure, the snapshot is only an
+// optimization.
+extern bool save_enum_snapshot(
+		const std::filesystem::path& path, const enum_snapshot& snap);
+} // namespace wsay
@@ -29,129 +29,52 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #pragma once
-#include "private_include/com.hpp"
+#include "private_include/fx_chain.hpp"
 #include "wsay/voice.hpp"
 
-#include <fea/enum/enum_array.hpp>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <variant>
 #include <vector>
-#include <wil/resource.h>
-#include <wil/result.h>
 
 namespace wsay {
-enum class biquad_type_e : uint8_t {
-	lowpass,
-	highpass,
-	bandbass,
-	notch,
-	count,
+// Scratch buffers, reused between calls to minimize allocations.
+// They only ever grow to a chunk.
+struct fx_buffers {
+	std::vector<float> in_samples;
+	std::vector<float> out_samples;
 };
 
-struct biquad_args {
-	biquad_type_e type = biquad_type_e::count;
-	float freq = 0.5f;
-	float q = 0.707f;
-	// float gain = 0.f;
-};
+// Processes pcm according to the vopts options.
+// Works in chunks and writes the result back in place. Native rate effects
+// shrink pcm. Long renders use up to max_threads.
+// Stops between chunks once cancel is set, pcm is then partly processed.
+extern void process_fx(const voice& vopts, std::vector<std::byte>& pcm,
+		fx_buffers& buffers,
+		size_t max_threads = (std::numeric_limits<size_t>::max)(),
+		const std::atomic<bool>* cancel = nullptr);
 
-struct fx_args {
-	size_t bit_depth;
-	sampling_rate_e sampling_rate;
-	float dist_drive;
-	float noise_vol;
-	bool noise_after_bitcrush;
-	biquad_args biquad;
-	float gain;
-};
+// Applies effects to consecutive pieces of pcm, as one continuous render.
+// Noise, filters and resamplers carry over from one piece to the next, the
+// resampler delay spills into the next piece's output.
+struct fx_stream {
+	explicit fx_stream(const voice& vopts);
 
-inline constexpr fea::enum_array<fx_args, radio_preset_e> radio_presets{
-	// radio 1
-	fx_args{
-			.bit_depth = 5,
-			.sampling_rate = sampling_rate_e::_8,
-			.dist_drive = 0.2f,
-			.noise_vol = 0.00001f,
-			.noise_after_bitcrush = false,
-			.biquad = biquad_args{
-				.type = biquad_type_e::bandbass,
-				.freq = 0.2f,
-			},
-			.gain = 1.3f,
-	},
-	// radio 2
-	fx_args{
-			.bit_depth = 6,
-			.sampling_rate = sampling_rate_e::_8,
-			.dist_drive = 0.f,
-			.noise_vol = 0.01f,
-			.noise_after_bitcrush = false,
-			.biquad = biquad_args{
-				.type = biquad_type_e::highpass,
-				.freq = 0.1f,
-				.q = 1.f,
-			},
-			.gain = 1.3f,
-	},
-	// radio 3
-	fx_args{
-			.bit_depth = 16,
-			.sampling_rate = sampling_rate_e::_44,
-			.dist_drive = 1.f,
-			.noise_vol = 0.01f,
-			.noise_after_bitcrush = false,
-			.biquad = biquad_args{
-				.type = biquad_type_e::bandbass,
-				.freq = 0.05f,
-				.q = 1.f,
-			},
-			.gain = 2.f,
-	},
-	// radio 4
-	fx_args{
-			.bit_depth = 16,
-			.sampling_rate = sampling_rate_e::_22,
-			.dist_drive = 0.9f,
-			.noise_vol = 0.001f,
-			.noise_after_bitcrush = false,
-			.biquad = biquad_args{
-				.type = biquad_type_e::lowpass,
-				.freq = 0.05f,
-				.q = 2.f,
-			},
-			.gain = 1.f,
-	},
-	// radio 5
-	fx_args{
-			.bit_depth = 3,
-			.sampling_rate = sampling_rate_e::_8,
-			.dist_drive = 0.f,
-			.noise_vol = 0.1f,
-			.noise_after_bitcrush = true,
-			.biquad = biquad_args{
-				.type = biquad_type_e::notch,
-				.freq = 0.02f,
-				.q = 0.5f,
-			},
-			.gain = 0.7f,
-	},
-	// radio 6
-	fx_args{
-			.bit_depth = 4,
-			.sampling_rate = sampling_rate_e::_44,
-			.dist_drive = 0.f,
-			.noise_vol = 0.f,
-			.noise_after_bitcrush = true,
-			.biquad = biquad_args{
-				.type = biquad_type_e::bandbass,
-				.freq = 0.04f,
-				.q = 0.5f,
-			},
-			.gain = 1.f,
-	},
-};
+	// Appends the processed in to out.
+	// Set last on the final piece, flushes the effects.
+	void process(std::span<const std::byte> in, bool last,
+			std::vector<std::byte>& out);
 
+private:
+	template <class IntT>
+	void process_pcm(std::span<const std::byte> in, bool last,
+			std::vector<std::byte>& out);
 
-// Processes audio according to the vopts options.
-// Provide byte and sample buffers, they will be reused to minimize allocations.
-extern void process_fx(const voice& vopts, CComPtr<IStream>& stream,
-		std::vector<std::byte>& byte_buffer, std::vector<float>& sample_buffer);
-} // namespace wsay
\ No newline at end of file
+	bit_depth_e _bit_depth = bit_depth_e::count;
+	// Empty without effects, pcm is copied as is.
+	std::variant<std::monostate, fx_engine, fx_fixed_engine> _engine;
+	fx_buffers _buffers;
+};
+} // namespace wsay
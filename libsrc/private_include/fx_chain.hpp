@@ -0,0 +1,296 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include "private_include/atan.hpp"
+#include "private_include/biquad.hpp"
+#include "private_include/fx_presets.hpp"
+#include "private_include/noise.hpp"
+#include "private_include/resample.hpp"
+#include "wsay/voice.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace wsay {
+struct fx_state;
+
+// A runtime preset stage.
+// Processes a whole block per call, the kernels are the same ones the
+// builtin presets use.
+struct fx_stage {
+	void (*process)(const fx_stage&, fx_state&, std::span<float>) = nullptr;
+	std::array<float, 3> params{};
+};
+
+// Effect state carried from one chunk to the next.
+struct fx_state {
+	radio_preset_e preset = radio_preset_e::count;
+	bool disable_whitenoise = false;
+	float global_vol = 1.f;
+	// The distortion atan.
+	atan_e atan = atan_e::poly;
+	biquad_cascade eq;
+	noise_gen noise;
+	// Runtime presets only, supersedes preset if not empty.
+	std::vector<fx_stage> stages;
+};
+
+// Streaming radio effect.
+// Feed consecutive chunks of samples at vopts.sampling_rate(), then flush.
+// Output is identical whatever the chunk sizes, memory is bounded by the
+// chunk size. Engines share no mutable state, separate engines may run on
+// separate threads.
+struct fx_engine {
+	// Uses the vopts builtin preset, or loads its preset file.
+	explicit fx_engine(const voice& vopts);
+
+	// Uses a runtime preset, vopts radio effect is ignored.
+	fx_engine(const voice& vopts, const fx_args& args);
+
+	// Processes in, appends the processed samples to out.
+	// Output lags the input by the resampler delay.
+	void process(std::span<const float> in, std::vector<float>& out);
+
+	// Starts this engine at input sample in_offset of a longer render, for
+	// splitting renders. Noise picks up where the full render would be,
+	// filters start empty and need warming up. Call before processing,
+	// in_offset must be a multiple of segment_alignment().
+	void start_at(size_t in_offset);
+
+	// Input offsets that land on whole samples at every rate.
+	size_t segment_alignment() const;
+
+	// Selects the distortion atan, atan_e::poly by default.
+	// Used for benchmarking and testing.
+	void distortion_atan(atan_e path);
+
+	// Call once after the last chunk, appends the remaining samples.
+	// In total, outputs as many samples as were input (or the equivalent at
+	// fx_output_rate()).
+	void flush(std::vector<float>& out);
+
+private:
+	// Sets up the resamplers once the preset rate is known.
+	void init_rates();
+
+	// Drops the resampler delay and appends s to out, up to the limit.
+	void emit(std::span<const float> s, std::vector<float>& out);
+
+	fx_state _state;
+	size_t _in_rate = 0;
+	size_t _fx_rate = 0;
+	bool _native_rate = false;
+
+	resampler _decimator;
+	resampler _interpolator;
+	// Scratch, for samples at the preset rate.
+	std::vector<float> _low;
+	// Scratch, for interpolated samples.
+	std::vector<float> _high;
+
+	size_t _in_count = 0;
+	size_t _out_count = 0;
+	size_t _out_limit = (std::numeric_limits<size_t>::max)();
+	// Output samples left to drop.
+	size_t _skip = 0;
+};
+
+// Splits a render over threads, same interface as fx_engine.
+// Input is cut in fixed size segments, each one rendered by its own engine.
+// Engines start early to warm up their filters and read ahead to fill their
+// resamplers. Resampling, noise and waveshaping match the serial render
+// exactly, the biquads converge to within 1e-6 of it.
+// Segments don't depend on the thread count, neither does the output.
+// Buffers num_threads segments of input.
+struct fx_parallel {
+	fx_parallel(const voice& vopts, size_t num_threads);
+
+	// Processes in, appends the processed samples to out.
+	void process(std::span<const float> in, std::vector<float>& out);
+
+	// Call once after the last chunk, appends the remaining samples.
+	void flush(std::vector<float>& out);
+
+private:
+	// Renders input [_next, end) and appends it to out.
+	void render(size_t end, bool last, std::vector<float>& out);
+
+	// The output sample matching an aligned input sample.
+	size_t out_index(size_t in_idx) const;
+
+	fx_engine _proto;
+	size_t _num_threads = 1;
+	size_t _in_rate = 0;
+	size_t _out_rate = 0;
+	// Input samples, all multiples of the segment alignment.
+	size_t _segment_size = 0;
+	size_t _warmup = 0;
+	size_t _lookahead = 0;
+
+	// Buffered input, _in[0] is input sample _in_offset.
+	std::vector<float> _in;
+	size_t _in_offset = 0;
+	// Next input sample to render.
+	size_t _next = 0;
+	// Per segment scratch.
+	std::vector<std::vector<float>> _seg_out;
+};
+
+// A fixed-point biquad section, direct form I.
+struct fixed_biquad {
+	// Extra output bits carried by the recursion.
+	static constexpr int extra = 8;
+
+	// Coefficients scaled by 2^shift.
+	int32_t a0 = 0;
+	int32_t a1 = 0;
+	int32_t a2 = 0;
+	int32_t b1 = 0;
+	int32_t b2 = 0;
+	int shift = 0;
+	// The recursion could overflow, saturate it.
+	bool clamp = true;
+
+	int32_t x1 = 0;
+	int32_t x2 = 0;
+	// Outputs, with the extra bits.
+	int64_t y1 = 0;
+	int64_t y2 = 0;
+	// Rounding error fed back into the next sample.
+	int64_t err = 0;
+};
+
+// Fixed-point radio effect, runs on 8 or 16 bit pcm in place.
+// Same chain as fx_engine, without float buffers. Samples are Q15 between
+// stages, resampling uses Q14 coefficients.
+//
+// Accuracy against fx_engine, 16 bit speech like input, 5 seconds per
+// preset at 44.1kHz and at the preset rate, with and without noise:
+// - Noise is the same sequence, bit crushing and waveshaping are exact to
+//   rounding. Without resampling or noise, output is within 4 LSB, error
+//   under -89 dBFS rms.
+// - Resampling and the noise mix are within a few LSB, distortion amplifies
+//   that to 20 LSB (radio 4). Error stays under -80 dBFS rms.
+// - Those LSB also move samples across bit crush thresholds. Presets
+//   crushing to 6 bits or less (radio 1, 2, 5 and 6) then have up to 8% of
+//   samples a crush step or two apart, error under -36 dBFS rms.
+// - 8 bit output is within 1 LSB, or -30 dBFS rms across crush steps.
+// tests/fx.cpp checks these bounds.
+struct fx_fixed_engine {
+	// Uses the vopts builtin preset, or loads its preset file.
+	explicit fx_fixed_engine(const voice& vopts);
+
+	// Uses a runtime preset, vopts radio effect is ignored.
+	fx_fixed_engine(const voice& vopts, const fx_args& args);
+
+	// Processes samples in place, at vopts.sampling_rate().
+	// Returns how many processed samples were written to the front of
+	// samples, output that doesn't fit is kept for the next call.
+	size_t process(std::span<int16_t> samples);
+	size_t process(std::span<int8_t> samples);
+
+	// Call once after the last chunk, appends the remaining samples.
+	// In total, outputs as many samples as fx_engine.
+	void flush(std::vector<int16_t>& out);
+	void flush(std::vector<int8_t>& out);
+
+private:
+	template <class IntT>
+	size_t process_pcm(std::span<IntT> samples);
+
+	template <class IntT>
+	void flush_pcm(std::vector<IntT>& out);
+
+	// Runs the preset chain on samples at the preset rate.
+	void process_chain(std::span<int32_t> block);
+	void process_chain(std::vector<int16_t>& samples);
+
+	// Drops the resampler delay and queues s, up to the limit.
+	void emit(std::span<const int16_t> s);
+
+	noise_gen _noise;
+	// Q47 noise mix, zero amplitude disables the stage.
+	int64_t _noise_dry = 0;
+	int64_t _noise_amplitude = 0;
+	bool _noise_after_bitcrush = false;
+	// Bit crush, zero bit_mul disables the stage.
+	int64_t _crush_mul = 0;
+	int64_t _crush_step = 0;
+	// Waveshaper over the whole int16 range, empty without distortion.
+	std::vector<int16_t> _shaper;
+	std::array<fixed_biquad, biquad_max_sections> _eq{};
+	size_t _eq_size = 0;
+	// Q16, zero disables the stage.
+	int64_t _gain = 0;
+
+	size_t _in_rate = 0;
+	size_t _fx_rate = 0;
+	bool _native_rate = false;
+	resampler_q15 _decimator;
+	resampler_q15 _interpolator;
+	// Scratch, for widened 8 bit input.
+	std::vector<int16_t> _wide;
+	// Scratch, for samples at the preset rate.
+	std::vector<int16_t> _low;
+	// Scratch, for interpolated samples.
+	std::vector<int16_t> _high;
+	// Processed output waiting for room.
+	std::vector<int16_t> _pending;
+
+	size_t _in_count = 0;
+	size_t _out_count = 0;
+	size_t _out_limit = (std::numeric_limits<size_t>::max)();
+	// Output samples left to drop.
+	size_t _skip = 0;
+};
+
+// Threads worth using to render num_samples, 1 for short renders.
+extern size_t fx_thread_count(const voice& vopts, size_t num_samples);
+
+// The sampling rate process_fx outputs at.
+// Either vopts.sampling_rate(), or the preset rate when
+// voice::radio_effect_native_rate is set.
+extern sampling_rate_e fx_output_rate(const voice& vopts);
+
+// Applies the vopts radio effect to normalized float samples, in place.
+// Samples are expected at vopts.sampling_rate(). Presets running at a lower
+// rate decimate, process and interpolate back, or resize samples to
+// fx_output_rate() in native rate mode.
+extern void process_fx(const voice& vopts, std::vector<float>& samples);
+
+// Same as above, split over num_threads with fx_parallel.
+extern void process_fx(
+		const voice& vopts, std::vector<float>& samples, size_t num_threads);
+} // namespace wsay
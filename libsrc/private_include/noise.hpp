@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace wsay {
+// Fast uniform white noise.
+// Runs independent xorshift32 generators in lanes, so filling a block
+// vectorizes. Sample n always comes from lane n % lanes, the noise doesn't
+// depend on how fills are split. Cheap to create, use one per render.
+// Not thread-safe.
+struct noise_gen {
+	static constexpr size_t lanes = 8;
+
+	// Seeds from std::random_device.
+	noise_gen();
+
+	// Same seed, same noise.
+	explicit noise_gen(uint64_t seed);
+
+	// Fills out with uniform noise in [-amplitude, amplitude).
+	void fill(std::span<float> out, float amplitude);
+
+	// Fills out with uniform noise over the whole int32 range. Same sequence
+	// as above, for fixed-point.
+	void fill(std::span<int32_t> out);
+
+	// Skips n samples, as if filling them. Jumps ahead in O(log n).
+	void discard(uint64_t n);
+
+private:
+	// Steps the lanes, convert maps each new state to a sample.
+	template <class T, class Func>
+	void fill_lanes(std::span<T> out, Func&& convert);
+
+	std::array<uint32_t, lanes> _state;
+	// Lane of the next sample.
+	size_t _lane = 0;
+};
+} // namespace wsay
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include "private_include/backend.hpp"
+#include "wsay/voice.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace wsay {
+// Synthesizers made with the same key can be reconfigured for one another.
+extern uint64_t synthesizer_key(const voice& vopts);
+
+// Idle synthesizers and device sinks, reused by later speak calls.
+// Creating them is most of the setup cost of short utterances with SAPI.
+// Synthesizers are keyed by voice and audio format, devices by index and
+// compression. Other options are reconfigured. Files are never pooled.
+// Thread safe.
+struct object_pool {
+	// Returns an idle synthesizer configured for vopts, or a new one.
+	std::unique_ptr<synthesizer> acquire_synthesizer(
+			backend& platform, const voice& vopts);
+
+	// Returns an idle device configured for vopts, or a new sink.
+	std::unique_ptr<audio_sink> acquire_sink(
+			backend& platform, const voice& vopts, const voice_output& vout);
+
+	// Keeps a synthesizer made for vopts, once done with it.
+	void release(const voice& vopts, std::unique_ptr<synthesizer>&& tts);
+
+	// Keeps a device, once it is done playing. Drops files.
+	void release(const voice& vopts, const voice_output& vout,
+			std::unique_ptr<audio_sink>&& sink);
+
+private:
+	std::mutex _mutex;
+	std::unordered_map<uint64_t, std::vector<std::unique_ptr<synthesizer>>>
+			_synthesizers;
+	std::unordered_map<uint64_t, std::vector<std::unique_ptr<audio_sink>>>
+			_devices;
+};
+} // namespace wsay
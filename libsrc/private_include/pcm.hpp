@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <cstdint>
+#include <span>
+
+namespace wsay {
+// The conversion paths compiled in this binary.
+// avx2 requires building with /arch:AVX2 (or -mavx2).
+enum class simd_e : uint8_t {
+	scalar,
+	sse2,
+	avx2,
+	count,
+};
+
+// Is the simd path compiled in?
+extern bool simd_available(simd_e path);
+
+// Returns the widest compiled simd path.
+extern simd_e simd_best();
+
+// Converts integer pcm to normalized float samples, [-1, 1].
+// Output must be at least as big as input.
+extern void pcm_to_float(std::span<const int8_t> in, std::span<float> out);
+extern void pcm_to_float(std::span<const int16_t> in, std::span<float> out);
+
+// Converts normalized float samples back to integer pcm.
+// Out of range samples are saturated, not wrapped.
+// Output must be at least as big as input.
+extern void float_to_pcm(std::span<const float> in, std::span<int8_t> out);
+extern void float_to_pcm(std::span<const float> in, std::span<int16_t> out);
+
+// Same as above, using a specific path. Used for benchmarking and testing.
+// The path must be available.
+extern void pcm_to_float(
+		simd_e path, std::span<const int8_t> in, std::span<float> out);
+extern void pcm_to_float(
+		simd_e path, std::span<const int16_t> in, std::span<float> out);
+extern void float_to_pcm(
+		simd_e path, std::span<const float> in, std::span<int8_t> out);
+extern void float_to_pcm(
+		simd_e path, std::span<const float> in, std::span<int16_t> out);
+} // namespace wsay
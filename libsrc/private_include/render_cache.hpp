@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include "private_include/backend.hpp"
+#include "wsay/engine.hpp"
+#include "wsay/voice.hpp"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace wsay {
+// Least recently used cache of rendered utterances, bounded in bytes.
+// Keyed by the text and every voice option that changes the audio.
+// Thread safe.
+struct render_cache {
+	// Evicts the oldest renders until they fit. 0 disables the cache.
+	void budget(size_t bytes);
+	size_t budget() const;
+
+	// Returns the pcm rendered for text, or null.
+	// Counts hits and misses while enabled.
+	shared_pcm find(const voice& vopts, std::wstring_view text);
+
+	// Stores the pcm rendered for text, if it fits the budget.
+	void insert(const voice& vopts, std::wstring_view text, shared_pcm pcm);
+	void insert(const voice& vopts, std::wstring_view text,
+			std::vector<std::byte>&& pcm);
+
+	// Drops all renders, keeps the counters.
+	void clear();
+
+	render_cache_stats stats() const;
+
+private:
+	struct entry {
+		std::wstring key;
+		shared_pcm pcm;
+	};
+
+	// Must hold the mutex.
+	void evict(size_t bytes);
+
+	mutable std::mutex _mutex;
+	size_t _budget = 0;
+	size_t _bytes = 0;
+	size_t _hits = 0;
+	size_t _misses = 0;
+
+	// Most recently used first.
+	std::list<entry> _entries;
+	// Views the entry keys.
+	std::unordered_map<std::wstring_view, std::list<entry>::iterator> _lookup;
+};
+} // namespace wsay
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace wsay {
+// Rational polyphase resampler, windowed sinc low-pass at the lower nyquist.
+// Keeps its history, so input can be fed in consecutive chunks.
+// T is float, or int16_t for Q15 samples. The Q15 resampler uses Q14
+// coefficients and saturates its output.
+template <class T>
+struct basic_resampler {
+	basic_resampler() = default;
+	basic_resampler(size_t in_rate, size_t out_rate);
+
+	// Resamples in, appends the produced samples to out.
+	void process(std::span<const T> in, std::vector<T>& out);
+
+	// Pushes silence through the filter, appends the tail to out.
+	void flush(std::vector<T>& out);
+
+	// The filter group delay, in output samples.
+	double delay() const;
+
+private:
+	size_t _up = 1;
+	size_t _down = 1;
+	size_t _taps = 0;
+	// Half filter length, in upsampled samples.
+	size_t _center = 0;
+	// Next output position, in upsampled samples, relative to the chunk.
+	size_t _t = 0;
+	// Polyphase coefficients, phase major, taps reversed.
+	std::vector<T> _coefs;
+	// History followed by the current chunk.
+	std::vector<T> _work;
+};
+
+extern template struct basic_resampler<float>;
+extern template struct basic_resampler<int16_t>;
+
+using resampler = basic_resampler<float>;
+using resampler_q15 = basic_resampler<int16_t>;
+} // namespace wsay
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include "wsay/engine.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace wsay {
+// Pending utterances of an async token, bounded, by priority.
+// Not thread safe, the token guards it.
+struct speech_queue {
+	struct item {
+		std::wstring text;
+		speak_priority_e priority = speak_priority_e::normal;
+		std::chrono::steady_clock::time_point enqueued{};
+		// Told when it is done, or dropped.
+		speak_callback_t on_done;
+	};
+
+	speech_queue() = default;
+	explicit speech_queue(size_t capacity);
+
+	// Applies the policy and queues the item. A full queue drops its oldest
+	// item of the lowest priority, if that isn't higher than the new one.
+	// Returns false if it is, the new item isn't queued.
+	// Items dropped to make room are appended to dropped.
+	bool push(item&& it, speak_policy_e policy, std::vector<item>& dropped);
+
+	// Removes the next item to speak, the oldest of the highest priority.
+	std::optional<item> pop();
+
+	// Drops every item, uncounted. They are appended to dropped.
+	void clear(std::vector<item>& dropped);
+
+	bool empty() const;
+	size_t size() const;
+	size_t capacity() const;
+
+	// Items dropped by policies or a full queue.
+	size_t dropped() const;
+
+private:
+	// Drops the items of priority and lower ones.
+	void drop_up_to(speak_priority_e priority, std::vector<item>& dropped);
+
+	std::array<std::deque<item>, size_t(speak_priority_e::count)> _items;
+	size_t _size = 0;
+	size_t _capacity = 16;
+	size_t _dropped = 0;
+};
+} // namespace wsay
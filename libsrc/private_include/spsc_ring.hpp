@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace wsay {
+// Lock-free single producer, single consumer ring of bytes.
+// One thread writes, another reads, each side blocks on the other's
+// position when the ring is full or empty.
+// Both sides moving in whole samples keeps reads in whole samples.
+struct spsc_ring {
+	spsc_ring() = default;
+	// Capacity is rounded up to a power of 2.
+	explicit spsc_ring(size_t capacity);
+
+	spsc_ring(const spsc_ring&) = delete;
+	spsc_ring& operator=(const spsc_ring&) = delete;
+
+	// Empties and reopens the ring. Neither side may be using it.
+	void reset();
+
+	size_t capacity() const;
+
+	// Bytes buffered.
+	size_t size() const;
+
+	// Producer. Copies all of data, blocks while the ring is full.
+	// Returns false if the consumer cancelled, data is dropped.
+	bool write(std::span<const std::byte> data);
+
+	// Producer. Nothing more will be written, the consumer drains what is
+	// left.
+	void close();
+
+	// Consumer. Copies up to out.size() bytes, blocks until at least
+	// min_bytes are buffered or the producer closed the ring.
+	// Returns the bytes read, 0 once closed and drained.
+	size_t read(std::span<std::byte> out, size_t min_bytes);
+
+	// Consumer. Stops reading, the producer's writes fail from now on.
+	void cancel();
+
+private:
+	// Positions count bytes since the reset and never wrap. Their high bit
+	// flags the side as done, changing them wakes the other side.
+	static constexpr uint64_t done_bit = uint64_t(1) << 63;
+
+	std::vector<std::byte> _data;
+	uint64_t _mask = 0;
+
+	// Written by the producer, the consumer waits on it.
+	alignas(64) std::atomic<uint64_t> _write_pos = 0;
+	// Written by the consumer, the producer waits on it.
+	alignas(64) std::atomic<uint64_t> _read_pos = 0;
+};
+} // namespace wsay
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include "wsay/voice.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wsay {
+// Prepares text for synthesis according to voice options. Cleans it up and
+// adds speech xml (pitch, paragraph pauses).
+struct text_formatter {
+	text_formatter() = default;
+	explicit text_formatter(const voice& vopts);
+
+	// Format speak sentence according to input vopts.
+	std::wstring format_sentence(const std::wstring& in) const;
+
+private:
+	// String processing, if applicable.
+	std::vector<std::function<void(std::wstring&)>> _text_modifiers;
+};
+
+// Splits text after sentence and paragraph ends, to synthesize long texts
+// piece by piece. Pieces keep their trailing whitespace and are at least
+// min_size characters, unless the text ends first. Joined back, they are the
+// input text.
+// With xml, never splits inside a tag or an element. An element left open
+// keeps the rest of the text in one piece.
+extern std::vector<std::wstring_view> split_sentences(
+		std::wstring_view text, bool xml, size_t min_size);
+} // namespace wsay
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2024, Philippe Groarke
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ * copyright notice, this list of conditions and the following disclaimer
+ * in the documentation and/or other materials provided with the
+ * distribution.
+ *     * Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include "private_include/backend.hpp"
+#include "wsay/voice.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+namespace wsay {
+// Writes mono pcm to a wav file as it comes, in large sequential writes.
+// Only a write buffer is kept in memory, whatever the file length.
+// 8 bit pcm is signed like the effects expect, it is stored unsigned.
+struct wav_writer {
+	wav_writer() = default;
+	wav_writer(const std::filesystem::path& path, size_t sampling_rate,
+			size_t bit_depth);
+	~wav_writer();
+
+	wav_writer(wav_writer&&) = default;
+	wav_writer& operator=(wav_writer&&) = default;
+	wav_writer(const wav_writer&) = delete;
+	wav_writer& operator=(const wav_writer&) = delete;
+
+	// Appends pcm to the file. Buffered.
+	void write(std::span<const std::byte> pcm);
+
+	// Writes the buffer, patches the header with the size written so far and
+	// flushes, the file is complete. Also done on destruction.
+	void flush();
+
+	// Bytes of pcm written.
+	uint64_t size() const;
+
+private:
+	void write_file(std::span<const std::byte> data);
+
+	std::ofstream _ofs;
+	size_t _sampling_rate = 44100;
+	size_t _bit_depth = 16;
+	uint64_t _size = 0;
+	// Pcm not yet written, converted to the file format.
+	std::vector<std::byte> _buffer;
+};
+
+// Saves processed pcm to a wav file, at fx_output_rate() and the vopts bit
+// depth. Pcm is written as it is played. Stopping skips the rest of the
+// utterance, the file keeps what was written.
+struct wav_sink final : audio_sink {
+	wav_sink(const voice& vopts, const std::filesystem::path& path);
+
+	void play(const shared_pcm& pcm, bool purge) override;
+	void wait() override;
+	void stop() override;
+	void reset() override;
+	void configure(const voice& vopts) override;
+
+private:
+	wav_writer _writer;
+	// Set by stop from any thread, cleared by reset.
+	std::atomic<bool> _stopped = false;
+};
+} // namespace wsay
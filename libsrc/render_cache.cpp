@@ -0,0 +1,126 @@
+#include "private_include/render_cache.hpp"
+#include "private_include/fx_presets.hpp"
+
+#include <format>
+
+namespace wsay {
+namespace {
+// The parsed preset rather than the file, edited files render differently.
+void append_preset(const fx_args& args, std::wstring& key) {
+	key += std::format(L"{} {} {} {} {} {}", args.bit_depth,
+			size_t(args.sampling_rate), args.dist_drive, args.noise_vol,
+			size_t(args.noise_after_bitcrush), args.gain);
+	for (const biquad_args& b : args.biquads) {
+		key += std::format(
+				L" {} {} {} {}", size_t(b.type), b.freq, b.q, b.gain);
+	}
+}
+
+std::wstring make_key(const voice& vopts, std::wstring_view text) {
+	std::wstring ret = std::format(
+			L"{} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {} {}|",
+			vopts.voice_idx, size_t(vopts.volume), size_t(vopts.speed),
+			size_t(vopts.pitch), size_t(vopts.xml_parse),
+			size_t(vopts.paragraph_pause_ms), size_t(vopts.sentence_pipeline),
+			size_t(vopts.stream_synthesis),
+			size_t(vopts.radio_effect()),
+			size_t(vopts.radio_effect_disable_whitenoise),
+			vopts.radio_effect_seed, size_t(vopts.radio_effect_native_rate),
+			size_t(vopts.radio_effect_fixed_point),
+			size_t(vopts.compression()), size_t(vopts.bit_depth()),
+			size_t(vopts.sampling_rate()),
+			size_t(!vopts.radio_effect_file().empty()));
+	if (!vopts.radio_effect_file().empty()) {
+		append_preset(load_fx_preset(vopts), ret);
+	}
+	ret += L'|';
+	ret += text;
+	return ret;
+}
+} // namespace
+
+void render_cache::budget(size_t bytes) {
+	std::unique_lock lock{ _mutex };
+	_budget = bytes;
+	evict(0);
+}
+
+size_t render_cache::budget() const {
+	std::unique_lock lock{ _mutex };
+	return _budget;
+}
+
+shared_pcm render_cache::find(const voice& vopts, std::wstring_view text) {
+	std::unique_lock lock{ _mutex };
+	if (_budget == 0) {
+		return nullptr;
+	}
+
+	const std::wstring key = make_key(vopts, text);
+	auto it = _lookup.find(key);
+	if (it == _lookup.end()) {
+		++_misses;
+		return nullptr;
+	}
+
+	++_hits;
+	_entries.splice(_entries.begin(), _entries, it->second);
+	return it->second->pcm;
+}
+
+void render_cache::insert(
+		const voice& vopts, std::wstring_view text, shared_pcm pcm) {
+	std::unique_lock lock{ _mutex };
+	if (pcm->size() > _budget) {
+		return;
+	}
+
+	std::wstring key = make_key(vopts, text);
+	if (auto it = _lookup.find(key); it != _lookup.end()) {
+		// Rendered concurrently, keep the first one.
+		_entries.splice(_entries.begin(), _entries, it->second);
+		return;
+	}
+
+	evict(pcm->size());
+	_bytes += pcm->size();
+	_entries.push_front(entry{
+			.key = std::move(key),
+			.pcm = std::move(pcm),
+	});
+	_lookup.emplace(_entries.front().key, _entries.begin());
+}
+
+void render_cache::insert(const voice& vopts, std::wstring_view text,
+		std::vector<std::byte>&& pcm) {
+	insert(vopts, text,
+			std::make_shared<const std::vector<std::byte>>(std::move(pcm)));
+}
+
+void render_cache::clear() {
+	std::unique_lock lock{ _mutex };
+	_lookup.clear();
+	_entries.clear();
+	_bytes = 0;
+}
+
+render_cache_stats render_cache::stats() const {
+	std::unique_lock lock{ _mutex };
+	return render_cache_stats{
+		.hits = _hits,
+		.misses = _misses,
+		.entries = _entries.size(),
+		.bytes = _bytes,
+		.budget = _budget,
+	};
+}
+
+void render_cache::evict(size_t bytes) {
+	while (!_entries.empty() && _bytes + bytes > _budget) {
+		const entry& e = _entries.back();
+		_bytes -= e.pcm->size();
+		_lookup.erase(e.key);
+		_entries.pop_back();
+	}
+}
+} // namespace wsay
@@ -0,0 +1,158 @@
+#include "private_include/resample.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <numeric>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(__SSE2__) \
+		|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WSAY_RESAMPLE_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace wsay {
+namespace {
+// Filter half width, in zero crossings of the lower rate.
+constexpr size_t zero_crossings = 8;
+
+// Taps are padded to this, lets the dot product use independent sums.
+constexpr size_t tap_multiple = 4;
+
+float dot(const float* h, const float* x, size_t size) {
+	assert(size % tap_multiple == 0);
+	float acc[tap_multiple] = {};
+	for (size_t i = 0; i < size; i += tap_multiple) {
+		for (size_t j = 0; j < tap_multiple; ++j) {
+			acc[j] += h[i + j] * x[i + j];
+		}
+	}
+	return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+// Q14 coefficients, unity is 1 << 14.
+constexpr int coef_shift = 14;
+
+// Q15 samples, Q14 coefficients.
+int16_t dot(const int16_t* h, const int16_t* x, size_t size) {
+	assert(size % tap_multiple == 0);
+	// Partial sums may wrap, the total doesn't. Sums of the taps stay well
+	// under 2, so the total fits in 31 bits.
+	uint32_t acc = 0;
+	size_t i = 0;
+#if defined(WSAY_RESAMPLE_SSE2)
+	__m128i acc4 = _mm_setzero_si128();
+	for (; i + 8 <= size; i += 8) {
+		__m128i hv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(h + i));
+		__m128i xv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+		acc4 = _mm_add_epi32(acc4, _mm_madd_epi16(hv, xv));
+	}
+	// Horizontal sum.
+	acc4 = _mm_add_epi32(
+			acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc4 = _mm_add_epi32(
+			acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(2, 3, 0, 1)));
+	acc = uint32_t(_mm_cvtsi128_si32(acc4));
+#endif
+	for (; i < size; ++i) {
+		acc += uint32_t(int32_t(h[i]) * int32_t(x[i]));
+	}
+
+	int32_t ret = (int32_t(acc) + (1 << (coef_shift - 1))) >> coef_shift;
+	ret = (std::max)(ret, int32_t((std::numeric_limits<int16_t>::min)()));
+	return int16_t((std::min)(
+			ret, int32_t((std::numeric_limits<int16_t>::max)())));
+}
+
+template <class T>
+T to_coef(double c) {
+	if constexpr (std::is_same_v<T, float>) {
+		return float(c);
+	} else {
+		return T(std::lround(c * double(1 << coef_shift)));
+	}
+}
+} // namespace
+
+template <class T>
+basic_resampler<T>::basic_resampler(size_t in_rate, size_t out_rate) {
+	assert(in_rate != 0 && out_rate != 0);
+	size_t g = std::gcd(in_rate, out_rate);
+	_up = out_rate / g;
+	_down = in_rate / g;
+
+	// Prototype low-pass, at the upsampled rate.
+	const size_t m = (std::max)(_up, _down);
+	_center = zero_crossings * m;
+	const size_t proto_size = 2 * _center + 1;
+
+	_taps = (proto_size + _up - 1) / _up;
+	_taps = (_taps + tap_multiple - 1) / tap_multiple * tap_multiple;
+
+	std::vector<double> proto(_taps * _up, 0.0);
+	for (size_t j = 0; j < proto_size; ++j) {
+		double x = (double(j) - double(_center)) / double(m);
+		double sinc = x == 0.0 ? 1.0
+							   : std::sin(std::numbers::pi * x)
+						/ (std::numbers::pi * x);
+
+		// Blackman window.
+		double w = double(j) / double(proto_size - 1);
+		double win = 0.42 - 0.5 * std::cos(2.0 * std::numbers::pi * w)
+				+ 0.08 * std::cos(4.0 * std::numbers::pi * w);
+		proto[j] = sinc * win;
+	}
+
+	// Split in phases, each normalized to unity gain at dc.
+	_coefs.resize(_taps * _up);
+	for (size_t p = 0; p < _up; ++p) {
+		double sum = 0.0;
+		for (size_t k = 0; k < _taps; ++k) {
+			sum += proto[p + k * _up];
+		}
+
+		T* h = &_coefs[p * _taps];
+		for (size_t k = 0; k < _taps; ++k) {
+			h[_taps - 1 - k] = to_coef<T>(proto[p + k * _up] / sum);
+		}
+	}
+
+	_work.assign(_taps - 1, T(0));
+}
+
+template <class T>
+void basic_resampler<T>::process(std::span<const T> in, std::vector<T>& out) {
+	assert(_taps != 0);
+	const size_t history_size = _taps - 1;
+	assert(_work.size() == history_size);
+
+	_work.insert(_work.end(), in.begin(), in.end());
+
+	for (size_t i = _t / _up; i < in.size(); i = _t / _up) {
+		const T* h = &_coefs[(_t % _up) * _taps];
+		out.push_back(dot(h, &_work[i], _taps));
+		_t += _down;
+	}
+	_t -= in.size() * _up;
+
+	// Keep the tail as history for the next chunk.
+	_work.erase(_work.begin(), _work.end() - history_size);
+}
+
+template <class T>
+void basic_resampler<T>::flush(std::vector<T>& out) {
+	std::vector<T> silence(_taps, T(0));
+	process(silence, out);
+}
+
+template <class T>
+double basic_resampler<T>::delay() const {
+	return double(_center) / double(_down);
+}
+
+template struct basic_resampler<float>;
+template struct basic_resampler<int16_t>;
+} // namespace wsay
@@ -0,0 +1,493 @@
+#include "private_include/backend.hpp"
+#include "private_include/com.hpp"
+#include "private_include/enum_snapshot.hpp"
+#include "private_include/wav.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fea/utils/scope.hpp>
+#include <fea/utils/throw.hpp>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace wsay {
+namespace {
+// Forwards the tts pcm as SAPI writes it.
+struct sapi_synthesizer final : synthesizer {
+	sapi_synthesizer(const voice& vopts, ISpObjectToken* voice_token)
+			: _tts(make_tts_voice(vopts, voice_token)) {
+	}
+
+	void synthesize(
+			const std::wstring& text, const pcm_callback_t& on_pcm) override {
+		// SAPI writes to the stream from its thread, the pcm is handed out as
+		// it comes rather than held in memory.
+		_tts.data_stream->reset(&on_pcm);
+		fea::on_exit clear = [&]() { _tts.data_stream->reset(nullptr); };
+
+		unsigned long flags
+				= SPF_DEFAULT | SPF_ASYNC | SPF_PURGEBEFORESPEAK | _tts.flags;
+		if (!SUCCEEDED(_tts->Speak(text.c_str(), flags, nullptr))) {
+			fea::maybe_throw<std::invalid_argument>(
+					__FUNCTION__, __LINE__, "Tts voice couldn't speak.");
+		}
+		// Speaking fails when on_pcm asks to stop, that isn't an error.
+		if (!SUCCEEDED(_tts->WaitUntilDone(INFINITE))
+				&& !_tts.data_stream->aborted()) {
+			fea::maybe_throw(
+					__FUNCTION__, __LINE__, "Couldn't wait on input speak.");
+		}
+	}
+
+	void stop() override {
+		// The purge is asynchronous, synthesize returns once it is done.
+		if (!SUCCEEDED(_tts->Speak(L"",
+					SPF_DEFAULT | SPF_ASYNC | SPF_PURGEBEFORESPEAK, nullptr))) {
+			fea::maybe_throw<std::invalid_argument>(
+					__FUNCTION__, __LINE__, "Input couldn't stop.");
+		}
+	}
+
+	void configure(const voice& vopts) override {
+		configure_tts_voice(vopts, _tts);
+	}
+
+private:
+	tts_voice _tts;
+};
+
+// Writes pcm straight to the audio device, without a voice in between.
+// A feeder thread walks the queued buffers by offset, outputs share them.
+struct sapi_device final : audio_sink {
+	sapi_device(const voice& vopts, ISpObjectToken* device_token)
+			: _audio(make_audio_out(device_token))
+			, _format(to_fx_spstreamformat(vopts)) {
+		set_audio_format(_audio, _format);
+		_feeder = std::thread{ [this]() { feed(); } };
+	}
+
+	~sapi_device() {
+		{
+			std::unique_lock lock{ _mutex };
+			_quit = true;
+		}
+		_cv.notify_all();
+		_feeder.join();
+	}
+
+	void play(const shared_pcm& pcm, bool purge) override {
+		{
+			std::unique_lock lock{ _mutex };
+			if (purge) {
+				purge_queue();
+			}
+			_queue.push_back(pcm);
+			_drained = false;
+		}
+		_cv.notify_all();
+	}
+
+	void wait() override {
+		std::unique_lock lock{ _mutex };
+		_cv.wait(lock, [this]() { return _queue.empty() && _drained; });
+		if (_error) {
+			std::exception_ptr e = std::exchange(_error, nullptr);
+			std::rethrow_exception(e);
+		}
+	}
+
+	void stop() override {
+		{
+			std::unique_lock lock{ _mutex };
+			purge_queue();
+		}
+		_cv.notify_all();
+	}
+
+	void reset() override {
+		// The next play purges.
+	}
+
+	void configure(const voice& vopts) override {
+		// Applied by the feeder, the device is idle.
+		{
+			std::unique_lock lock{ _mutex };
+			_format = to_fx_spstreamformat(vopts);
+		}
+		_cv.notify_all();
+	}
+
+private:
+	// Device writes are short, so purges cut in quickly.
+	static constexpr size_t max_write = 8 * 1024;
+
+	// Must hold the mutex.
+	void purge_queue() {
+		_queue.clear();
+		_offset = 0;
+		_purge = true;
+		++_generation;
+	}
+
+	void feed() {
+		SPSTREAMFORMAT format = _format;
+		std::unique_lock lock{ _mutex };
+		while (true) {
+			_cv.wait(lock, [this]() {
+				return _quit || _purge || _format != format
+						|| !_queue.empty() || !_drained;
+			});
+			if (_quit) {
+				return;
+			}
+
+			try {
+				if (_purge || _format != format) {
+					_purge = false;
+					const SPSTREAMFORMAT new_format = _format;
+					lock.unlock();
+					if (new_format != format) {
+						set_audio_format(_audio, new_format);
+						format = new_format;
+					} else {
+						purge_audio(_audio);
+					}
+					lock.lock();
+
+					// Nothing is left playing.
+					if (_queue.empty()) {
+						_drained = true;
+						_cv.notify_all();
+					}
+					continue;
+				}
+
+				if (_queue.empty()) {
+					// Let the device play what it was given.
+					lock.unlock();
+					const bool done = audio_drained(_audio);
+					lock.lock();
+					if (done) {
+						_drained = true;
+						_cv.notify_all();
+					} else {
+						_cv.wait_for(lock, std::chrono::milliseconds(5));
+					}
+					continue;
+				}
+
+				// The buffer stays alive while written, even if purged.
+				const shared_pcm pcm = _queue.front();
+				const size_t offset = _offset;
+				const size_t size = (std::min)(max_write, pcm->size() - offset);
+				const uint64_t generation = _generation;
+				lock.unlock();
+				write_audio(_audio, { pcm->data() + offset, size });
+				lock.lock();
+
+				if (generation == _generation) {
+					_offset += size;
+					if (_offset == pcm->size()) {
+						_queue.pop_front();
+						_offset = 0;
+					}
+				}
+			} catch (...) {
+				// Reported on wait.
+				if (!lock.owns_lock()) {
+					lock.lock();
+				}
+				_error = std::current_exception();
+				_queue.clear();
+				_offset = 0;
+				_drained = true;
+				_cv.notify_all();
+			}
+		}
+	}
+
+	CComPtr<ISpMMSysAudio> _audio;
+	std::thread _feeder;
+
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	// Waiting to be written, the front one from _offset.
+	std::deque<shared_pcm> _queue;
+	size_t _offset = 0;
+	// Changes on purge, writes in flight are then dropped.
+	uint64_t _generation = 0;
+	SPSTREAMFORMAT _format;
+	bool _purge = false;
+	// Everything written was played.
+	bool _drained = true;
+	bool _quit = false;
+	std::exception_ptr _error;
+};
+
+// Replays pcm through a voice. Saves files that need converting, and plays
+// compressed formats the device can't take directly.
+struct sapi_voice_sink final : audio_sink {
+	sapi_voice_sink(const voice& vopts, const voice_output& vout,
+			ISpObjectToken* device_token)
+			: _vopts(vopts)
+			, _out(make_device_output(vopts, vout, device_token)) {
+	}
+
+	void play(const shared_pcm& pcm, bool purge) override {
+		unsigned long flags = SPF_DEFAULT | SPF_ASYNC;
+		if (purge) {
+			flags |= SPF_PURGEBEFORESPEAK;
+		}
+
+		// SAPI keeps a reference to queued streams.
+		_out.sp_stream = make_pcm_stream(_vopts, *pcm);
+		if (!SUCCEEDED(_out->SpeakStream(_out.sp_stream, flags, nullptr))) {
+			fea::maybe_throw<std::runtime_error>(
+					__FUNCTION__, __LINE__, "Couldn't speak output stream.");
+		}
+	}
+
+	void wait() override {
+		if (!SUCCEEDED(_out->WaitUntilDone(INFINITE))) {
+			fea::maybe_throw(
+					__FUNCTION__, __LINE__, "Couldn't wait on output speak.");
+		}
+	}
+
+	void stop() override {
+		if (!SUCCEEDED(_out->Speak(L"",
+					SPF_DEFAULT | SPF_ASYNC | SPF_PURGEBEFORESPEAK, nullptr))) {
+			fea::maybe_throw<std::runtime_error>(
+					__FUNCTION__, __LINE__, "Output couldn't stop.");
+		}
+	}
+
+	void reset() override {
+		// The next play purges.
+	}
+
+	void configure(const voice& vopts) override {
+		// The voice converts from the stream format.
+		_vopts = vopts;
+	}
+
+private:
+	voice _vopts;
+	device_output _out;
+};
+
+// Enumerates voices and devices on first use, or reads them from the
+// snapshot. Tokens are then created one at a time, when needed.
+struct sapi_backend final : backend {
+	void snapshot_path(const std::filesystem::path& path) override {
+		std::unique_lock lock{ _mutex };
+		_snapshot_path = path;
+	}
+
+	const std::vector<std::wstring>& voices() override {
+		std::unique_lock lock{ _mutex };
+		load_voices();
+		return _voice_names;
+	}
+	const std::vector<std::wstring>& devices() override {
+		std::unique_lock lock{ _mutex };
+		load_devices();
+		return _device_names;
+	}
+
+	size_t default_device_idx() override {
+		std::unique_lock lock{ _mutex };
+		load_devices();
+
+		// Matching the device name is slow, only do it when the system
+		// device changes.
+		const std::wstring id = default_output_device_id();
+		if (id.empty() || id != _default_device_id) {
+			_default_device_idx = default_output_device_idx(_device_names);
+			_default_device_id = id;
+			if (!id.empty()) {
+				save_snapshot();
+			}
+		}
+		return _default_device_idx;
+	}
+
+	std::unique_ptr<synthesizer> make_synthesizer(const voice& vopts) override {
+		CComPtr<ISpObjectToken> token;
+		{
+			std::unique_lock lock{ _mutex };
+			load_voices();
+			token = get_token(vopts.voice_idx, _voice_ids, _voice_tokens);
+		}
+		return std::make_unique<sapi_synthesizer>(vopts, token);
+	}
+
+	std::unique_ptr<audio_sink> make_sink(
+			const voice& vopts, const voice_output& vout) override {
+		// Files don't need devices.
+		CComPtr<ISpObjectToken> token;
+		if (vout.type == output_type_e::device) {
+			std::unique_lock lock{ _mutex };
+			load_devices();
+			token = get_token(vout.device_idx, _device_ids, _device_tokens);
+		}
+
+		if (vout.type == output_type_e::device
+				&& vopts.compression() == compression_e::none) {
+			return std::make_unique<sapi_device>(vopts, token);
+		}
+		if (vout.type == output_type_e::file && is_file_format(vopts)) {
+			return std::make_unique<wav_sink>(vopts, vout.file_path);
+		}
+		return std::make_unique<sapi_voice_sink>(vopts, vout, token);
+	}
+
+private:
+	// The following must hold the mutex.
+
+	void load_voices() {
+		if (_voices_loaded || load_snapshot()) {
+			return;
+		}
+		_voice_tokens = make_voice_tokens();
+		_voice_names = make_names(_voice_tokens);
+		_voice_ids = make_ids(_voice_tokens);
+		_voices_loaded = true;
+		save_snapshot();
+	}
+
+	void load_devices() {
+		if (_devices_loaded || load_snapshot()) {
+			return;
+		}
+		_device_tokens = make_device_tokens();
+		_device_names = make_names(_device_tokens);
+		_device_ids = make_ids(_device_tokens);
+		_devices_loaded = true;
+		save_snapshot();
+	}
+
+	// Loads everything from the snapshot, if it is still valid.
+	bool load_snapshot() {
+		if (_snapshot_path.empty() || _voices_loaded || _devices_loaded) {
+			return false;
+		}
+
+		_signature = enumeration_signature();
+		std::optional<enum_snapshot> snap
+				= load_enum_snapshot(_snapshot_path, _signature);
+		if (!snap) {
+			return false;
+		}
+
+		_voice_ids = std::move(snap->voice_ids);
+		_voice_names = std::move(snap->voice_names);
+		_voice_tokens.resize(_voice_ids.size());
+		_device_ids = std::move(snap->device_ids);
+		_device_names = std::move(snap->device_names);
+		_device_tokens.resize(_device_ids.size());
+		_default_device_id = std::move(snap->default_device_id);
+		_default_device_idx = snap->default_device_idx;
+		_voices_loaded = true;
+		_devices_loaded = true;
+		return true;
+	}
+
+	// Saves everything, enumerating what wasn't yet.
+	void save_snapshot() {
+		if (_snapshot_path.empty()) {
+			return;
+		}
+
+		if (_signature.empty()) {
+			_signature = enumeration_signature();
+		}
+		if (!_voices_loaded) {
+			_voice_tokens = make_voice_tokens();
+			_voice_names = make_names(_voice_tokens);
+			_voice_ids = make_ids(_voice_tokens);
+			_voices_loaded = true;
+		}
+		if (!_devices_loaded) {
+			_device_tokens = make_device_tokens();
+			_device_names = make_names(_device_tokens);
+			_device_ids = make_ids(_device_tokens);
+			_devices_loaded = true;
+		}
+		if (_default_device_id.empty()) {
+			_default_device_id = default_output_device_id();
+			_default_device_idx = default_output_device_idx(_device_names);
+		}
+
+		save_enum_snapshot(_snapshot_path,
+				enum_snapshot{
+						.signature = _signature,
+						.voice_ids = _voice_ids,
+						.voice_names = _voice_names,
+						.device_ids = _device_ids,
+						.device_names = _device_names,
+						.default_device_id = _default_device_id,
+						.default_device_idx = _default_device_idx,
+				});
+	}
+
+	CComPtr<ISpObjectToken> get_token(size_t idx,
+			const std::vector<std::wstring>& ids,
+			std::vector<CComPtr<ISpObjectToken>>& tokens) {
+		assert(ids.size() == tokens.size());
+		if (idx >= tokens.size()) {
+			fea::maybe_throw<std::out_of_range>(
+					__FUNCTION__, __LINE__, "Invalid voice or device index.");
+		}
+		if (tokens[idx]) {
+			return tokens[idx];
+		}
+
+		tokens[idx] = make_token(ids[idx]);
+		if (!tokens[idx]) {
+			// Removed in a way the signature missed, start over next time.
+			if (!_snapshot_path.empty()) {
+				std::error_code ec;
+				std::filesystem::remove(_snapshot_path, ec);
+			}
+			fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
+					"Couldn't create voice or device, it may have been "
+					"removed. Please try again.");
+		}
+		return tokens[idx];
+	}
+
+	std::mutex _mutex;
+	std::filesystem::path _snapshot_path;
+	std::wstring _signature;
+
+	bool _voices_loaded = false;
+	// Null until used, when read from the snapshot.
+	std::vector<CComPtr<ISpObjectToken>> _voice_tokens;
+	std::vector<std::wstring> _voice_ids;
+	std::vector<std::wstring> _voice_names;
+
+	bool _devices_loaded = false;
+	std::vector<CComPtr<ISpObjectToken>> _device_tokens;
+	std::vector<std::wstring> _device_ids;
+	std::vector<std::wstring> _device_names;
+
+	// The last system device seen.
+	std::wstring _default_device_id;
+	size_t _default_device_idx = 0;
+};
+} // namespace
+
+std::unique_ptr<backend> make_sapi_backend() {
+	return std::make_unique<sapi_backend>();
+}
+} // namespace wsay
@@ -0,0 +1,88 @@
+#include "private_include/speech_queue.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <utility>
+
+namespace wsay {
+speech_queue::speech_queue(size_t capacity)
+		: _capacity((std::max)(capacity, size_t(1))) {
+}
+
+bool speech_queue::push(
+		item&& it, speak_policy_e policy, std::vector<item>& dropped) {
+	assert(it.priority < speak_priority_e::count);
+	if (policy != speak_policy_e::append) {
+		drop_up_to(it.priority, dropped);
+	}
+
+	if (_size == _capacity) {
+		// The lowest priority with items.
+		size_t p = 0;
+		while (_items[p].empty()) {
+			++p;
+		}
+		if (p > size_t(it.priority)) {
+			++_dropped;
+			return false;
+		}
+		dropped.push_back(std::move(_items[p].front()));
+		_items[p].pop_front();
+		--_size;
+		++_dropped;
+	}
+
+	_items[size_t(it.priority)].push_back(std::move(it));
+	++_size;
+	return true;
+}
+
+std::optional<speech_queue::item> speech_queue::pop() {
+	for (size_t p = _items.size(); p-- > 0;) {
+		if (_items[p].empty()) {
+			continue;
+		}
+		std::optional<item> ret{ std::move(_items[p].front()) };
+		_items[p].pop_front();
+		--_size;
+		return ret;
+	}
+	return std::nullopt;
+}
+
+void speech_queue::clear(std::vector<item>& dropped) {
+	for (std::deque<item>& items : _items) {
+		std::move(items.begin(), items.end(), std::back_inserter(dropped));
+		items.clear();
+	}
+	_size = 0;
+}
+
+bool speech_queue::empty() const {
+	return _size == 0;
+}
+
+size_t speech_queue::size() const {
+	return _size;
+}
+
+size_t speech_queue::capacity() const {
+	return _capacity;
+}
+
+size_t speech_queue::dropped() const {
+	return _dropped;
+}
+
+void speech_queue::drop_up_to(
+		speak_priority_e priority, std::vector<item>& dropped) {
+	for (size_t p = 0; p <= size_t(priority); ++p) {
+		std::move(_items[p].begin(), _items[p].end(),
+				std::back_inserter(dropped));
+		_dropped += _items[p].size();
+		_size -= _items[p].size();
+		_items[p].clear();
+	}
+}
+} // namespace wsay
@@ -0,0 +1,92 @@
+#include "private_include/spsc_ring.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+namespace wsay {
+spsc_ring::spsc_ring(size_t capacity)
+		: _data(std::bit_ceil((std::max)(capacity, size_t(2))))
+		, _mask(uint64_t(_data.size() - 1)) {
+}
+
+void spsc_ring::reset() {
+	_write_pos.store(0, std::memory_order_relaxed);
+	_read_pos.store(0, std::memory_order_relaxed);
+}
+
+size_t spsc_ring::capacity() const {
+	return _data.size();
+}
+
+size_t spsc_ring::size() const {
+	const uint64_t r = _read_pos.load(std::memory_order_acquire) & ~done_bit;
+	const uint64_t w = _write_pos.load(std::memory_order_acquire) & ~done_bit;
+	return size_t(w - r);
+}
+
+bool spsc_ring::write(std::span<const std::byte> data) {
+	// Only this thread changes the write position.
+	uint64_t w = _write_pos.load(std::memory_order_relaxed);
+	assert((w & done_bit) == 0);
+
+	while (!data.empty()) {
+		uint64_t r = _read_pos.load(std::memory_order_acquire);
+		while ((r & done_bit) == 0 && w - r == _data.size()) {
+			_read_pos.wait(r, std::memory_order_acquire);
+			r = _read_pos.load(std::memory_order_acquire);
+		}
+		if ((r & done_bit) != 0) {
+			return false;
+		}
+
+		// Up to the free space, in at most 2 copies around the end.
+		const size_t count = (std::min)(
+				data.size(), size_t(_data.size() - (w - r)));
+		const size_t begin = size_t(w & _mask);
+		const size_t first = (std::min)(count, _data.size() - begin);
+		std::memcpy(_data.data() + begin, data.data(), first);
+		std::memcpy(_data.data(), data.data() + first, count - first);
+
+		w += count;
+		data = data.subspan(count);
+		_write_pos.store(w, std::memory_order_release);
+		_write_pos.notify_one();
+	}
+	return true;
+}
+
+void spsc_ring::close() {
+	_write_pos.fetch_or(done_bit, std::memory_order_release);
+	_write_pos.notify_one();
+}
+
+size_t spsc_ring::read(std::span<std::byte> out, size_t min_bytes) {
+	// Only this thread changes the read position.
+	const uint64_t r = _read_pos.load(std::memory_order_relaxed);
+	assert((r & done_bit) == 0);
+	min_bytes = (std::min)(min_bytes, out.size());
+
+	uint64_t w = _write_pos.load(std::memory_order_acquire);
+	while ((w & done_bit) == 0 && w - r < min_bytes) {
+		_write_pos.wait(w, std::memory_order_acquire);
+		w = _write_pos.load(std::memory_order_acquire);
+	}
+
+	const size_t count = (std::min)(out.size(), size_t((w & ~done_bit) - r));
+	const size_t begin = size_t(r & _mask);
+	const size_t first = (std::min)(count, _data.size() - begin);
+	std::memcpy(out.data(), _data.data() + begin, first);
+	std::memcpy(out.data() + first, _data.data(), count - first);
+
+	_read_pos.store(r + count, std::memory_order_release);
+	_read_pos.notify_one();
+	return count;
+}
+
+void spsc_ring::cancel() {
+	_read_pos.fetch_or(done_bit, std::memory_order_release);
+	_read_pos.notify_one();
+}
+} // namespace wsay
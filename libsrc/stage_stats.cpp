@@ -0,0 +1,89 @@
+#include "private_include/stage_stats.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+namespace wsay {
+namespace {
+using duration_t = std::chrono::steady_clock::duration;
+
+// Durations under 4us get a bucket each, longer ones 4 buckets per power
+// of 2, by their 2 bits after the leading one.
+size_t bucket_index(uint64_t us) {
+	if (us < 4) {
+		return size_t(us);
+	}
+	const size_t exponent = size_t(std::bit_width(us)) - 1;
+	const size_t ret = 4 * (exponent - 1) + size_t((us >> (exponent - 2)) & 3);
+	return (std::min)(ret, duration_histogram::num_buckets - 1);
+}
+
+// The first microsecond past the bucket.
+uint64_t bucket_end(size_t idx) {
+	if (idx < 4) {
+		return uint64_t(idx) + 1;
+	}
+	const size_t exponent = idx / 4 + 1;
+	return (uint64_t(5 + idx % 4)) << (exponent - 2);
+}
+} // namespace
+
+void duration_histogram::add(duration_t d) {
+	const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d);
+	++buckets[bucket_index(uint64_t((std::max)(us.count(), int64_t(0))))];
+	++count;
+	total += d;
+	max = (std::max)(max, d);
+}
+
+duration_t duration_histogram::percentile(double p) const {
+	if (count == 0) {
+		return {};
+	}
+
+	// The rank of the sample, from 1 to count.
+	const size_t rank = std::clamp(size_t(std::ceil(p / 100.0 * double(count))),
+			size_t(1), count);
+	size_t seen = 0;
+	for (size_t i = 0; i < buckets.size(); ++i) {
+		seen += buckets[i];
+		if (seen >= rank) {
+			const duration_t end = std::chrono::duration_cast<duration_t>(
+					std::chrono::microseconds(bucket_end(i)));
+			return (std::min)(end, max);
+		}
+	}
+	return max;
+}
+
+bool stage_stats::enabled() const {
+	return _enabled.load(std::memory_order_relaxed);
+}
+
+void stage_stats::enabled(bool enable) {
+	_enabled.store(enable, std::memory_order_relaxed);
+}
+
+void stage_stats::record(const stage_times& times, duration_t render,
+		size_t bytes, double audio_seconds) {
+	std::unique_lock lock{ _mutex };
+	for (size_t i = 0; i < times.size(); ++i) {
+		_stats.stages[i].add(times[i]);
+	}
+	_stats.utterances.add(render);
+	_stats.bytes += bytes;
+	_stats.audio_seconds += audio_seconds;
+}
+
+engine_stats stage_stats::stats() const {
+	std::unique_lock lock{ _mutex };
+	return _stats;
+}
+
+void stage_stats::reset() {
+	std::unique_lock lock{ _mutex };
+	_stats = {};
+}
+} // namespace wsay
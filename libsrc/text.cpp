@@ -0,0 +1,185 @@
+#include "private_include/text.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cwctype>
+#include <fea/numerics/literals.hpp>
+#include <fea/string/string.hpp>
+#include <format>
+#include <limits>
+#include <regex>
+
+namespace wsay {
+using namespace fea::literals;
+
+namespace {
+bool is_space(wchar_t c) {
+	return c == L' ' || c == L'\t' || c == L'\r' || c == L'\n' || c == L'\f'
+			|| c == L'\v';
+}
+
+// Full width punctuation isn't followed by a space.
+bool is_full_width_end(wchar_t c) {
+	// Ideographic full stop, full width '!' and '?'.
+	return c == L'\u3002' || c == L'\uff01' || c == L'\uff1f';
+}
+
+bool is_sentence_end(wchar_t c) {
+	// Ellipsis included.
+	return c == L'.' || c == L'!' || c == L'?' || c == L'\u2026'
+			|| is_full_width_end(c);
+}
+
+// Quotes and brackets closing a sentence.
+bool is_closing(wchar_t c) {
+	// Typographic quotes and guillemet included.
+	return c == L'"' || c == L'\'' || c == L')' || c == L']' || c == L'\u201d'
+			|| c == L'\u2019' || c == L'\u00bb';
+}
+
+// Returns the index past the xml tag starting at i, updates the element
+// depth. A lone '<' isn't a tag.
+size_t skip_tag(std::wstring_view text, size_t i, size_t& depth) {
+	auto past = [&](std::wstring_view end, size_t from) {
+		size_t pos = text.find(end, from);
+		return pos == std::wstring_view::npos ? text.size() : pos + end.size();
+	};
+
+	if (text.substr(i).starts_with(L"<!--")) {
+		return past(L"-->", i + 4);
+	}
+	if (i + 1 == text.size()) {
+		return text.size();
+	}
+
+	const wchar_t n = text[i + 1];
+	if (n == L'?' || n == L'!') {
+		return past(L">", i + 2);
+	}
+	if (n == L'/') {
+		depth -= depth == 0 ? 0 : 1;
+		return past(L">", i + 2);
+	}
+	if (!std::iswalpha(n) && n != L'_') {
+		return i + 1;
+	}
+
+	// Attribute values may contain '>'.
+	wchar_t quote = L'\0';
+	for (size_t j = i + 2; j < text.size(); ++j) {
+		const wchar_t c = text[j];
+		if (quote != L'\0') {
+			quote = c == quote ? L'\0' : quote;
+		} else if (c == L'"' || c == L'\'') {
+			quote = c;
+		} else if (c == L'>') {
+			depth += text[j - 1] == L'/' ? 0 : 1;
+			return j + 1;
+		}
+	}
+	return text.size();
+}
+} // namespace
+
+text_formatter::text_formatter(const voice& vopts) {
+	// Add xml tags that are driven by voice options.
+	if (vopts.pitch != 10_u8) {
+		int pitch = int(std::clamp(vopts.pitch, 0_u8, 20_u8));
+		pitch -= 10;
+		assert(pitch >= -10 && pitch <= 10);
+
+		_text_modifiers.push_back([p = pitch](std::wstring& text) {
+			assert(p >= -10 && p <= 10);
+			text = std::format(L"<pitch absmiddle=\"{}\">{}</pitch>",
+					std::to_wstring(p), text);
+		});
+	}
+
+	// Add more involved text parsing processes.
+	if (vopts.paragraph_pause_ms != (std::numeric_limits<uint16_t>::max)()) {
+		// Text cleanup.
+		// Might be needed for other parsing.
+		_text_modifiers.push_back([](std::wstring& text) {
+			static const std::wregex spaces_re{
+				L"[ \\t\\v]+",
+				std::regex_constants::optimize | std::regex_constants::icase,
+			};
+			static const std::wregex line_endings_re{
+				L"\\s*\\n+\\s*",
+				std::regex_constants::optimize | std::regex_constants::icase,
+			};
+
+			// Cleanup \r\n, multiple consecutive tabs + spaces, etc.
+			fea::replace_all_inplace(text, L'\r', L' ');
+			fea::replace_all_inplace(text, L'\f', L' ');
+			text = std::regex_replace(text, spaces_re, L" ");
+			text = std::regex_replace(text, line_endings_re, L"\n");
+		});
+
+		// Pragraph pause insertion.
+		_text_modifiers.push_back(
+				[ms = vopts.paragraph_pause_ms](std::wstring& text) {
+					const std::wstring paragraph_xml
+							= std::format(L"<silence msec=\"{}\"/>", ms);
+
+					// Add silence speech xml.
+					fea::replace_all_inplace(text, L"\n", paragraph_xml);
+				});
+	}
+}
+
+std::wstring text_formatter::format_sentence(const std::wstring& in) const {
+	if (_text_modifiers.empty()) {
+		return in;
+	}
+
+	std::wstring ret = in;
+	for (const std::function<void(std::wstring&)>& func : _text_modifiers) {
+		func(ret);
+	}
+	return ret;
+}
+
+std::vector<std::wstring_view> split_sentences(
+		std::wstring_view text, bool xml, size_t min_size) {
+	std::vector<std::wstring_view> ret;
+	size_t begin = 0;
+	size_t depth = 0;
+	size_t i = 0;
+	while (i < text.size()) {
+		const wchar_t c = text[i];
+		if (xml && c == L'<') {
+			i = skip_tag(text, i, depth);
+			continue;
+		}
+		++i;
+
+		bool end = c == L'\n';
+		if (is_sentence_end(c)) {
+			// Ellipsis, "?!", closing quotes.
+			while (i < text.size()
+					&& (is_sentence_end(text[i]) || is_closing(text[i]))) {
+				++i;
+			}
+			// Decimals and such aren't followed by a space.
+			end = is_full_width_end(c) || i == text.size()
+					|| is_space(text[i]);
+		}
+
+		if (!end || depth != 0 || i - begin < min_size) {
+			continue;
+		}
+
+		while (i < text.size() && is_space(text[i])) {
+			++i;
+		}
+		ret.push_back(text.substr(begin, i - begin));
+		begin = i;
+	}
+
+	if (begin < text.size()) {
+		ret.push_back(text.substr(begin));
+	}
+	return ret;
+}
+} // namespace wsay
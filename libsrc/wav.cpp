@@ -0,0 +1,182 @@
+#include "private_include/wav.hpp"
+#include "private_include/fx_chain.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fea/utils/throw.hpp>
+#include <format>
+#include <limits>
+#include <stdexcept>
+
+namespace wsay {
+namespace {
+static_assert(std::endian::native == std::endian::little,
+		"wav files are little endian.");
+
+constexpr size_t header_size = 44;
+// Pcm is written to disk in blocks of this size.
+constexpr size_t write_size = 1024 * 1024;
+// The riff size field counts from the format, after these 8 bytes.
+constexpr size_t riff_offset = 8;
+
+template <class T>
+void put(std::array<std::byte, header_size>& header, size_t pos, T v) {
+	std::memcpy(header.data() + pos, &v, sizeof(T));
+}
+
+void put(std::array<std::byte, header_size>& header, size_t pos,
+		const char (&tag)[5]) {
+	std::memcpy(header.data() + pos, tag, 4);
+}
+
+std::array<std::byte, header_size> make_header(
+		size_t sampling_rate, size_t bit_depth, uint64_t size) {
+	// Sizes are 32 bits, longer files play up to the limit.
+	constexpr uint64_t max_size
+			= (std::numeric_limits<uint32_t>::max)() - header_size;
+	const uint32_t data_size = uint32_t((std::min)(size, max_size));
+	const uint16_t block_align = uint16_t(bit_depth / 8);
+
+	std::array<std::byte, header_size> ret{};
+	put(ret, 0, "RIFF");
+	put(ret, 4, uint32_t(header_size - riff_offset + data_size));
+	put(ret, 8, "WAVE");
+	put(ret, 12, "fmt ");
+	put(ret, 16, uint32_t(16));
+	// pcm, mono
+	put(ret, 20, uint16_t(1));
+	put(ret, 22, uint16_t(1));
+	put(ret, 24, uint32_t(sampling_rate));
+	put(ret, 28, uint32_t(sampling_rate * block_align));
+	put(ret, 32, block_align);
+	put(ret, 34, uint16_t(bit_depth));
+	put(ret, 36, "data");
+	put(ret, 40, data_size);
+	return ret;
+}
+} // namespace
+
+wav_writer::wav_writer(const std::filesystem::path& path,
+		size_t sampling_rate, size_t bit_depth)
+		: _ofs(path, std::ios::binary | std::ios::trunc)
+		, _sampling_rate(sampling_rate)
+		, _bit_depth(bit_depth) {
+	if (!_ofs.is_open()) {
+		fea::maybe_throw<std::runtime_error>(__FUNCTION__, __LINE__,
+				std::format("Couldn't open wav file '{}'.", path.string()));
+	}
+	if (bit_depth != 8 && bit_depth != 16) {
+		fea::maybe_throw<std::invalid_argument>(__FUNCTION__, __LINE__,
+				"Wav files are 8 or 16 bits.");
+	}
+
+	// Patched by flush, once the sizes are known.
+	const std::array<std::byte, header_size> header
+			= make_header(sampling_rate, bit_depth, 0);
+	_ofs.write(reinterpret_cast<const char*>(header.data()), header.size());
+}
+
+wav_writer::~wav_writer() {
+	if (!_ofs.is_open()) {
+		return;
+	}
+
+	// Destructors can't throw, the file is left as is.
+	try {
+		flush();
+	} catch (...) {
+	}
+}
+
+void wav_writer::write(std::span<const std::byte> pcm) {
+	_size += pcm.size();
+	while (!pcm.empty()) {
+		// Large 16 bit blocks go straight to the file.
+		if (_buffer.empty() && _bit_depth == 16 && pcm.size() >= write_size) {
+			write_file(pcm);
+			return;
+		}
+
+		if (_buffer.capacity() < write_size) {
+			_buffer.reserve(write_size);
+		}
+		const size_t size = (std::min)(pcm.size(), write_size - _buffer.size());
+		const size_t pos = _buffer.size();
+		_buffer.insert(_buffer.end(), pcm.begin(), pcm.begin() + size);
+		if (_bit_depth == 8) {
+			std::transform(_buffer.begin() + pos, _buffer.end(),
+					_buffer.begin() + pos,
+					[](std::byte b) { return b ^ std::byte{ 0x80 }; });
+		}
+		pcm = pcm.subspan(size);
+
+		if (_buffer.size() == write_size) {
+			write_file(_buffer);
+			_buffer.clear();
+		}
+	}
+}
+
+void wav_writer::flush() {
+	write_file(_buffer);
+	_buffer.clear();
+
+	const std::array<std::byte, header_size> header
+			= make_header(_sampling_rate, _bit_depth, _size);
+	const std::streampos end = _ofs.tellp();
+	_ofs.seekp(0);
+	_ofs.write(reinterpret_cast<const char*>(header.data()), header.size());
+	_ofs.seekp(end);
+	_ofs.flush();
+	if (!_ofs) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't write wav header.");
+	}
+}
+
+uint64_t wav_writer::size() const {
+	return _size;
+}
+
+void wav_writer::write_file(std::span<const std::byte> data) {
+	_ofs.write(reinterpret_cast<const char*>(data.data()),
+			std::streamsize(data.size()));
+	if (!_ofs) {
+		fea::maybe_throw<std::runtime_error>(
+				__FUNCTION__, __LINE__, "Couldn't write wav file.");
+	}
+}
+
+wav_sink::wav_sink(const voice& vopts, const std::filesystem::path& path)
+		: _writer(path, to_value(fx_output_rate(vopts)),
+				vopts.bit_depth() == bit_depth_e::_8 ? 8 : 16) {
+}
+
+void wav_sink::play(const shared_pcm& pcm, bool) {
+	// Long renders are written in blocks, so stop returns quickly.
+	std::span<const std::byte> data{ *pcm };
+	while (!data.empty() && !_stopped) {
+		const size_t size = (std::min)(data.size(), write_size);
+		_writer.write(data.first(size));
+		data = data.subspan(size);
+	}
+}
+
+void wav_sink::wait() {
+	_writer.flush();
+}
+
+void wav_sink::stop() {
+	_stopped = true;
+}
+
+void wav_sink::reset() {
+	_stopped = false;
+}
+
+void wav_sink::configure(const voice&) {
+	// Files aren't reused.
+}
+} // namespace wsay
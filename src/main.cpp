@@ -3,16 +3,47 @@
 #include <fea/getopt/getopt.hpp>
 #include <fea/terminal/pipe.hpp>
 #include <fea/terminal/utf8_io.hpp>
+#include <chrono>
 #include <filesystem>
 #include <format>
 #include <iostream>
+#include <iterator>
 #include <string>
+#include <system_error>
 #include <wsay/engine.hpp>
 #include <wsay/voice.hpp>
 
 const std::wstring exit_cmd = L"!exit";
 const std::wstring shutup_cmd = L"!stop";
 
+// Prints where the time of the spoken utterances went.
+void print_stats(const wsay::engine_stats& stats) {
+	auto ms = [](std::chrono::steady_clock::duration d) {
+		return std::chrono::duration<double, std::milli>(d).count();
+	};
+
+	std::wcout << std::format(
+			L"[Stats] {} utterances, {:.2f}s of audio, {} bytes, {:.1f}x "
+			L"real-time.\n",
+			stats.utterances.count, stats.audio_seconds, stats.bytes,
+			stats.realtime_factor());
+
+	const wchar_t* names[] = {
+		L"format",
+		L"synthesis",
+		L"fx",
+		L"output",
+		L"drain",
+	};
+	static_assert(std::size(names) == size_t(wsay::speak_stage_e::count));
+	for (size_t i = 0; i < stats.stages.size(); ++i) {
+		const wsay::duration_histogram& h = stats.stages[i];
+		std::wcout << std::format(
+				L"[Stats] {:<10} p50 {:10.3f}ms  p99 {:10.3f}ms\n", names[i],
+				ms(h.percentile(50.0)), ms(h.percentile(99.0)));
+	}
+}
+
 int wmain(int argc, wchar_t** argv, wchar_t**) {
 	fea::fast_iostreams();
 	auto on_exit_reset_term = fea::utf8_io(true);
@@ -20,7 +51,18 @@ int wmain(int argc, wchar_t** argv, wchar_t**) {
 	wsay::engine engine;
 	wsay::voice voice;
 
+	// Scripts call wsay repeatedly, skip enumerating voices and devices.
+	{
+		std::error_code ec;
+		const std::filesystem::path tmp_dir
+				= std::filesystem::temp_directory_path(ec);
+		if (!ec) {
+			engine.enumeration_snapshot(tmp_dir / L"wsay_enumeration.bin");
+		}
+	}
+
 	bool interactive_mode = false;
+	bool show_stats = false;
 	std::wstring speech_text = fea::wread_pipe_text();
 
 	fea::get_opt<wchar_t> opt;
@@ -236,6 +278,25 @@ int wmain(int argc, wchar_t** argv, wchar_t**) {
 			L"Sets the amount of pause time between "
 			L"paragraphs (in milliseconds), from 0 to *a big number*.");
 
+	opt.add_flag_option(
+			L"pipeline",
+			[&]() {
+				voice.sentence_pipeline = true;
+				return true;
+			},
+			L"Speaks long texts sentence by sentence. Playback starts as soon "
+			L"as the first sentence is ready, instead of after the whole "
+			L"text.\n");
+
+	opt.add_flag_option(
+			L"stream",
+			[&]() {
+				voice.stream_synthesis = true;
+				return true;
+			},
+			L"Plays and saves audio while it is synthesized. Starts right "
+			L"away and uses little memory, even on very long texts.\n");
+
 
 	opt.add_required_arg_option(
 			L"fxradio",
@@ -255,6 +316,23 @@ int wmain(int argc, wchar_t** argv, wchar_t**) {
 						L"radio, from 1 to {}.\n",
 					wsay::radio_preset_count()));
 
+	opt.add_required_arg_option(
+			L"fxradio_file",
+			[&](std::wstring&& f) {
+				std::filesystem::path preset_file{ std::move(f) };
+				if (!std::filesystem::is_regular_file(preset_file)) {
+					std::wcerr << std::format(
+							L"--fxradio_file couldn't find '{}'.\n",
+							preset_file.wstring());
+					return false;
+				}
+
+				voice.radio_effect(preset_file);
+				return true;
+			},
+			L"Degrades audio using a custom radio preset '.ini' file. See "
+			L"the examples in 'resources/presets'.\n");
+
 	opt.add_flag_option(
 			L"fxradio_nonoise",
 			[&]() {
@@ -263,6 +341,44 @@ int wmain(int argc, wchar_t** argv, wchar_t**) {
 			},
 			L"Disables background noise when using --fxradio.\n");
 
+	opt.add_required_arg_option(
+			L"fxradio_seed",
+			[&](std::wstring&& str) {
+				voice.radio_effect_seed = std::stoull(str);
+				return true;
+			},
+			L"Seeds the --fxradio background noise, the same seed always "
+			L"renders the same noise.\n");
+
+	opt.add_flag_option(
+			L"fxradio_native_rate",
+			[&]() {
+				voice.radio_effect_native_rate = true;
+				return true;
+			},
+			L"Keeps --fxradio output at the effect's sampling rate. Output "
+			L"files are smaller, playback devices resample.\n");
+
+	opt.add_flag_option(
+			L"fxradio_fixed_point",
+			[&]() {
+				voice.radio_effect_fixed_point = true;
+				return true;
+			},
+			L"Runs --fxradio effects in fixed-point, on the audio directly. "
+			L"Uses less memory, sounds very slightly different.\n");
+
+	opt.add_flag_option(
+			L"stats",
+			[&]() {
+				show_stats = true;
+				engine.collect_stats(true);
+				return true;
+			},
+			L"Prints the real-time factor, the 50th and 99th percentile "
+			L"timings of each speaking stage and the bytes spoken, once "
+			L"done.\n");
+
 
 	std::wstring help_outro = L"wsay\nversion ";
 	help_outro += WSAY_VERSION;
@@ -305,9 +421,16 @@ int wmain(int argc, wchar_t** argv, wchar_t**) {
 
 			engine.speak_async(wsentence, tok);
 		}
+
+		if (show_stats) {
+			print_stats(engine.stats());
+		}
 		return 0;
 	}
 
 	engine.speak(voice, speech_text);
+	if (show_stats) {
+		print_stats(engine.stats());
+	}
 	return 0;
 }
@@ -0,0 +1,90 @@
+#include "private_include/atan.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+namespace {
+// The distortion sees drive * sample, up to 100.
+std::vector<float> make_inputs() {
+	std::vector<float> ret;
+	ret.reserve(4'000'001);
+	for (int i = -2'000'000; i <= 2'000'000; ++i) {
+		ret.push_back(float(i) * 0.00005f);
+	}
+	return ret;
+}
+
+TEST(atan, max_error) {
+	const std::vector<float> inputs = make_inputs();
+	double poly_error = 0.0;
+	double table_error = 0.0;
+	for (float x : inputs) {
+		const double expected = std::atan(double(x));
+		poly_error = (std::max)(
+				poly_error, std::abs(double(wsay::atan_poly(x)) - expected));
+		table_error = (std::max)(
+				table_error, std::abs(double(wsay::atan_table(x)) - expected));
+	}
+	EXPECT_LT(poly_error, 2e-6);
+	EXPECT_LT(table_error, 5e-7);
+
+	// Through the waveshaper, simd included.
+	for (wsay::atan_e path : { wsay::atan_e::poly, wsay::atan_e::table }) {
+		std::vector<float> out = inputs;
+		wsay::distort(path, 1.f, 1.f, 1.f, out);
+		double error = 0.0;
+		for (size_t i = 0; i < out.size(); ++i) {
+			error = (std::max)(error,
+					std::abs(double(out[i]) - std::atan(double(inputs[i]))));
+		}
+		EXPECT_LT(error, path == wsay::atan_e::poly ? 2e-6 : 5e-7);
+	}
+
+	// Any input.
+	constexpr float inf = std::numeric_limits<float>::infinity();
+	for (float x : { 1e3f, -1e6f, 3e38f, inf, -inf }) {
+		EXPECT_NEAR(wsay::atan_poly(x), std::atan(x), 2e-6) << x;
+		EXPECT_NEAR(wsay::atan_table(x), std::atan(x), 5e-7) << x;
+	}
+}
+
+// The simd waveshaper runs the same operations as atan_poly.
+TEST(atan, distort_poly_matches_scalar) {
+	constexpr float inf = std::numeric_limits<float>::infinity();
+	const float specials[] = { 0.f, -0.f, 1.f, -1.f, 0.99999f, 1.00001f, inf,
+		-inf, 1e-30f, -3e38f };
+
+	for (size_t size : { 1u, 3u, 4u, 7u, 13u, 1'001u }) {
+		std::vector<float> in(size);
+		for (size_t i = 0; i < size; ++i) {
+			in[i] = i % 3 == 0 ? specials[i / 3 % std::size(specials)]
+							   : float(int(i * 7919 % 2001) - 1000) * 0.001f;
+		}
+
+		for (float drive : { 1.f, 20.f, 100.f }) {
+			constexpr float norm = 0.68f;
+			constexpr float atten = 0.14f;
+			std::vector<float> out = in;
+			wsay::distort(wsay::atan_e::poly, drive, norm, atten, out);
+			for (size_t i = 0; i < size; ++i) {
+				const float expected
+						= wsay::atan_poly(drive * in[i]) * norm * atten;
+				EXPECT_EQ(out[i], expected)
+						<< "input " << in[i] << ", drive " << drive;
+			}
+		}
+	}
+
+	// NaNs stay NaNs.
+	std::vector<float> nans(8, std::numeric_limits<float>::quiet_NaN());
+	wsay::distort(wsay::atan_e::poly, 1.f, 1.f, 1.f, nans);
+	for (float f : nans) {
+		EXPECT_TRUE(std::isnan(f));
+	}
+}
+} // namespace
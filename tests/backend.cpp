@@ -0,0 +1,87 @@
+#include "private_include/backend.hpp"
+#include "wsay/engine.hpp"
+#include "wsay/voice.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<char> read_file(const std::filesystem::path& path) {
+	std::ifstream ifs{ path, std::ios::binary };
+	return { std::istreambuf_iterator<char>{ ifs },
+		std::istreambuf_iterator<char>{} };
+}
+
+// Every output reads the one buffer, none copies it.
+TEST(backend, shared_pcm) {
+	constexpr size_t num_devices = 3;
+	constexpr size_t num_files = 3;
+	std::unique_ptr<wsay::backend> platform
+			= wsay::make_headless_backend(wsay::headless_options{
+					.synth_rtf = 0.0,
+					.realtime_devices = true,
+					.num_devices = num_devices,
+			});
+
+	const wsay::voice vopts;
+	std::vector<std::filesystem::path> paths;
+	std::vector<std::unique_ptr<wsay::audio_sink>> sinks;
+	for (size_t i = 0; i < num_devices; ++i) {
+		sinks.push_back(platform->make_sink(vopts,
+				{
+						.type = wsay::output_type_e::device,
+						.device_idx = i,
+						.file_path = {},
+				}));
+	}
+	for (size_t i = 0; i < num_files; ++i) {
+		paths.push_back(std::filesystem::temp_directory_path()
+				/ ("wsay_shared_pcm" + std::to_string(i) + ".wav"));
+		sinks.push_back(platform->make_sink(vopts,
+				{
+						.type = wsay::output_type_e::file,
+						.device_idx = (std::numeric_limits<size_t>::max)(),
+						.file_path = paths.back(),
+				}));
+	}
+
+	// 50ms at 44.1kHz, 16 bits.
+	std::vector<std::byte> bytes(4'410);
+	for (size_t i = 0; i < bytes.size(); ++i) {
+		bytes[i] = std::byte(i * 7);
+	}
+	const wsay::shared_pcm pcm
+			= std::make_shared<const std::vector<std::byte>>(bytes);
+	const std::byte* data = pcm->data();
+
+	for (std::unique_ptr<wsay::audio_sink>& sink : sinks) {
+		sink->play(pcm, false);
+	}
+	// Devices hold the buffer while playing, files are done with it.
+	EXPECT_EQ(pcm.use_count(), long(1 + num_devices));
+	EXPECT_EQ(pcm->data(), data);
+
+	for (std::unique_ptr<wsay::audio_sink>& sink : sinks) {
+		sink->wait();
+	}
+	EXPECT_EQ(pcm.use_count(), 1);
+
+	// Closes the files.
+	sinks.clear();
+	const std::vector<char> first = read_file(paths.front());
+	ASSERT_EQ(first.size(), 44 + bytes.size());
+	EXPECT_EQ(std::memcmp(first.data() + 44, bytes.data(), bytes.size()), 0);
+	for (const std::filesystem::path& path : paths) {
+		EXPECT_EQ(read_file(path), first) << path;
+		std::filesystem::remove(path);
+	}
+}
+} // namespace
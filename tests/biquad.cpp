@@ -0,0 +1,116 @@
+#include "private_include/biquad.hpp"
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <numbers>
+#include <span>
+#include <vector>
+
+namespace {
+// Every type, at various frequencies.
+constexpr std::array<wsay::biquad_args, wsay::biquad_max_sections> sections{
+	wsay::biquad_args{ wsay::biquad_type_e::highpass, 0.01f, 0.7f, 0.f },
+	wsay::biquad_args{ wsay::biquad_type_e::peaking, 0.08f, 1.5f, 6.f },
+	wsay::biquad_args{ wsay::biquad_type_e::lowshelf, 0.05f, 0.7f, -4.f },
+	wsay::biquad_args{ wsay::biquad_type_e::highshelf, 0.2f, 0.7f, 3.f },
+	wsay::biquad_args{ wsay::biquad_type_e::notch, 0.1f, 4.f, 0.f },
+	wsay::biquad_args{ wsay::biquad_type_e::bandbass, 0.04f, 0.5f, 0.f },
+	wsay::biquad_args{ wsay::biquad_type_e::peaking, 0.15f, 2.f, -8.f },
+	wsay::biquad_args{ wsay::biquad_type_e::lowpass, 0.3f, 0.7f, 0.f },
+};
+
+std::vector<float> make_signal(size_t size) {
+	std::vector<float> ret(size);
+	uint32_t x = 1;
+	for (float& f : ret) {
+		x = x * 1'664'525u + 1'013'904'223u;
+		f = float(int32_t(x)) / 2147483648.f * 0.5f;
+	}
+	return ret;
+}
+
+// The section magnitude response at normalized frequency freq, in dB.
+double gain_db(const wsay::biquad_coefs& c, double freq) {
+	const std::complex<double> z1
+			= std::polar(1.0, -2.0 * std::numbers::pi * freq);
+	const std::complex<double> z2 = z1 * z1;
+	const std::complex<double> h
+			= (double(c.a0) + double(c.a1) * z1 + double(c.a2) * z2)
+			/ (1.0 + double(c.b1) * z1 + double(c.b2) * z2);
+	return 20.0 * std::log10(std::abs(h));
+}
+
+// The lane pipelined path, filling and draining its lanes on every block,
+// must match the sections run one after the other.
+TEST(biquad, cascade_paths) {
+	// Not multiples of the 4 lanes, fed back to back to carry state.
+	constexpr size_t block_sizes[] = { 1, 2, 3, 5, 7, 13, 255, 1'001 };
+	size_t total = 0;
+	for (size_t size : block_sizes) {
+		total += size;
+	}
+	const std::vector<float> signal = make_signal(total);
+
+	for (size_t num_sections = 1; num_sections <= sections.size();
+			++num_sections) {
+		const std::span<const wsay::biquad_args> args{ sections.data(),
+			num_sections };
+
+		// Reference, each section over the whole signal in turn.
+		std::vector<float> expected = signal;
+		for (const wsay::biquad_args& a : args) {
+			wsay::biquad_state state;
+			wsay::biquad(wsay::make_biquad_coefs(a), state, expected);
+		}
+
+		for (wsay::simd_e path : { wsay::simd_e::scalar, wsay::simd_e::sse2,
+					 wsay::simd_e::avx2 }) {
+			if (!wsay::simd_available(path)) {
+				continue;
+			}
+
+			wsay::biquad_cascade cascade{ args };
+			EXPECT_EQ(cascade.size(), num_sections);
+			std::vector<float> out = signal;
+			size_t pos = 0;
+			for (size_t size : block_sizes) {
+				cascade.process(path, std::span{ out }.subspan(pos, size));
+				pos += size;
+			}
+			EXPECT_EQ(out, expected) << "path " << size_t(path) << ", "
+									 << num_sections << " sections";
+		}
+	}
+}
+
+TEST(biquad, response) {
+	for (float freq : { 0.01f, 0.05f, 0.1f, 0.25f, 0.4f }) {
+		for (float gain : { -24.f, -6.f, -1.f, 1.f, 6.f, 24.f }) {
+			// Peaking reaches the gain at its center, is flat elsewhere.
+			for (float q : { 0.5f, 0.707f, 2.f, 8.f }) {
+				const wsay::biquad_coefs c = wsay::make_biquad_coefs(
+						{ wsay::biquad_type_e::peaking, freq, q, gain });
+				EXPECT_NEAR(gain_db(c, freq), gain, 0.01)
+						<< "freq " << freq << ", q " << q;
+				EXPECT_NEAR(gain_db(c, 0.0), 0.0, 0.01);
+				EXPECT_NEAR(gain_db(c, 0.5), 0.0, 0.01);
+			}
+
+			// Shelves reach the gain on their side, are flat on the other.
+			const wsay::biquad_coefs low = wsay::make_biquad_coefs(
+					{ wsay::biquad_type_e::lowshelf, freq, 0.707f, gain });
+			EXPECT_NEAR(gain_db(low, 0.0), gain, 0.01) << "freq " << freq;
+			EXPECT_NEAR(gain_db(low, 0.5), 0.0, 0.01) << "freq " << freq;
+
+			const wsay::biquad_coefs high = wsay::make_biquad_coefs(
+					{ wsay::biquad_type_e::highshelf, freq, 0.707f, gain });
+			EXPECT_NEAR(gain_db(high, 0.0), 0.0, 0.01) << "freq " << freq;
+			EXPECT_NEAR(gain_db(high, 0.5), gain, 0.01) << "freq " << freq;
+		}
+	}
+}
+} // namespace
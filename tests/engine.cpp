@@ -0,0 +1,726 @@
+#include <chrono>
+#include <filesystem>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <wsay/engine.hpp>
+#include <wsay/voice.hpp>
+
+namespace {
+const std::wstring test_text = L"The quick brown fox jumps over the lazy dog. "
+							   L"Pack my box with five dozen liquor jugs! "
+							   L"<silence msec=\"250\"/> How vexingly quick "
+							   L"daft zebras jump?";
+
+std::vector<char> read_file(const std::filesystem::path& path) {
+	std::ifstream ifs{ path, std::ios::binary };
+	return { std::istreambuf_iterator<char>{ ifs },
+		std::istreambuf_iterator<char>{} };
+}
+
+std::filesystem::path temp_path(const char* name) {
+	return std::filesystem::temp_directory_path() / name;
+}
+
+// Starts right away, runs to completion.
+struct co_task {
+	struct promise_type {
+		co_task get_return_object() {
+			return {};
+		}
+		std::suspend_never initial_suspend() noexcept {
+			return {};
+		}
+		std::suspend_never final_suspend() noexcept {
+			return {};
+		}
+		void return_void() {
+		}
+		void unhandled_exception() {
+			std::terminate();
+		}
+	};
+};
+
+co_task speak_all(wsay::engine& e, wsay::async_token& tok,
+		std::vector<wsay::speak_status_e>& statuses, std::promise<void>& done) {
+	for (const wchar_t* text : { L"One.", L"Two.", L"Three." }) {
+		const wsay::speak_result result = co_await e.speak_co(text, tok,
+				wsay::speak_priority_e::normal, wsay::speak_policy_e::append);
+		statuses.push_back(result.status);
+	}
+	done.set_value();
+}
+
+// Waiting on the token from its own thread throws, rather than hang.
+co_task speak_then_wait(wsay::engine& e, wsay::async_token& tok,
+		bool& threw, std::promise<void>& done) {
+	co_await e.speak_co(L"One.", tok);
+	co_await e.speak_co(L"Two.", tok);
+	try {
+		e.wait(tok);
+	} catch (const std::logic_error&) {
+		threw = true;
+	}
+	done.set_value();
+}
+
+TEST(engine, headless_deterministic) {
+	wsay::engine e{ wsay::headless_options{} };
+	ASSERT_FALSE(e.voices().empty());
+	ASSERT_FALSE(e.devices().empty());
+
+	const std::filesystem::path path1 = temp_path("wsay_headless1.wav");
+	const std::filesystem::path path2 = temp_path("wsay_headless2.wav");
+	for (size_t i = 0; i < wsay::radio_preset_count(); ++i) {
+		wsay::voice vopts;
+		vopts.radio_effect(wsay::radio_preset_e(i));
+		vopts.radio_effect_seed = 42;
+
+		wsay::voice vopts1 = vopts;
+		vopts1.add_output_file(path1);
+		wsay::voice vopts2 = vopts;
+		vopts2.add_output_file(path2);
+		vopts2.add_output_device(0);
+
+		e.speak(vopts1, test_text);
+		e.speak(vopts2, test_text);
+
+		std::vector<char> wav1 = read_file(path1);
+		std::vector<char> wav2 = read_file(path2);
+		// Header and a few seconds of audio.
+		EXPECT_GT(wav1.size(), 44u + 44'100u);
+		EXPECT_EQ(wav1, wav2);
+	}
+	std::filesystem::remove(path1);
+	std::filesystem::remove(path2);
+}
+
+TEST(engine, headless_pipeline) {
+	wsay::engine e{ wsay::headless_options{} };
+	const std::filesystem::path path1 = temp_path("wsay_pipeline1.wav");
+	const std::filesystem::path path2 = temp_path("wsay_pipeline2.wav");
+
+	wsay::voice vopts1;
+	vopts1.add_output_file(path1);
+	wsay::voice vopts2;
+	vopts2.sentence_pipeline = true;
+	vopts2.add_output_file(path2);
+
+	EXPECT_EQ(e.speak(vopts1, test_text).chunks, 1u);
+	EXPECT_GT(e.speak(vopts2, test_text).chunks, 1u);
+
+	// Without effects, sentences synthesize the same on their own.
+	EXPECT_EQ(read_file(path1), read_file(path2));
+	std::filesystem::remove(path1);
+	std::filesystem::remove(path2);
+}
+
+TEST(engine, headless_stream) {
+	wsay::engine e{ wsay::headless_options{} };
+	const std::filesystem::path path1 = temp_path("wsay_stream1.wav");
+	const std::filesystem::path path2 = temp_path("wsay_stream2.wav");
+
+	for (size_t i = 0; i <= wsay::radio_preset_count(); ++i) {
+		wsay::voice vopts1;
+		if (i != wsay::radio_preset_count()) {
+			vopts1.radio_effect(wsay::radio_preset_e(i));
+		}
+		vopts1.radio_effect_seed = 42;
+		wsay::voice vopts2 = vopts1;
+		vopts2.stream_synthesis = true;
+		vopts1.add_output_file(path1);
+		vopts2.add_output_file(path2);
+
+		e.speak(vopts1, test_text);
+		EXPECT_EQ(e.speak(vopts2, test_text).chunks, 1u);
+		EXPECT_EQ(read_file(path1), read_file(path2));
+	}
+	std::filesystem::remove(path1);
+	std::filesystem::remove(path2);
+
+	// Audio comes out long before synthesis is done.
+	wsay::engine slow{ wsay::headless_options{ .synth_rtf = 0.05 } };
+	wsay::voice vopts;
+	vopts.add_output_device(0);
+	const wsay::speak_timings whole = slow.speak(vopts, test_text);
+	vopts.stream_synthesis = true;
+	const wsay::speak_timings streamed = slow.speak(vopts, test_text);
+	EXPECT_EQ(streamed.bytes, whole.bytes);
+	EXPECT_LT(streamed.time_to_first_audio * 4, whole.time_to_first_audio);
+}
+
+TEST(engine, render_cache) {
+	wsay::engine e{ wsay::headless_options{} };
+	const std::filesystem::path path1 = temp_path("wsay_cache1.wav");
+	const std::filesystem::path path2 = temp_path("wsay_cache2.wav");
+
+	wsay::voice vopts1;
+	vopts1.radio_effect(wsay::radio_preset_e::radio3);
+	vopts1.radio_effect_seed = 42;
+	vopts1.add_output_file(path1);
+	wsay::voice vopts2 = vopts1;
+	vopts2.add_output_file(path2);
+
+	// Disabled by default.
+	EXPECT_FALSE(e.speak(vopts1, test_text).cached);
+	EXPECT_EQ(e.cache_stats().misses, 0u);
+
+	e.cache_budget(16 * 1024 * 1024);
+	EXPECT_FALSE(e.speak(vopts1, test_text).cached);
+	// Outputs aren't part of the key.
+	EXPECT_TRUE(e.speak(vopts2, test_text).cached);
+	EXPECT_EQ(read_file(path1), read_file(path2));
+
+	// Audio options are.
+	wsay::voice vopts3 = vopts1;
+	vopts3.speed = 60;
+	EXPECT_FALSE(e.speak(vopts3, test_text).cached);
+	EXPECT_FALSE(e.speak(vopts1, L"Please hold.").cached);
+
+	wsay::render_cache_stats stats = e.cache_stats();
+	EXPECT_EQ(stats.hits, 1u);
+	EXPECT_EQ(stats.misses, 3u);
+	EXPECT_EQ(stats.entries, 3u);
+	EXPECT_LE(stats.bytes, stats.budget);
+
+	// The least recently used render goes first.
+	EXPECT_TRUE(e.speak(vopts1, test_text).cached);
+	e.cache_budget(stats.bytes - 1);
+	EXPECT_EQ(e.cache_stats().entries, 2u);
+	EXPECT_TRUE(e.speak(vopts1, test_text).cached);
+	EXPECT_FALSE(e.speak(vopts3, test_text).cached);
+
+	e.invalidate_cache();
+	stats = e.cache_stats();
+	EXPECT_EQ(stats.entries, 0u);
+	EXPECT_EQ(stats.bytes, 0u);
+	EXPECT_FALSE(e.speak(vopts1, test_text).cached);
+
+	std::filesystem::remove(path1);
+	std::filesystem::remove(path2);
+}
+
+TEST(engine, reused_objects) {
+	const std::filesystem::path path1 = temp_path("wsay_reuse1.wav");
+	const std::filesystem::path path2 = temp_path("wsay_reuse2.wav");
+
+	wsay::voice vopts1;
+	vopts1.speed = 30;
+	vopts1.volume = 40;
+	vopts1.add_output_device(0);
+	vopts1.add_output_file(path1);
+
+	// Same voice and device, other speed, volume and effects.
+	wsay::voice vopts2;
+	vopts2.speed = 70;
+	vopts2.radio_effect(wsay::radio_preset_e::radio2);
+	vopts2.radio_effect_native_rate = true;
+	vopts2.radio_effect_seed = 1;
+	vopts2.add_output_device(0);
+
+	wsay::engine e{ wsay::headless_options{} };
+	wsay::voice vopts = vopts2;
+	vopts.add_output_file(path1);
+	e.speak(vopts1, test_text);
+	e.speak(vopts, test_text);
+
+	// Matches new objects.
+	wsay::engine fresh{ wsay::headless_options{} };
+	vopts = vopts2;
+	vopts.add_output_file(path2);
+	fresh.speak(vopts, test_text);
+
+	EXPECT_EQ(read_file(path1), read_file(path2));
+	std::filesystem::remove(path1);
+	std::filesystem::remove(path2);
+}
+
+TEST(engine, speak_batch) {
+	wsay::engine e{ wsay::headless_options{} };
+
+	std::vector<wsay::speak_job> jobs;
+	std::vector<std::filesystem::path> expected;
+	for (size_t i = 0; i < 24; ++i) {
+		wsay::speak_job job;
+		job.vopts.voice_idx = i % e.voices().size();
+		job.vopts.speed = uint8_t(40 + i);
+		if (i % 3 != 0) {
+			job.vopts.radio_effect(
+					wsay::radio_preset_e(i % wsay::radio_preset_count()));
+			job.vopts.radio_effect_seed = i;
+		}
+		job.text = test_text.substr(0, 40 + i * 5);
+
+		// Reference render.
+		const std::filesystem::path path = temp_path(
+				("wsay_batch_expected" + std::to_string(i) + ".wav").c_str());
+		wsay::voice vopts = job.vopts;
+		vopts.add_output_file(path);
+		e.speak(vopts, job.text);
+		expected.push_back(path);
+
+		job.vopts.add_output_file(
+				temp_path(("wsay_batch" + std::to_string(i) + ".wav").c_str()));
+		jobs.push_back(std::move(job));
+	}
+
+	// Errors stay in their job.
+	wsay::speak_job bad = jobs.front();
+	bad.vopts.voice_idx = e.voices().size();
+	jobs.insert(jobs.begin() + 5, bad);
+	expected.insert(expected.begin() + 5, std::filesystem::path{});
+
+	wsay::speak_batch_result result = e.speak_batch(jobs, 4);
+	EXPECT_EQ(result.num_workers, 4u);
+	ASSERT_EQ(result.jobs.size(), jobs.size());
+	EXPECT_GT(result.audio_seconds, 0.0);
+	EXPECT_GT(result.realtime_factor(), 0.0);
+
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		const std::filesystem::path& path
+				= jobs[i].vopts.outputs()[0].file_path;
+		if (i == 5) {
+			EXPECT_FALSE(result.jobs[i].ok);
+			EXPECT_FALSE(result.jobs[i].error.empty());
+			continue;
+		}
+
+		EXPECT_TRUE(result.jobs[i].ok) << result.jobs[i].error;
+		EXPECT_EQ(read_file(path), read_file(expected[i]));
+		std::filesystem::remove(path);
+		std::filesystem::remove(expected[i]);
+	}
+}
+
+TEST(engine, async_queue) {
+	wsay::engine e{ wsay::headless_options{ .synth_rtf = 0.05 } };
+	const std::filesystem::path path = temp_path("wsay_queue.wav");
+
+	// Pcm of a text spoken on its own.
+	auto render = [&](const std::wstring& text) {
+		wsay::voice vopts;
+		vopts.add_output_file(path);
+		e.speak(vopts, text);
+		std::vector<char> ret = read_file(path);
+		ret.erase(ret.begin(), ret.begin() + 44);
+		return ret;
+	};
+	std::vector<char> expected;
+	for (const wchar_t* text :
+			{ test_text.c_str(), L"High.", L"Normal.", L"Low." }) {
+		const std::vector<char> pcm = render(text);
+		expected.insert(expected.end(), pcm.begin(), pcm.end());
+	}
+
+	{
+		wsay::voice vopts;
+		vopts.add_output_file(path);
+		wsay::async_token tok = e.make_async_token(vopts);
+
+		// Speaks for a while, the next ones queue.
+		using wsay::speak_policy_e;
+		using wsay::speak_priority_e;
+		EXPECT_TRUE(e.speak_async(test_text, tok, speak_priority_e::normal,
+				speak_policy_e::append));
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+		e.speak_async(L"Dropped.", tok, speak_priority_e::normal,
+				speak_policy_e::append);
+		e.speak_async(L"Normal.", tok, speak_priority_e::normal,
+				speak_policy_e::replace_pending);
+		e.speak_async(L"Low.", tok, speak_priority_e::low,
+				speak_policy_e::append);
+		e.speak_async(L"High.", tok, speak_priority_e::high,
+				speak_policy_e::append);
+		e.wait(tok);
+
+		const wsay::speak_queue_stats stats = tok.queue_stats();
+		EXPECT_EQ(stats.dropped, 1u);
+		EXPECT_EQ(stats.interrupted, 0u);
+		EXPECT_EQ(stats.first_audio[size_t(speak_priority_e::low)].count, 1u);
+		EXPECT_EQ(
+				stats.first_audio[size_t(speak_priority_e::normal)].count, 2u);
+		EXPECT_EQ(stats.first_audio[size_t(speak_priority_e::high)].count, 1u);
+
+		// The low priority utterance waited on all others.
+		EXPECT_GT(stats.first_audio[size_t(speak_priority_e::low)].max,
+				stats.first_audio[size_t(speak_priority_e::high)].max);
+	}
+	std::vector<char> wav = read_file(path);
+	wav.erase(wav.begin(), wav.begin() + 44);
+	EXPECT_EQ(wav, expected);
+	std::filesystem::remove(path);
+
+	// Alerts cut in.
+	wsay::voice vopts;
+	vopts.add_output_device(0);
+	wsay::async_token tok = e.make_async_token(vopts);
+	e.speak_async(test_text + test_text, tok, wsay::speak_priority_e::normal,
+			wsay::speak_policy_e::append);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	e.speak_async(L"Alert!", tok, wsay::speak_priority_e::high);
+	e.wait(tok);
+
+	const wsay::speak_queue_stats stats = tok.queue_stats();
+	EXPECT_EQ(stats.interrupted, 1u);
+	EXPECT_EQ(stats.first_audio[size_t(wsay::speak_priority_e::high)].count,
+			1u);
+	EXPECT_LT(stats.first_audio[size_t(wsay::speak_priority_e::high)].max,
+			std::chrono::milliseconds(200));
+	EXPECT_EQ(tok.timings().bytes, render(L"Alert!").size());
+}
+
+TEST(engine, async_completion) {
+	using wsay::speak_policy_e;
+	using wsay::speak_priority_e;
+	using wsay::speak_status_e;
+
+	wsay::engine e{ wsay::headless_options{ .synth_rtf = 0.05 } };
+	wsay::voice vopts;
+	vopts.add_output_device(0);
+	wsay::async_token tok = e.make_async_token(vopts);
+
+	// Callbacks.
+	std::vector<speak_status_e> statuses(3, speak_status_e::count);
+	size_t alert_bytes = 0;
+	e.speak_async(test_text, tok, speak_priority_e::normal,
+			speak_policy_e::append,
+			[&](const wsay::speak_result& r) { statuses[0] = r.status; });
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	e.speak_async(L"Pending.", tok, speak_priority_e::normal,
+			speak_policy_e::append,
+			[&](const wsay::speak_result& r) { statuses[1] = r.status; });
+	e.speak_async(L"Alert!", tok, speak_priority_e::high,
+			speak_policy_e::interrupt, [&](const wsay::speak_result& r) {
+				statuses[2] = r.status;
+				alert_bytes = r.timings.bytes;
+			});
+	e.wait(tok);
+	EXPECT_EQ(statuses[0], speak_status_e::interrupted);
+	EXPECT_EQ(statuses[1], speak_status_e::dropped);
+	EXPECT_EQ(statuses[2], speak_status_e::done);
+	EXPECT_GT(alert_bytes, 0u);
+
+	// Futures.
+	std::future<wsay::speak_result> f = e.speak_future(L"Future.", tok);
+	const wsay::speak_result result = f.get();
+	EXPECT_EQ(result.status, speak_status_e::done);
+	EXPECT_GT(result.timings.bytes, 0u);
+
+	// Coroutines, resumed by the token.
+	std::vector<speak_status_e> co_statuses;
+	std::promise<void> co_done;
+	speak_all(e, tok, co_statuses, co_done);
+	ASSERT_EQ(co_done.get_future().wait_for(std::chrono::seconds(10)),
+			std::future_status::ready);
+	EXPECT_EQ(co_statuses,
+			std::vector<speak_status_e>(3, speak_status_e::done));
+
+	bool threw = false;
+	std::promise<void> wait_done;
+	speak_then_wait(e, tok, threw, wait_done);
+	ASSERT_EQ(wait_done.get_future().wait_for(std::chrono::seconds(10)),
+			std::future_status::ready);
+	EXPECT_TRUE(threw);
+	e.wait(tok);
+
+	// One thread drives many utterances.
+	wsay::engine fast{ wsay::headless_options{} };
+	std::vector<wsay::async_token> toks;
+	for (size_t i = 0; i < 8; ++i) {
+		toks.push_back(fast.make_async_token(vopts, 32));
+	}
+	std::vector<std::future<wsay::speak_result>> futures;
+	for (size_t i = 0; i < 256; ++i) {
+		futures.push_back(fast.speak_future(L"Please hold.", toks[i % 8],
+				speak_priority_e::normal, speak_policy_e::append));
+	}
+	for (std::future<wsay::speak_result>& fut : futures) {
+		EXPECT_EQ(fut.get().status, speak_status_e::done);
+	}
+}
+
+TEST(engine, headless_stop) {
+	wsay::engine e{ wsay::headless_options{
+			.synth_rtf = 0.05,
+			.realtime_devices = true,
+	} };
+
+	wsay::voice vopts;
+	vopts.add_output_device(0);
+	vopts.add_output_device(1);
+	wsay::async_token tok = e.make_async_token(vopts);
+
+	// Several seconds of audio.
+	const auto start = std::chrono::steady_clock::now();
+	e.speak_async(test_text, tok);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	e.stop(tok);
+	EXPECT_LT(
+			std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+}
+
+// Every output of an utterance gets the same audio.
+TEST(engine, many_outputs) {
+	wsay::engine e{ wsay::headless_options{
+			.synth_rtf = 0.0,
+			.realtime_devices = false,
+			.num_devices = 3,
+	} };
+
+	std::vector<std::filesystem::path> paths;
+	wsay::voice vopts;
+	vopts.radio_effect(wsay::radio_preset_e(0));
+	vopts.radio_effect_seed = 42;
+	for (const char* name : { "wsay_outputs1.wav", "wsay_outputs2.wav",
+				 "wsay_outputs3.wav", "wsay_outputs4.wav" }) {
+		paths.push_back(temp_path(name));
+		vopts.add_output_file(paths.back());
+	}
+	for (size_t i = 0; i < 3; ++i) {
+		vopts.add_output_device(i);
+	}
+
+	for (bool pipeline : { false, true }) {
+		vopts.sentence_pipeline = pipeline;
+		// The second one plays from the cache.
+		for (size_t i = 0; i < 2; ++i) {
+			e.speak(vopts, test_text);
+			const std::vector<char> first = read_file(paths.front());
+			EXPECT_GT(first.size(), 44u + 44'100u);
+			for (const std::filesystem::path& path : paths) {
+				EXPECT_EQ(read_file(path), first) << path;
+			}
+		}
+	}
+	for (const std::filesystem::path& path : paths) {
+		std::filesystem::remove(path);
+	}
+}
+
+// Native rate files are written at the preset rate, same duration.
+TEST(engine, native_rate_file) {
+	const std::filesystem::path path = temp_path("wsay_native_rate.wav");
+	auto read_u32 = [](const std::vector<char>& wav, size_t pos) {
+		uint32_t ret = 0;
+		std::memcpy(&ret, wav.data() + pos, sizeof(ret));
+		return ret;
+	};
+
+	wsay::engine e{ wsay::headless_options{} };
+	wsay::voice full;
+	full.radio_effect(wsay::radio_preset_e::radio1);
+	full.add_output_file(path);
+	e.speak(full, test_text);
+	const std::vector<char> full_wav = read_file(path);
+	ASSERT_GT(full_wav.size(), 44u);
+	EXPECT_EQ(read_u32(full_wav, 24), 44'100u);
+	const double full_seconds = double(read_u32(full_wav, 40)) / 2.0 / 44'100.0;
+
+	// radio 1 runs at 8kHz, radio 4 at 22kHz.
+	const std::pair<wsay::radio_preset_e, uint32_t> presets[] = {
+		{ wsay::radio_preset_e::radio1, 8'000 },
+		{ wsay::radio_preset_e::radio4, 22'050 },
+	};
+	for (auto [preset, rate] : presets) {
+		wsay::voice vopts;
+		vopts.radio_effect(preset);
+		vopts.radio_effect_native_rate = true;
+		vopts.add_output_file(path);
+		e.speak(vopts, test_text);
+
+		const std::vector<char> wav = read_file(path);
+		ASSERT_GT(wav.size(), 44u);
+		EXPECT_EQ(read_u32(wav, 24), rate);
+		// 16 bits, mono.
+		EXPECT_EQ(read_u32(wav, 28), rate * 2);
+		EXPECT_EQ(read_u32(wav, 40), wav.size() - 44);
+		EXPECT_NEAR(double(wav.size() - 44) / 2.0 / double(rate), full_seconds,
+				1.0 / double(rate));
+	}
+	std::filesystem::remove(path);
+}
+
+TEST(engine, preset_file) {
+	const std::filesystem::path preset = temp_path("wsay_preset.ini");
+	const std::filesystem::path path = temp_path("wsay_preset.wav");
+	auto write_preset = [&](const char* gain) {
+		std::ofstream ofs{ preset };
+		ofs << "[radio]\nbit_depth = 8\nsampling_rate = 11025\ngain = "
+			<< gain << "\n[biquad]\ntype = bandpass\nfreq = 0.1\n";
+	};
+
+	wsay::engine e{ wsay::headless_options{} };
+	e.cache_budget(64 * 1024 * 1024);
+	wsay::voice vopts;
+	vopts.radio_effect(preset);
+	vopts.radio_effect_seed = 42;
+	vopts.add_output_file(path);
+
+	auto render = [&]() {
+		e.speak(vopts, test_text);
+		return read_file(path);
+	};
+	write_preset("1");
+	const std::vector<char> first = render();
+	EXPECT_EQ(render(), first);
+	EXPECT_EQ(e.cache_stats().hits, 1u);
+
+	// Edited presets render again.
+	write_preset("0.5");
+	const std::vector<char> edited = render();
+	EXPECT_NE(edited, first);
+	EXPECT_EQ(e.cache_stats().hits, 1u);
+
+	// Renders read the file parsed when the token was made, not the disk.
+	{
+		wsay::async_token tok = e.make_async_token(vopts);
+		std::filesystem::remove(preset);
+		e.speak_async(test_text, tok);
+		e.wait(tok);
+	}
+	EXPECT_EQ(read_file(path), edited);
+	EXPECT_THROW(e.speak(vopts, test_text), std::invalid_argument);
+	std::filesystem::remove(path);
+}
+
+TEST(engine, stats) {
+	// Percentiles are accurate to a bucket.
+	wsay::duration_histogram h;
+	for (int i = 1; i <= 1000; ++i) {
+		h.add(std::chrono::microseconds(i * 100));
+	}
+	EXPECT_EQ(h.count, 1000u);
+	EXPECT_EQ(h.max, std::chrono::milliseconds(100));
+	EXPECT_GE(h.percentile(50.0), std::chrono::milliseconds(50));
+	EXPECT_LE(h.percentile(50.0), std::chrono::milliseconds(60));
+	EXPECT_GE(h.percentile(99.0), std::chrono::microseconds(99'000));
+	EXPECT_LE(h.percentile(99.0), h.max);
+	EXPECT_EQ(h.percentile(100.0), h.max);
+	EXPECT_EQ(wsay::duration_histogram{}.percentile(50.0),
+			std::chrono::steady_clock::duration{});
+
+	wsay::engine e{ wsay::headless_options{ .synth_rtf = 0.01 } };
+	wsay::voice vopts;
+	vopts.radio_effect(wsay::radio_preset_e::radio1);
+	vopts.add_output_device(0);
+
+	// Nothing is timed by default.
+	e.speak(vopts, test_text);
+	EXPECT_EQ(e.stats().utterances.count, 0u);
+
+	e.collect_stats(true);
+	const wsay::speak_timings t = e.speak(vopts, test_text);
+	vopts.stream_synthesis = true;
+	e.speak(vopts, test_text);
+
+	wsay::async_token tok = e.make_async_token(vopts);
+	e.speak_async(test_text, tok);
+	e.wait(tok);
+
+	const wsay::engine_stats stats = e.stats();
+	EXPECT_EQ(stats.utterances.count, 3u);
+	EXPECT_EQ(stats.bytes, 3 * t.bytes);
+	EXPECT_GT(stats.audio_seconds, 0.0);
+	EXPECT_GT(stats.realtime_factor(), 1.0);
+	for (const wsay::duration_histogram& stage : stats.stages) {
+		EXPECT_EQ(stage.count, 3u);
+	}
+	using wsay::speak_stage_e;
+	EXPECT_GT(stats.stages[size_t(speak_stage_e::synthesis)].total,
+			stats.stages[size_t(speak_stage_e::format)].total);
+	EXPECT_GT(stats.stages[size_t(speak_stage_e::fx)].total,
+			std::chrono::steady_clock::duration{});
+
+	e.reset_stats();
+	EXPECT_EQ(e.stats().utterances.count, 0u);
+	EXPECT_EQ(e.stats().bytes, 0u);
+}
+
+TEST(engine, stop_latency) {
+	// Minutes of audio, long effect passes and file writes.
+	std::wstring text;
+	for (size_t i = 0; i < 50; ++i) {
+		text += test_text;
+	}
+	const std::filesystem::path path = temp_path("wsay_stop.wav");
+
+	// The whole render, stopped files must be shorter.
+	uintmax_t full_size = 0;
+	{
+		wsay::engine e{ wsay::headless_options{} };
+		wsay::voice vopts;
+		vopts.radio_effect(wsay::radio_preset_e::radio1);
+		vopts.add_output_file(path);
+		e.speak(vopts, text);
+		full_size = std::filesystem::file_size(path);
+		std::filesystem::remove(path);
+	}
+
+	for (double synth_rtf : { 0.0, 0.05 }) {
+		wsay::engine e{ wsay::headless_options{
+				.synth_rtf = synth_rtf,
+				.realtime_devices = true,
+		} };
+		for (size_t mode = 0; mode < 3; ++mode) {
+			wsay::voice vopts;
+			vopts.radio_effect(wsay::radio_preset_e::radio1);
+			vopts.sentence_pipeline = mode == 1;
+			vopts.stream_synthesis = mode == 2;
+			vopts.add_output_device(0);
+			vopts.add_output_file(path);
+
+			{
+				wsay::async_token tok = e.make_async_token(vopts);
+				e.speak_async(text, tok);
+				std::this_thread::sleep_for(std::chrono::milliseconds(30));
+
+				const auto start = std::chrono::steady_clock::now();
+				e.stop(tok);
+				EXPECT_LT(std::chrono::steady_clock::now() - start,
+						std::chrono::milliseconds(250))
+						<< "rtf " << synth_rtf << ", mode " << mode;
+			}
+
+			// The file keeps a valid header, and only what was written
+			// before the stop.
+			EXPECT_GE(std::filesystem::file_size(path), 44u);
+			EXPECT_LT(std::filesystem::file_size(path), full_size / 2)
+					<< "rtf " << synth_rtf << ", mode " << mode;
+			std::filesystem::remove(path);
+		}
+	}
+
+	// Stopped before its pcm reaches the file, the utterance isn't written.
+	{
+		wsay::engine e{ wsay::headless_options{} };
+		wsay::voice vopts;
+		vopts.radio_effect(wsay::radio_preset_e::radio1);
+		vopts.add_output_file(path);
+		{
+			wsay::async_token tok = e.make_async_token(vopts);
+			e.speak_async(text, tok);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			e.stop(tok);
+
+			// The next utterance is written in full.
+			e.speak_async(L"Over.", tok);
+			e.wait(tok);
+		}
+		EXPECT_LT(std::filesystem::file_size(path), full_size / 2);
+		EXPECT_GT(std::filesystem::file_size(path), 44u);
+		std::filesystem::remove(path);
+	}
+}
+} // namespace
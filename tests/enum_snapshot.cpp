@@ -0,0 +1,93 @@
+#include "private_include/enum_snapshot.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <optional>
+#include <string>
+
+namespace {
+std::filesystem::path snapshot_path() {
+	return std::filesystem::temp_directory_path()
+		 / "wsay_test_enumeration.bin";
+}
+
+TEST(enum_snapshot, roundtrip) {
+	const std::filesystem::path path = snapshot_path();
+	const wsay::enum_snapshot snap{
+		.signature = L"1d9a2b3c4d5e6f70 - 1d9a2b3c4d5e6f71 ",
+		.voice_ids = { L"HKEY_LOCAL_MACHINE\\Voices\\Tokens\\A",
+				L"HKEY_LOCAL_MACHINE\\Voices\\Tokens\\B" },
+		.voice_names = { L"Voice A", L"Voice \u00c9" },
+		.device_ids = { L"{0.0.0.00000000}.{guid}" },
+		.device_names = { L"Speakers" },
+		.default_device_id = L"{0.0.0.00000000}.{guid}",
+		.default_device_idx = 0,
+	};
+	ASSERT_TRUE(wsay::save_enum_snapshot(path, snap));
+
+	std::optional<wsay::enum_snapshot> loaded
+			= wsay::load_enum_snapshot(path, snap.signature);
+	ASSERT_TRUE(loaded.has_value());
+	EXPECT_EQ(loaded->voice_ids, snap.voice_ids);
+	EXPECT_EQ(loaded->voice_names, snap.voice_names);
+	EXPECT_EQ(loaded->device_ids, snap.device_ids);
+	EXPECT_EQ(loaded->device_names, snap.device_names);
+	EXPECT_EQ(loaded->default_device_id, snap.default_device_id);
+	EXPECT_EQ(loaded->default_device_idx, snap.default_device_idx);
+
+	// Voices or devices changed.
+	EXPECT_FALSE(wsay::load_enum_snapshot(path, L"other").has_value());
+
+	// Replaced whole.
+	wsay::enum_snapshot empty{
+		.signature = L"empty",
+		.voice_ids = {},
+		.voice_names = {},
+		.device_ids = {},
+		.device_names = {},
+		.default_device_id = {},
+		.default_device_idx = 0,
+	};
+	ASSERT_TRUE(wsay::save_enum_snapshot(path, empty));
+	loaded = wsay::load_enum_snapshot(path, L"empty");
+	ASSERT_TRUE(loaded.has_value());
+	EXPECT_TRUE(loaded->voice_names.empty());
+
+	std::filesystem::remove(path);
+	EXPECT_FALSE(wsay::load_enum_snapshot(path, L"empty").has_value());
+}
+
+TEST(enum_snapshot, corrupt) {
+	const std::filesystem::path path = snapshot_path();
+	const wsay::enum_snapshot snap{
+		.signature = L"sig",
+		.voice_ids = { L"a", L"b" },
+		.voice_names = { L"A", L"B" },
+		.device_ids = {},
+		.device_names = {},
+		.default_device_id = {},
+		.default_device_idx = 0,
+	};
+	ASSERT_TRUE(wsay::save_enum_snapshot(path, snap));
+	const size_t size = size_t(std::filesystem::file_size(path));
+
+	// Every truncation is rejected, rather than read past the end.
+	for (size_t i = 0; i < size; ++i) {
+		std::filesystem::resize_file(path, i);
+		EXPECT_FALSE(wsay::load_enum_snapshot(path, L"sig").has_value());
+		ASSERT_TRUE(wsay::save_enum_snapshot(path, snap));
+	}
+
+	// Garbage sizes.
+	{
+		std::ofstream ofs{ path, std::ios::binary | std::ios::in };
+		ofs.seekp(16 + 8 + 3 * sizeof(wchar_t));
+		const uint64_t huge = ~uint64_t(0);
+		ofs.write(reinterpret_cast<const char*>(&huge), sizeof(huge));
+	}
+	EXPECT_FALSE(wsay::load_enum_snapshot(path, L"sig").has_value());
+	std::filesystem::remove(path);
+}
+} // namespace
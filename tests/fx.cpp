@@ -0,0 +1,441 @@
+#include "private_include/fx_chain.hpp"
+#include "private_include/fx_presets.hpp"
+#include "private_include/pcm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <gtest/gtest.h>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+// Exercises every biquad type, runs at 22kHz.
+constexpr std::string_view test_preset = R"(
+[radio]
+bit_depth = 10
+sampling_rate = 22050
+dist_drive = 0.4
+noise_vol = 0.1
+gain = 2
+[biquad]
+type = highpass
+freq = 0.02
+q = 0.7
+[biquad]
+type = peaking
+freq = 0.08
+q = 1.5
+gain = 6
+[biquad]
+type = lowshelf
+freq = 0.05
+q = 0.7
+gain = -4
+[biquad]
+type = highshelf
+freq = 0.2
+q = 0.7
+gain = 3
+[biquad]
+type = notch
+freq = 0.1
+q = 4
+[biquad]
+type = lowpass
+freq = 0.3
+q = 0.7
+)";
+
+// Seconds of speech like input.
+std::vector<float> make_signal(size_t seconds = 3, size_t rate = 44'100) {
+	const size_t size = rate * seconds;
+	constexpr float two_pi = 2.f * std::numbers::pi_v<float>;
+	std::vector<float> ret(size);
+	for (size_t i = 0; i < size; ++i) {
+		const float t = float(i) / float(rate);
+		const float env = 0.5f + 0.5f * std::sin(two_pi * 3.f * t);
+		ret[i] = env
+				* (0.5f * std::sin(two_pi * 180.f * t)
+						+ 0.25f * std::sin(two_pi * 1'300.f * t)
+						+ 0.1f * std::sin(two_pi * 3'100.f * t));
+	}
+	return ret;
+}
+
+// The message of the error parsing ini throws, empty if it parses.
+std::string preset_error(std::string_view ini) {
+	try {
+		wsay::parse_fx_preset(ini);
+	} catch (const std::invalid_argument& e) {
+		return e.what();
+	}
+	return {};
+}
+
+struct fx_job {
+	wsay::voice vopts;
+	// Runtime preset, used when not empty.
+	std::vector<wsay::fx_args> args;
+	std::vector<float> expected;
+	// Split renders, their biquads differ slightly from the serial ones.
+	std::vector<float> expected_split;
+	std::vector<int16_t> expected_fixed;
+};
+
+std::vector<float> render(const fx_job& job, const std::vector<float>& in,
+		size_t num_threads) {
+	std::vector<float> ret = in;
+	if (!job.args.empty()) {
+		wsay::fx_engine engine{ job.vopts, job.args.front() };
+		std::vector<float> out;
+		engine.process(ret, out);
+		engine.flush(out);
+		return out;
+	}
+
+	if (num_threads > 1) {
+		wsay::process_fx(job.vopts, ret, num_threads);
+	} else {
+		wsay::process_fx(job.vopts, ret);
+	}
+	return ret;
+}
+
+std::vector<int16_t> render_fixed(
+		const fx_job& job, const std::vector<float>& in) {
+	std::vector<int16_t> ret(in.size());
+	std::transform(in.begin(), in.end(), ret.begin(),
+			[](float f) { return int16_t(std::lround(f * 32'767.f)); });
+
+	auto run = [&](wsay::fx_fixed_engine& engine) {
+		ret.resize(engine.process(ret));
+		engine.flush(ret);
+	};
+	if (!job.args.empty()) {
+		wsay::fx_fixed_engine engine{ job.vopts, job.args.front() };
+		run(engine);
+	} else {
+		wsay::fx_fixed_engine engine{ job.vopts };
+		run(engine);
+	}
+	return ret;
+}
+
+std::vector<fx_job> make_jobs() {
+	std::vector<fx_job> ret;
+	for (size_t i = 0; i <= wsay::radio_preset_count(); ++i) {
+		for (bool noise : { true, false }) {
+			for (bool native_rate : { false, true }) {
+				fx_job job;
+				if (i == wsay::radio_preset_count()) {
+					job.args.push_back(wsay::parse_fx_preset(test_preset));
+				} else {
+					job.vopts.radio_effect(wsay::radio_preset_e(i));
+				}
+				job.vopts.radio_effect_disable_whitenoise = !noise;
+				job.vopts.radio_effect_native_rate = native_rate;
+				job.vopts.radio_effect_seed = 42 + ret.size();
+				ret.push_back(std::move(job));
+			}
+		}
+	}
+	return ret;
+}
+
+// How far fx_fixed_engine is from fx_engine on pcm.
+struct fixed_error {
+	size_t size = 0;
+	size_t float_size = 0;
+	// In LSB.
+	long max = 0;
+	double rms_dbfs = 0.0;
+	// Samples over 16 LSB apart.
+	double far_fraction = 0.0;
+};
+
+template <class IntT>
+fixed_error measure_fixed(
+		const wsay::voice& vopts, const wsay::fx_args& args, size_t rate) {
+	const std::vector<float> signal = make_signal(5, rate);
+	std::vector<IntT> pcm(signal.size());
+	wsay::float_to_pcm(signal, std::span<IntT>{ pcm });
+
+	// Like process_fx, pcm to float and back.
+	std::vector<float> in(pcm.size());
+	wsay::pcm_to_float(std::span<const IntT>{ pcm }, in);
+	wsay::fx_engine engine{ vopts, args };
+	std::vector<float> out;
+	engine.process(in, out);
+	engine.flush(out);
+	std::vector<IntT> expected(out.size());
+	wsay::float_to_pcm(out, std::span<IntT>{ expected });
+
+	wsay::fx_fixed_engine fixed{ vopts, args };
+	pcm.resize(fixed.process(std::span<IntT>{ pcm }));
+	fixed.flush(pcm);
+
+	fixed_error ret;
+	ret.size = pcm.size();
+	ret.float_size = expected.size();
+	const size_t size = (std::min)(pcm.size(), expected.size());
+	double sum = 0.0;
+	size_t far = 0;
+	for (size_t i = 0; i < size; ++i) {
+		const long d = std::abs(long(pcm[i]) - long(expected[i]));
+		ret.max = (std::max)(ret.max, d);
+		sum += double(d) * double(d);
+		far += d > 16 ? 1 : 0;
+	}
+	const double full_scale = -double((std::numeric_limits<IntT>::min)());
+	ret.rms_dbfs = 20.0
+			* std::log10((std::max)(std::sqrt(sum / double(size)), 1e-9)
+					/ full_scale);
+	ret.far_fraction = double(far) / double(size);
+	return ret;
+}
+
+// The accuracy envelope documented on fx_fixed_engine.
+TEST(fx, fixed_matches_float) {
+	for (size_t i = 0; i < wsay::radio_preset_count(); ++i) {
+		const wsay::fx_args& preset
+				= wsay::radio_presets[wsay::radio_preset_e(i)];
+		std::vector<wsay::sampling_rate_e> rates{ wsay::sampling_rate_e::_44 };
+		if (preset.sampling_rate != rates.front()) {
+			rates.push_back(preset.sampling_rate);
+		}
+
+		for (wsay::sampling_rate_e rate : rates) {
+			for (bool noise : { true, false }) {
+				wsay::fx_args args = preset;
+				if (!noise) {
+					args.noise_vol = 0.f;
+				}
+				// Nothing moves the bit crusher input but rounding.
+				const bool exact
+						= rate == args.sampling_rate && args.noise_vol == 0.f;
+				const bool coarse = args.bit_depth <= 6;
+
+				wsay::voice vopts;
+				vopts.sampling_rate(rate);
+				vopts.radio_effect_seed = 42;
+				const std::string name = std::format("radio {}, {}Hz, noise {}",
+						i + 1, wsay::to_value(rate), noise);
+
+				vopts.bit_depth(wsay::bit_depth_e::_16);
+				const fixed_error e16 = measure_fixed<int16_t>(
+						vopts, args, wsay::to_value(rate));
+				EXPECT_EQ(e16.size, e16.float_size) << name;
+				if (exact) {
+					EXPECT_LE(e16.max, 4) << name;
+					EXPECT_LT(e16.rms_dbfs, -89.0) << name;
+				} else if (!coarse) {
+					EXPECT_LE(e16.max, 20) << name;
+					EXPECT_LT(e16.rms_dbfs, -80.0) << name;
+				} else {
+					EXPECT_LE(e16.far_fraction, 0.08) << name;
+					EXPECT_LT(e16.rms_dbfs, -36.0) << name;
+				}
+
+				vopts.bit_depth(wsay::bit_depth_e::_8);
+				const fixed_error e8 = measure_fixed<int8_t>(
+						vopts, args, wsay::to_value(rate));
+				EXPECT_EQ(e8.size, e8.float_size) << name;
+				if (exact || !coarse) {
+					EXPECT_LE(e8.max, 1) << name;
+				} else {
+					EXPECT_LT(e8.rms_dbfs, -30.0) << name;
+				}
+			}
+		}
+	}
+}
+
+TEST(fx, preset_errors) {
+	EXPECT_EQ(preset_error(test_preset), "");
+	EXPECT_EQ(preset_error(""), "");
+
+	struct bad_preset {
+		std::string_view ini;
+		// The line reported.
+		size_t line;
+	};
+	const bad_preset presets[] = {
+		// Unknown keys and sections.
+		{ "[radio]\nvolume = 1\n", 2 },
+		{ "[biquad]\ntype = lowpass\nslope = 1\n", 3 },
+		{ "[radio]\n[reverb]\n", 2 },
+		{ "gain = 1\n", 1 },
+		// Syntax.
+		{ "[radio]\nbit_depth 8\n", 2 },
+		{ "[radio\n", 1 },
+		{ "[radio]\nbit_depth = 8 bits\n", 2 },
+		{ "[radio]\nnoise_after_bitcrush = maybe\n", 2 },
+		{ "[biquad]\ntype = allpass\n", 2 },
+		// Ranges, comments and empty lines count.
+		{ "# Comment\n\n[radio]\nbit_depth = 1\n", 4 },
+		{ "[radio]\nbit_depth = 25\n", 2 },
+		{ "[radio]\nbit_depth = -8\n", 2 },
+		{ "[radio]\ngain = 101\n", 2 },
+		{ "[radio]\ndist_drive = 1.5\n", 2 },
+		{ "[biquad]\nfreq = 0.5\n", 2 },
+		{ "[biquad]\nfreq = 0\n", 2 },
+		{ "[biquad]\nq = 0\n", 2 },
+		{ "[biquad]\nq = -1\n", 2 },
+		{ "[biquad]\ngain = 48.5\n", 2 },
+		{ "[biquad]\ngain = -49\n", 2 },
+		{ "[radio]\nsampling_rate = 16000\n", 2 },
+		{ "[radio]\nsampling_rate = fast\n", 2 },
+		// Not finite.
+		{ "[radio]\ngain = nan\n", 2 },
+		{ "[radio]\nnoise_vol = inf\n", 2 },
+		{ "[biquad]\nfreq = nan\n", 2 },
+		{ "[biquad]\nq = nan\n", 2 },
+		{ "[biquad]\nq = inf\n", 2 },
+		{ "[biquad]\ngain = -inf\n", 2 },
+		// The biquads fill up on the 9th section.
+		{ "[biquad]\n[biquad]\n[biquad]\n[biquad]\n[biquad]\n[biquad]\n"
+		  "[biquad]\n[biquad]\n[biquad]\n",
+				9 },
+	};
+	static_assert(wsay::biquad_max_sections == 8);
+
+	for (const bad_preset& p : presets) {
+		const std::string error = preset_error(p.ini);
+		EXPECT_NE(error.find(std::format("line {} ", p.line)),
+				std::string::npos)
+				<< p.ini << "\n" << error;
+	}
+
+	// Checked once the sections are read.
+	EXPECT_NE(preset_error("[biquad]\nfreq = 0.1\n").find("missing its 'type'"),
+			std::string::npos);
+}
+
+// Streamed renders carry their state from one chunk to the next, they must
+// match whole buffer renders bit for bit.
+TEST(fx, chunked_matches_whole) {
+	constexpr size_t chunk_size = 777;
+	const std::vector<float> signal = make_signal();
+	for (const fx_job& job : make_jobs()) {
+		const std::vector<float> expected = render(job, signal, 1);
+
+		auto run = [&](wsay::fx_engine& engine) {
+			std::vector<float> out;
+			for (size_t pos = 0; pos < signal.size(); pos += chunk_size) {
+				const size_t size = (std::min)(chunk_size, signal.size() - pos);
+				engine.process(
+						std::span{ signal }.subspan(pos, size), out);
+			}
+			engine.flush(out);
+			return out;
+		};
+
+		std::vector<float> chunked;
+		if (!job.args.empty()) {
+			wsay::fx_engine engine{ job.vopts, job.args.front() };
+			chunked = run(engine);
+		} else {
+			wsay::fx_engine engine{ job.vopts };
+			chunked = run(engine);
+		}
+		EXPECT_EQ(chunked, expected)
+				<< "seed " << job.vopts.radio_effect_seed << ", native rate "
+				<< job.vopts.radio_effect_native_rate;
+	}
+}
+
+// Split renders cut the input in 10 second segments, each one warmed up on
+// the previous segment's tail. They must match the serial render to within
+// the biquad convergence, 1e-6.
+TEST(fx, parallel_matches_serial) {
+	// 4 segments over 3 threads, the last one short.
+	const std::vector<float> signal = make_signal(35);
+	constexpr size_t chunk_size = 44'100;
+	for (const fx_job& job : make_jobs()) {
+		if (!job.args.empty()) {
+			continue;
+		}
+		const std::vector<float> expected = render(job, signal, 1);
+
+		// Chunked, so the first 3 segments render before the flush.
+		wsay::fx_parallel engine{ job.vopts, 3 };
+		std::vector<float> out;
+		for (size_t pos = 0; pos < signal.size(); pos += chunk_size) {
+			const size_t size = (std::min)(chunk_size, signal.size() - pos);
+			engine.process(std::span{ signal }.subspan(pos, size), out);
+		}
+		engine.flush(out);
+
+		ASSERT_EQ(out.size(), expected.size());
+		float max_error = 0.f;
+		for (size_t i = 0; i < out.size(); ++i) {
+			max_error = (std::max)(max_error, std::abs(out[i] - expected[i]));
+		}
+		EXPECT_LE(max_error, 1e-6f)
+				<< "preset " << size_t(job.vopts.radio_effect())
+				<< ", native rate " << job.vopts.radio_effect_native_rate
+				<< ", noise " << !job.vopts.radio_effect_disable_whitenoise;
+	}
+}
+
+// Engines share no state, concurrent renders must match serial ones bit for
+// bit.
+TEST(fx, concurrent_process_fx) {
+	const std::vector<float> signal = make_signal();
+	std::vector<fx_job> jobs = make_jobs();
+	for (fx_job& job : jobs) {
+		job.expected = render(job, signal, 1);
+		job.expected_split = render(job, signal, 2);
+		job.expected_fixed = render_fixed(job, signal);
+	}
+
+	// Oversubscribe, so renders get preempted mid block.
+	const size_t num_threads
+			= (std::max)(size_t(std::thread::hardware_concurrency()), size_t(4))
+			* 2;
+	constexpr size_t rounds = 3;
+	std::atomic<size_t> renders = 0;
+	std::atomic<size_t> mismatches = 0;
+
+	auto work = [&](size_t thread_idx) {
+		for (size_t r = 0; r < rounds; ++r) {
+			// Each thread walks the jobs in its own order.
+			for (size_t j = 0; j < jobs.size(); ++j) {
+				const fx_job& job = jobs[(j + thread_idx) % jobs.size()];
+				// Nest a few split renders too, they spawn their own
+				// threads.
+				const bool split = (j + r) % 4 == 0;
+				if (render(job, signal, split ? 2 : 1)
+						!= (split ? job.expected_split : job.expected)) {
+					++mismatches;
+				}
+				if (render_fixed(job, signal) != job.expected_fixed) {
+					++mismatches;
+				}
+				renders += 2;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(num_threads);
+	for (size_t t = 0; t < num_threads; ++t) {
+		threads.emplace_back(work, t);
+	}
+	for (std::thread& t : threads) {
+		t.join();
+	}
+
+	EXPECT_EQ(renders, num_threads * rounds * jobs.size() * 2);
+	EXPECT_EQ(mismatches, 0u);
+}
+} // namespace
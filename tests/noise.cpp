@@ -0,0 +1,79 @@
+#include "private_include/noise.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <span>
+#include <vector>
+
+namespace {
+std::vector<float> make_noise(uint64_t seed, size_t size, float amplitude) {
+	wsay::noise_gen gen{ seed };
+	std::vector<float> ret(size);
+	gen.fill(ret, amplitude);
+	return ret;
+}
+
+TEST(noise, seeded) {
+	const std::vector<float> noise = make_noise(42, 10'001, 1.f);
+	EXPECT_EQ(make_noise(42, 10'001, 1.f), noise);
+	EXPECT_NE(make_noise(43, 10'001, 1.f), noise);
+
+	// Same sequence however fills are split.
+	wsay::noise_gen gen{ 42 };
+	std::vector<float> split(noise.size());
+	for (size_t pos = 0, size = 1; pos < split.size(); pos += size, ++size) {
+		size = (std::min)(size, split.size() - pos);
+		gen.fill(std::span{ split }.subspan(pos, size), 1.f);
+	}
+	EXPECT_EQ(split, noise);
+
+	// The fixed-point fill is the same sequence.
+	wsay::noise_gen int_gen{ 42 };
+	std::vector<int32_t> ints(noise.size());
+	int_gen.fill(ints);
+	for (size_t i = 0; i < ints.size(); ++i) {
+		ASSERT_EQ(float(ints[i]) * (1.f / 2147483648.f), noise[i]) << i;
+	}
+}
+
+TEST(noise, discard) {
+	for (uint64_t n : { 0ull, 1ull, 7ull, 8ull, 9ull, 1'000ull, 123'457ull }) {
+		// Starting mid lane group too.
+		for (size_t offset : { 0u, 3u }) {
+			wsay::noise_gen filled{ 7 };
+			std::vector<float> dropped(offset + n);
+			filled.fill(dropped, 1.f);
+			std::vector<float> expected(100);
+			filled.fill(expected, 1.f);
+
+			wsay::noise_gen skipped{ 7 };
+			std::vector<float> head(offset);
+			skipped.fill(head, 1.f);
+			skipped.discard(n);
+			std::vector<float> out(100);
+			skipped.fill(out, 1.f);
+
+			EXPECT_EQ(out, expected) << "n " << n << ", offset " << offset;
+		}
+	}
+}
+
+TEST(noise, amplitude) {
+	for (float amplitude : { 1.f, 0.25f, 0.001f }) {
+		const std::vector<float> noise = make_noise(1, 100'000, amplitude);
+		float lo = 0.f;
+		float hi = 0.f;
+		for (float f : noise) {
+			EXPECT_GE(f, -amplitude);
+			EXPECT_LT(f, amplitude);
+			lo = (std::min)(lo, f);
+			hi = (std::max)(hi, f);
+		}
+		// Covers the range.
+		EXPECT_LT(lo, -0.99f * amplitude);
+		EXPECT_GT(hi, 0.99f * amplitude);
+	}
+}
+} // namespace
@@ -0,0 +1,109 @@
+#include "private_include/pcm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace {
+// Range edges, just past them and non-finite values.
+const float edge_values[] = {
+	0.f,
+	0.5f,
+	-0.5f,
+	1.f,
+	-1.f,
+	1.0001f,
+	-1.0001f,
+	1.5f,
+	-2.f,
+	100.f,
+	-100.f,
+	std::numeric_limits<float>::infinity(),
+	-std::numeric_limits<float>::infinity(),
+	std::numeric_limits<float>::quiet_NaN(),
+};
+
+template <class IntT>
+void check_float_to_pcm() {
+	constexpr IntT pcm_min = (std::numeric_limits<IntT>::min)();
+	constexpr IntT pcm_max = (std::numeric_limits<IntT>::max)();
+
+	// Sizes that aren't multiples of the simd widths, so the edges land in
+	// the vector bodies and in the scalar tails.
+	for (size_t size = 1; size <= 71; size += 2) {
+		for (size_t offset = 0; offset < std::size(edge_values); ++offset) {
+			std::vector<float> in(size);
+			for (size_t i = 0; i < size; ++i) {
+				in[i] = edge_values[(i + offset) % std::size(edge_values)];
+			}
+
+			std::vector<IntT> expected(size);
+			wsay::float_to_pcm(wsay::simd_e::scalar, in, std::span{ expected });
+			for (size_t i = 0; i < size; ++i) {
+				if (in[i] >= 1.f) {
+					EXPECT_EQ(expected[i], pcm_max) << in[i];
+				} else if (in[i] <= -2.f) {
+					EXPECT_EQ(expected[i], pcm_min) << in[i];
+				} else if (in[i] <= -1.f) {
+					// -1 maps to -max, past it saturates down to min.
+					EXPECT_LE(expected[i], IntT(-pcm_max)) << in[i];
+				}
+			}
+
+			for (wsay::simd_e path :
+					{ wsay::simd_e::sse2, wsay::simd_e::avx2 }) {
+				if (!wsay::simd_available(path)) {
+					continue;
+				}
+				std::vector<IntT> out(size);
+				wsay::float_to_pcm(path, in, std::span{ out });
+				EXPECT_EQ(out, expected)
+						<< "path " << size_t(path) << ", size " << size;
+			}
+		}
+	}
+}
+
+template <class IntT>
+void check_pcm_to_float() {
+	for (size_t size = 1; size <= 71; size += 2) {
+		std::vector<IntT> in(size);
+		for (size_t i = 0; i < size; ++i) {
+			in[i] = IntT(i * 37 + i * i);
+		}
+		in[0] = (std::numeric_limits<IntT>::min)();
+		in[size - 1] = (std::numeric_limits<IntT>::max)();
+
+		std::vector<float> expected(size);
+		wsay::pcm_to_float(wsay::simd_e::scalar, std::span<const IntT>{ in },
+				std::span{ expected });
+		EXPECT_EQ(expected[size - 1], 1.f);
+
+		for (wsay::simd_e path : { wsay::simd_e::sse2, wsay::simd_e::avx2 }) {
+			if (!wsay::simd_available(path)) {
+				continue;
+			}
+			std::vector<float> out(size);
+			wsay::pcm_to_float(
+					path, std::span<const IntT>{ in }, std::span{ out });
+			EXPECT_EQ(out, expected)
+					<< "path " << size_t(path) << ", size " << size;
+		}
+	}
+}
+
+// Every path saturates the same way, in the vector bodies and the tails.
+TEST(pcm, saturation) {
+	check_float_to_pcm<int8_t>();
+	check_float_to_pcm<int16_t>();
+}
+
+TEST(pcm, paths_match) {
+	check_pcm_to_float<int8_t>();
+	check_pcm_to_float<int16_t>();
+}
+} // namespace
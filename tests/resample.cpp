@@ -0,0 +1,155 @@
+#include "private_include/resample.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <numbers>
+#include <span>
+#include <vector>
+
+namespace {
+struct rates {
+	size_t high;
+	size_t low;
+};
+
+// The radio preset rates against the voice rates, integer and not.
+constexpr rates rate_pairs[] = {
+	{ 44'100, 22'050 },
+	{ 44'100, 11'025 },
+	{ 44'100, 8'000 },
+	{ 44'100, 16'000 },
+	{ 22'050, 8'000 },
+	{ 22'050, 16'000 },
+};
+
+std::vector<float> make_tone(size_t size, double freq, double delay = 0.0) {
+	std::vector<float> ret(size);
+	for (size_t i = 0; i < size; ++i) {
+		const double t = double(i) - delay;
+		ret[i] = float(0.5 * std::sin(2.0 * std::numbers::pi * freq * t));
+	}
+	return ret;
+}
+
+// Decimating then interpolating back gives the input, delayed by both
+// filters. Tones well below the lower nyquist pass through.
+TEST(resample, round_trip) {
+	for (rates r : rate_pairs) {
+		for (double freq : { 0.05, 0.1, 0.25 }) {
+			// Normalized to the high rate.
+			const double f = freq * double(r.low) / double(r.high);
+			const std::vector<float> in = make_tone(r.high, f);
+
+			wsay::resampler down{ r.high, r.low };
+			wsay::resampler up{ r.low, r.high };
+			std::vector<float> low;
+			down.process(in, low);
+			down.flush(low);
+			std::vector<float> out;
+			up.process(low, out);
+			up.flush(out);
+
+			// Compare against the tone shifted by the exact delay, fractional
+			// delays don't round to a whole sample.
+			const double delay = down.delay() * double(r.high) / double(r.low)
+					+ up.delay();
+			const std::vector<float> expected
+					= make_tone(out.size(), f, delay);
+
+			// Skip the filter edges.
+			const size_t begin = size_t(delay) + r.high / 20;
+			const size_t end = in.size() - r.high / 20;
+			ASSERT_GE(out.size(), end + size_t(delay));
+			double signal = 0.0;
+			double noise = 0.0;
+			for (size_t i = begin; i < end; ++i) {
+				const double e = double(out[i]) - double(expected[i]);
+				signal += double(expected[i]) * double(expected[i]);
+				noise += e * e;
+			}
+			EXPECT_GT(10.0 * std::log10(signal / noise), 60.0)
+					<< r.high << " to " << r.low << ", tone " << freq;
+		}
+	}
+}
+
+// Outputs follow the rate ratio, rounded up, whatever the chunks.
+TEST(resample, output_size) {
+	for (rates r : rate_pairs) {
+		for (bool decimate : { true, false }) {
+			const size_t in_rate = decimate ? r.high : r.low;
+			const size_t out_rate = decimate ? r.low : r.high;
+			const std::vector<float> in = make_tone(12'345, 0.01);
+
+			wsay::resampler whole{ in_rate, out_rate };
+			std::vector<float> expected;
+			whole.process(in, expected);
+			whole.flush(expected);
+
+			wsay::resampler chunked{ in_rate, out_rate };
+			std::vector<float> out;
+			size_t pos = 0;
+			for (size_t size = 1; pos < in.size(); pos += size, size += 7) {
+				size = (std::min)(size, in.size() - pos);
+				chunked.process(std::span{ in }.subspan(pos, size), out);
+				const size_t fed = pos + size;
+				EXPECT_EQ(out.size(),
+						(fed * out_rate + in_rate - 1) / in_rate)
+						<< in_rate << " to " << out_rate << ", " << fed;
+			}
+
+			// The tail covers the delay.
+			const size_t size = out.size();
+			chunked.flush(out);
+			EXPECT_GE(double(out.size() - size), chunked.delay());
+			EXPECT_EQ(out, expected) << in_rate << " to " << out_rate;
+		}
+	}
+}
+
+// The Q15 resampler runs the same filter with Q14 coefficients.
+TEST(resample, q15_matches_float) {
+	for (rates r : rate_pairs) {
+		for (bool decimate : { true, false }) {
+			const size_t in_rate = decimate ? r.high : r.low;
+			const size_t out_rate = decimate ? r.low : r.high;
+
+			// Up to 0.75 full scale, speech like.
+			std::vector<int16_t> in(in_rate);
+			for (size_t i = 0; i < in.size(); ++i) {
+				const double t = double(i) / double(in_rate);
+				constexpr double two_pi = 2.0 * std::numbers::pi;
+				in[i] = int16_t(
+						std::lround(16'000.0 * std::sin(two_pi * 440.0 * t)
+								+ 8'000.0 * std::sin(two_pi * 1'700.0 * t)));
+			}
+			std::vector<float> in_float(in.size());
+			std::transform(in.begin(), in.end(), in_float.begin(),
+					[](int16_t s) { return float(s) / 32'767.f; });
+
+			wsay::resampler_q15 fixed{ in_rate, out_rate };
+			std::vector<int16_t> out;
+			fixed.process(in, out);
+			fixed.flush(out);
+
+			wsay::resampler flt{ in_rate, out_rate };
+			std::vector<float> expected;
+			flt.process(in_float, expected);
+			flt.flush(expected);
+
+			ASSERT_EQ(out.size(), expected.size());
+			long max_error = 0;
+			for (size_t i = 0; i < out.size(); ++i) {
+				max_error = (std::max)(max_error,
+						std::abs(long(out[i])
+								- std::lround(expected[i] * 32'767.f)));
+			}
+			EXPECT_LE(max_error, 8) << in_rate << " to " << out_rate;
+		}
+	}
+}
+} // namespace
@@ -0,0 +1,109 @@
+#include "private_include/speech_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+using wsay::speak_policy_e;
+using wsay::speak_priority_e;
+using wsay::speech_queue;
+
+using texts_t = std::vector<std::wstring>;
+
+// Keeps the dropped items' texts.
+struct test_queue {
+	explicit test_queue(size_t capacity)
+			: q(capacity) {
+	}
+
+	bool push(const wchar_t* text, speak_priority_e priority,
+			speak_policy_e policy = speak_policy_e::append) {
+		std::vector<speech_queue::item> items;
+		const bool ret = q.push(
+				speech_queue::item{
+						.text = text,
+						.priority = priority,
+						.enqueued = {},
+						.on_done = {},
+				},
+				policy, items);
+		for (const speech_queue::item& it : items) {
+			dropped.push_back(it.text);
+		}
+		return ret;
+	}
+
+	std::wstring pop() {
+		return q.pop().value().text;
+	}
+
+	speech_queue q;
+	texts_t dropped;
+};
+
+TEST(speech_queue, priorities) {
+	test_queue t{ 8 };
+	EXPECT_TRUE(t.q.empty());
+	EXPECT_FALSE(t.q.pop().has_value());
+
+	t.push(L"low", speak_priority_e::low);
+	t.push(L"normal1", speak_priority_e::normal);
+	t.push(L"high", speak_priority_e::high);
+	t.push(L"normal2", speak_priority_e::normal);
+	EXPECT_EQ(t.q.size(), 4u);
+
+	// By priority, then in order.
+	EXPECT_EQ(t.pop(), L"high");
+	EXPECT_EQ(t.pop(), L"normal1");
+	EXPECT_EQ(t.pop(), L"normal2");
+	EXPECT_EQ(t.pop(), L"low");
+	EXPECT_TRUE(t.q.empty());
+	EXPECT_EQ(t.q.dropped(), 0u);
+}
+
+TEST(speech_queue, policies) {
+	for (speak_policy_e policy :
+			{ speak_policy_e::replace_pending, speak_policy_e::interrupt }) {
+		test_queue t{ 8 };
+		t.push(L"low", speak_priority_e::low);
+		t.push(L"normal", speak_priority_e::normal);
+		t.push(L"high", speak_priority_e::high);
+
+		// Higher priorities stay.
+		t.push(L"new", speak_priority_e::normal, policy);
+		EXPECT_EQ(t.q.dropped(), 2u);
+		EXPECT_EQ(t.dropped, (texts_t{ L"low", L"normal" }));
+		EXPECT_EQ(t.q.size(), 2u);
+		EXPECT_EQ(t.pop(), L"high");
+		EXPECT_EQ(t.pop(), L"new");
+	}
+}
+
+TEST(speech_queue, bounded) {
+	test_queue t{ 2 };
+	EXPECT_TRUE(t.push(L"low1", speak_priority_e::low));
+	EXPECT_TRUE(t.push(L"low2", speak_priority_e::low));
+
+	// The oldest of the lowest priority goes.
+	EXPECT_TRUE(t.push(L"high1", speak_priority_e::high));
+	EXPECT_TRUE(t.push(L"high2", speak_priority_e::high));
+	EXPECT_EQ(t.q.size(), 2u);
+	EXPECT_EQ(t.q.dropped(), 2u);
+	EXPECT_EQ(t.dropped, (texts_t{ L"low1", L"low2" }));
+
+	// Lower priorities don't make room, they aren't queued.
+	EXPECT_FALSE(t.push(L"normal", speak_priority_e::normal));
+	EXPECT_EQ(t.q.dropped(), 3u);
+	EXPECT_EQ(t.dropped.size(), 2u);
+	EXPECT_EQ(t.pop(), L"high1");
+	EXPECT_EQ(t.pop(), L"high2");
+
+	t.push(L"low", speak_priority_e::low);
+	std::vector<speech_queue::item> cleared;
+	t.q.clear(cleared);
+	EXPECT_TRUE(t.q.empty());
+	EXPECT_EQ(cleared.size(), 1u);
+	EXPECT_EQ(t.q.dropped(), 3u);
+}
+} // namespace
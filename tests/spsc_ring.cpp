@@ -0,0 +1,102 @@
+#include "private_include/spsc_ring.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace {
+std::byte pattern(size_t i) {
+	return std::byte((i * 31 + (i >> 8)) & 0xff);
+}
+
+TEST(spsc_ring, basics) {
+	wsay::spsc_ring ring{ 100 };
+	EXPECT_EQ(ring.capacity(), 128u);
+	EXPECT_EQ(ring.size(), 0u);
+
+	std::vector<std::byte> in(100);
+	for (size_t i = 0; i < in.size(); ++i) {
+		in[i] = pattern(i);
+	}
+	ASSERT_TRUE(ring.write(in));
+	EXPECT_EQ(ring.size(), 100u);
+
+	// Partial reads, around the end.
+	std::vector<std::byte> out(64);
+	EXPECT_EQ(ring.read(out, 64), 64u);
+	ASSERT_TRUE(ring.write(std::span{ in }.first(80)));
+	EXPECT_EQ(ring.size(), 116u);
+
+	std::vector<std::byte> all;
+	all.insert(all.end(), out.begin(), out.end());
+	ring.close();
+	while (size_t n = ring.read(out, out.size())) {
+		all.insert(all.end(), out.begin(), out.begin() + n);
+	}
+	ASSERT_EQ(all.size(), 180u);
+	for (size_t i = 0; i < all.size(); ++i) {
+		EXPECT_EQ(all[i], pattern(i % 100));
+	}
+
+	// Reusable.
+	ring.reset();
+	EXPECT_EQ(ring.size(), 0u);
+	ASSERT_TRUE(ring.write(std::span{ in }.first(10)));
+	EXPECT_EQ(ring.read(out, 1), 10u);
+}
+
+TEST(spsc_ring, threads) {
+	constexpr size_t total = 8 * 1024 * 1024;
+	wsay::spsc_ring ring{ 4096 };
+
+	// Odd sizes on both sides.
+	std::thread producer{ [&]() {
+		std::vector<std::byte> block;
+		size_t written = 0;
+		for (size_t size = 1; written < total; size = size % 5000 + 7) {
+			block.resize((std::min)(size, total - written));
+			for (size_t i = 0; i < block.size(); ++i) {
+				block[i] = pattern(written + i);
+			}
+			ASSERT_TRUE(ring.write(block));
+			written += block.size();
+		}
+		ring.close();
+	} };
+
+	std::vector<std::byte> out(3000);
+	size_t read = 0;
+	bool ok = true;
+	for (size_t min = 1;; min = min % 3000 + 13) {
+		const size_t n = ring.read(out, min);
+		if (n == 0) {
+			break;
+		}
+		for (size_t i = 0; i < n; ++i) {
+			ok &= out[i] == pattern(read + i);
+		}
+		read += n;
+	}
+	producer.join();
+	EXPECT_TRUE(ok);
+	EXPECT_EQ(read, total);
+}
+
+TEST(spsc_ring, cancel) {
+	wsay::spsc_ring ring{ 16 };
+	bool result = true;
+	std::thread producer{ [&]() {
+		// Blocks once full, until cancelled.
+		std::vector<std::byte> block(64);
+		result = ring.write(block);
+	} };
+
+	std::vector<std::byte> out(4);
+	EXPECT_EQ(ring.read(out, 4), 4u);
+	ring.cancel();
+	producer.join();
+	EXPECT_FALSE(result);
+}
+} // namespace
@@ -0,0 +1,63 @@
+#include "private_include/text.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+std::vector<std::wstring> split(
+		std::wstring_view text, bool xml = true, size_t min_size = 1) {
+	std::vector<std::wstring> ret;
+	for (std::wstring_view s : wsay::split_sentences(text, xml, min_size)) {
+		ret.push_back(std::wstring{ s });
+	}
+
+	std::wstring joined;
+	for (const std::wstring& s : ret) {
+		joined += s;
+	}
+	EXPECT_EQ(joined, text);
+	return ret;
+}
+
+TEST(text, split_sentences) {
+	using v = std::vector<std::wstring>;
+	EXPECT_EQ(split(L""), v{});
+	EXPECT_EQ(split(L"No end"), v{ L"No end" });
+	EXPECT_EQ(split(L"Hello there. How are you? Fine!"),
+			(v{ L"Hello there. ", L"How are you? ", L"Fine!" }));
+	EXPECT_EQ(split(L"Pi is 3.14. \"Is it?\" Yes..."),
+			(v{ L"Pi is 3.14. ", L"\"Is it?\" ", L"Yes..." }));
+	EXPECT_EQ(split(L"First paragraph\r\n\r\nSecond one"),
+			(v{ L"First paragraph\r\n\r\n", L"Second one" }));
+	// Full width stops.
+	EXPECT_EQ(split(L"\u4f60\u597d\u3002\u518d\u89c1\u3002"),
+			(v{ L"\u4f60\u597d\u3002", L"\u518d\u89c1\u3002" }));
+
+	// Short sentences are merged.
+	EXPECT_EQ(split(L"One. Two. Three. Four.", true, 8),
+			(v{ L"One. Two. ", L"Three. Four." }));
+}
+
+TEST(text, split_sentences_xml) {
+	using v = std::vector<std::wstring>;
+	EXPECT_EQ(split(L"<pitch absmiddle=\"5\">One. Two.</pitch> Three. Four."),
+			(v{ L"<pitch absmiddle=\"5\">One. Two.</pitch> Three. ",
+					L"Four." }));
+	EXPECT_EQ(split(L"One. <silence msec=\"500\"/>Two. <!-- a. b. -->Three."),
+			(v{ L"One. ", L"<silence msec=\"500\"/>Two. ",
+					L"<!-- a. b. -->Three." }));
+	EXPECT_EQ(split(L"<emph a=\"x. >y\">One. Two.</emph> Three."),
+			(v{ L"<emph a=\"x. >y\">One. Two.</emph> Three." }));
+
+	// Left open, the rest stays together.
+	EXPECT_EQ(split(L"One. <volume level=\"50\">Two. Three."),
+			(v{ L"One. ", L"<volume level=\"50\">Two. Three." }));
+
+	// Without xml, tags are text.
+	EXPECT_EQ(split(L"<b>One. Two.</b>", false),
+			(v{ L"<b>One. ", L"Two.</b>" }));
+	EXPECT_EQ(split(L"1 < 2. Yes."), (v{ L"1 < 2. ", L"Yes." }));
+}
+} // namespace
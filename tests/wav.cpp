@@ -0,0 +1,96 @@
+#include "private_include/wav.hpp"
+#include "wsay/voice.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace {
+std::vector<std::byte> read_file(const std::filesystem::path& path) {
+	std::ifstream ifs{ path, std::ios::binary };
+	std::vector<char> data{ std::istreambuf_iterator<char>{ ifs },
+		std::istreambuf_iterator<char>{} };
+	std::vector<std::byte> ret(data.size());
+	std::memcpy(ret.data(), data.data(), data.size());
+	return ret;
+}
+
+uint32_t read_u32(const std::vector<std::byte>& data, size_t pos) {
+	uint32_t ret = 0;
+	std::memcpy(&ret, data.data() + pos, sizeof(ret));
+	return ret;
+}
+
+TEST(wav, buffered_writes) {
+	const std::filesystem::path path
+			= std::filesystem::temp_directory_path() / "wsay_wav_test.wav";
+
+	// Several write buffers worth, in odd sizes.
+	std::vector<std::byte> pcm(3 * 1024 * 1024 + 123);
+	for (size_t i = 0; i < pcm.size(); ++i) {
+		pcm[i] = std::byte((i * 7 + (i >> 10)) & 0xff);
+	}
+	const size_t sizes[] = { 1, 4410, 3 * 1024 * 1024, 17, 88'200 };
+
+	for (size_t bit_depth : { 8, 16 }) {
+		{
+			wsay::wav_writer writer{ path, 22'050, bit_depth };
+			std::span<const std::byte> rest = pcm;
+			for (size_t i = 0; !rest.empty(); ++i) {
+				const size_t size
+						= (std::min)(rest.size(), sizes[i % std::size(sizes)]);
+				writer.write(rest.first(size));
+				rest = rest.subspan(size);
+			}
+			EXPECT_EQ(writer.size(), pcm.size());
+		}
+
+		const std::vector<std::byte> wav = read_file(path);
+		ASSERT_EQ(wav.size(), 44 + pcm.size());
+		EXPECT_EQ(read_u32(wav, 4), 36 + pcm.size());
+		EXPECT_EQ(read_u32(wav, 24), 22'050u);
+		EXPECT_EQ(read_u32(wav, 40), pcm.size());
+
+		// 8 bit is stored unsigned.
+		const std::byte flip = bit_depth == 8 ? std::byte{ 0x80 } : std::byte{};
+		for (size_t i = 0; i < pcm.size(); ++i) {
+			ASSERT_EQ(wav[44 + i], pcm[i] ^ flip) << i;
+		}
+	}
+	std::filesystem::remove(path);
+}
+
+TEST(wav, sink_stop) {
+	const std::filesystem::path path
+			= std::filesystem::temp_directory_path() / "wsay_wav_stop.wav";
+	const wsay::shared_pcm pcm
+			= std::make_shared<const std::vector<std::byte>>(
+					3 * 1024 * 1024, std::byte{ 1 });
+
+	{
+		wsay::wav_sink sink{ wsay::voice{}, path };
+
+		// Stopped before playing, a purging play doesn't undo the stop.
+		sink.stop();
+		sink.play(pcm, true);
+		sink.play(pcm, false);
+		sink.wait();
+		EXPECT_EQ(std::filesystem::file_size(path), 44u);
+
+		// The next utterance is written.
+		sink.reset();
+		sink.play(pcm, true);
+		sink.wait();
+		EXPECT_EQ(std::filesystem::file_size(path), 44 + pcm->size());
+	}
+	std::filesystem::remove(path);
+}
+} // namespace